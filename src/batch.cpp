@@ -0,0 +1,448 @@
+/**
+ * This file is a part of the UMSKT Project
+ *
+ * Copyleft (C) 2019-2023 UMSKT Contributors (et.al.)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @FileCreated by Neo on 10/18/2026
+ * @Maintainer Neo
+ */
+
+
+
+#include "batch.h"
+#include "checkpoint.h"
+#include "cli.h"
+#include "request.h"
+
+#include "libumskt/confid/confid.h"
+
+BatchRunner::BatchRunner(int threads) : threads(threads) {
+}
+
+BatchRunner::~BatchRunner() {
+    for (auto &task : tasks) {
+        delete task->writer;
+    }
+}
+
+/*
+ * Reads a manifest:
+ *
+ *   { "output_dir": "nightly", "threads": 0, "tasks": [
+ *       { "name": "xp", "bink": "2E", "channel": 640, "serial": [0, 999999], "upgrade": false, "count": 100000 },
+ *       { "name": "acc", "type": "confid", "mode": "OFFICEACC", "input": "acc-iids.txt" } ] }
+ *
+ * Relative paths are taken from the directory the manifest is in.
+ */
+bool BatchRunner::load(const std::string &filename) {
+    std::ifstream f(filename);
+    if (!f) {
+        fmt::print("ERROR: Unable to open manifest {}\n", filename);
+        return false;
+    }
+
+    json manifest = json::parse(f, nullptr, false, false);
+    if (manifest.is_discarded() || !manifest.is_object() || !manifest.contains("tasks") || !manifest["tasks"].is_array()) {
+        fmt::print("ERROR: {} is not a manifest, expected an object with a \"tasks\" array\n", filename);
+        return false;
+    }
+
+    fs::path baseDir = fs::path(filename).parent_path();
+    std::string dir = ".";
+    int manifestThreads = 0;
+
+    if (!RequestFields::readString(manifest, "output_dir", dir) || !RequestFields::readInt(manifest, "threads", manifestThreads) || manifestThreads < 0) {
+        fmt::print("ERROR: invalid \"output_dir\" or \"threads\" in {}\n", filename);
+        return false;
+    }
+
+    outputDir = (baseDir / dir).string();
+    if (threads <= 0) {
+        threads = manifestThreads;
+    }
+
+    std::error_code error;
+    fs::create_directories(outputDir, error);
+    if (error) {
+        fmt::print("ERROR: Unable to create output directory {}\n", outputDir);
+        return false;
+    }
+
+    std::vector<std::string> binkids;
+
+    for (size_t i = 0; i < manifest["tasks"].size(); i++) {
+        if (!parseTask(manifest["tasks"][i], baseDir, i)) {
+            return false;
+        }
+
+        BatchTask &task = *tasks.back();
+
+        for (size_t j = 0; j + 1 < tasks.size(); j++) {
+            if (tasks[j]->name == task.name || tasks[j]->outputFile == task.outputFile) {
+                fmt::print("ERROR: tasks {} and {} share a name or an output file\n", j, i);
+                return false;
+            }
+        }
+
+        if (task.type == TASK_GENERATE && std::find(binkids.begin(), binkids.end(), task.binkid) == binkids.end()) {
+            binkids.push_back(task.binkid);
+        }
+    }
+
+    // the curves a batch uses are only known now, set them all up before the first chunk needs one
+    PIDGEN3::CurveRegistry::prefetch(binkids);
+    return true;
+}
+
+bool BatchRunner::parseTask(const json &entry, const fs::path &baseDir, size_t number) {
+    std::unique_ptr<BatchTask> task = std::make_unique<BatchTask>();
+    std::string type = "generate", output, formatName = "plain";
+
+    task->name = fmt::format("task{}", number);
+
+    if (!entry.is_object() || !RequestFields::readString(entry, "name", task->name) ||
+        !RequestFields::readString(entry, "type", type) || !RequestFields::readString(entry, "output", output)) {
+        fmt::print("ERROR: task {}: must be an object with string \"name\", \"type\" and \"output\" fields\n", number);
+        return false;
+    }
+
+    auto fail = [&task](const std::string &message) {
+        fmt::print("ERROR: task {}: {}\n", task->name, message);
+        return false;
+    };
+
+    if (type == "confid") {
+        std::string modeName = "WINDOWS", input;
+
+        task->type = TASK_CONFID;
+        task->activationMode = WINDOWS;
+
+        if (!RequestFields::readString(entry, "mode", modeName) || !RequestFields::readString(entry, "productid", task->productid) ||
+            !RequestFields::readBool(entry, "override", task->overrideVersion) || !RequestFields::readString(entry, "input", input)) {
+            return fail("invalid field type");
+        }
+
+        if (!RequestFields::parseActivationMode(modeName, task->activationMode)) {
+            return fail(fmt::format("unknown activation mode \"{}\"", modeName));
+        }
+
+        if ((task->activationMode == OFFICE_2K3 || task->activationMode == OFFICE_2K7) && !RequestFields::isProductID(task->productid)) {
+            return fail("a product ID of the form 12345-123-1234567-12345 is required for this mode");
+        }
+
+        auto iids = entry.find("iids");
+        if (iids != entry.end()) {
+            if (!iids->is_array()) {
+                return fail("\"iids\" must be an array of strings");
+            }
+            for (const json &iid : *iids) {
+                if (!iid.is_string()) {
+                    return fail("\"iids\" must be an array of strings");
+                }
+                task->iids.push_back(iid.get<std::string>());
+            }
+        }
+
+        if (!input.empty()) {
+            std::ifstream in(baseDir / input);
+            if (!in) {
+                return fail(fmt::format("unable to open {}", (baseDir / input).string()));
+            }
+
+            std::string line;
+            while (std::getline(in, line)) {
+                while (!line.empty() && (line.back() == '\r' || line.back() == ' ')) {
+                    line.pop_back();
+                }
+                if (!line.empty()) {
+                    task->iids.push_back(line);
+                }
+            }
+        }
+
+        task->format = FORMAT_PLAIN;
+        task->requested = task->iids.size();
+        task->results.resize(task->iids.size());
+    } else if (type == "generate") {
+        int channelID = 640, serMin = 0, serMax = 999999;
+        bool upgrade = false, dashes = true, serialSet = entry.contains("serial"), seeded = entry.contains("seed");
+        QWORD count = 1, seed = 0;
+
+        task->type = TASK_GENERATE;
+        task->binkid = "2E";
+        task->verify = true;
+
+        if (!RequestFields::readString(entry, "bink", task->binkid) || !RequestFields::readInt(entry, "channel", channelID) ||
+            !RequestFields::readBool(entry, "upgrade", upgrade) || !RequestFields::readQWORD(entry, "count", count) ||
+            !RequestFields::readString(entry, "format", formatName) || !RequestFields::readBool(entry, "dashes", dashes) ||
+            !RequestFields::readBool(entry, "verify", task->verify) || !RequestFields::readQWORD(entry, "seed", seed)) {
+            return fail("invalid field type");
+        }
+
+        if (!RequestFields::readSerial(entry, "serial", serMin, serMax)) {
+            return fail("\"serial\" must be a number or a [min, max] pair");
+        }
+
+        if (!OutputWriter::parseFormat(formatName, &task->format)) {
+            return fail(fmt::format("unknown format \"{}\"", formatName));
+        }
+
+        if (task->format == FORMAT_PLAIN && !dashes) {
+            task->format = FORMAT_NODASH;
+        }
+
+        if (channelID < 0 || channelID > 999) {
+            return fail("refusing to create a key with a Channel ID not between 000 and 999");
+        }
+
+        if (serMin < 0 || serMax > 999999 || serMin > serMax) {
+            return fail("refusing to create a key with a Serial not between 000000 and 999999");
+        }
+
+        // only checked here, the curve itself is set up by the prefetch at the end of load()
+        int intBinkID;
+        if (sscanf(task->binkid.c_str(), "%x", &intBinkID) != 1 || intBinkID >= 0xFE || !PIDGEN3::CurveRegistry::contains(task->binkid)) {
+            return fail(fmt::format("BINK {} is unsupported or not in the keys file", task->binkid));
+        }
+        bool bink2002 = intBinkID >= 0x40;
+
+        PipelineJob &job = task->job;
+        job.bink2002 = bink2002;
+        job.pChannelID = channelID;
+        job.serMin = serMin;
+        job.serMax = serMax;
+        job.pUpgrade = upgrade;
+        job.seeded = seeded;
+        job.seed = seed;
+        job.shardCount = 1;
+
+        // BINK1998 uses one serial for the whole task, just like the command line
+        job.pSerial = channelID * 1'000'000 + serMin;
+        if (!bink2002 && !(serialSet && serMin == serMax)) {
+            job.pSerial = channelID * 1'000'000 + KeyShards::pickSerial(serMin, serMax, seeded, seed);
+        }
+
+        task->requested = count;
+    } else {
+        return fail(fmt::format("unknown task type \"{}\"", type));
+    }
+
+    if (output.empty()) {
+        static const char *extensions[] = { ".txt", ".txt", ".csv", ".jsonl", ".txt", ".keys" };
+        output = task->name + extensions[task->format];
+    }
+
+    task->outputFile = (fs::path(outputDir) / output).string();
+    task->writer = nullptr;
+    task->produced = 0;
+    task->failed = 0;
+    task->busyNanos = 0;
+    task->chunksLeft = 0;
+    task->seconds = 0;
+#if !UMSKT_THREADS
+    task->opened = false;
+#endif
+
+    tasks.push_back(std::move(task));
+    return true;
+}
+
+/* Opens the output of a task, the first chunk of it to run does this. */
+void BatchRunner::openTask(BatchTask &task) {
+    task.writer = OutputWriter::open(task.outputFile, task.format, true);
+
+    if (task.writer == nullptr) {
+        fmt::print(stderr, "ERROR: task {}: unable to open output file {}\n", task.name, task.outputFile);
+        return;
+    }
+
+    if (task.type == TASK_GENERATE) {
+        task.job.curve = PIDGEN3::CurveRegistry::get(task.binkid);
+        task.job.binkid = task.binkid.c_str();
+        task.writer->writeHeader(task.binkid, task.job.bink2002 ? ALGORITHM_BINK2002 : ALGORITHM_BINK1998);
+    }
+}
+
+/* Does items [first, first + count) of a task. */
+void BatchRunner::runChunk(BatchTask &task, QWORD first, QWORD count) {
+    auto begin = std::chrono::steady_clock::now();
+
+#if UMSKT_THREADS
+    std::call_once(task.opened, [this, &task] { openTask(task); });
+#else
+    if (!task.opened) {
+        openTask(task);
+        task.opened = true;
+    }
+#endif
+
+    if (task.writer == nullptr) {
+        task.failed += count;
+        return;
+    }
+
+    if (task.type == TASK_GENERATE) {
+        OutputWriter::Buffer out(task.writer);
+
+        KeyRecord record{};
+        record.binkid = task.job.binkid;
+        record.upgrade = task.job.pUpgrade;
+        record.hasAuthInfo = task.job.bink2002;
+        record.channelID = task.job.bink2002 ? task.job.pChannelID : task.job.pSerial / 1'000'000;
+
+        for (QWORD i = first; i < first + count; i++) {
+            if (task.writer->hasFailed() || !KeyPipeline::generateKey(task.job, i, task.verify, record)) {
+                task.failed += first + count - i;
+                break;
+            }
+
+            if (!task.writer->isBinary()) {
+                PIDGEN3::base24(record.key, (BYTE *)record.raw);
+            }
+
+            out.append(record);
+            task.produced++;
+        }
+    } else {
+        char confirmation_id[49];
+
+        for (QWORD i = first; i < first + count; i++) {
+            const std::string &iid = task.iids[i];
+            int err = ConfirmationID::Generate(iid.c_str(), confirmation_id, task.activationMode, task.productid.c_str(), task.overrideVersion);
+
+            if (err == SUCCESS) {
+                task.results[i] = fmt::format("{}\t{}\tok\n", iid, confirmation_id);
+                task.produced++;
+            } else {
+                task.results[i] = fmt::format("{}\t\t{}\n", iid, RequestFields::confidError(err));
+                task.failed++;
+            }
+        }
+    }
+
+    task.busyNanos += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
+}
+
+/* Called after every chunk, the last chunk of a task writes out what has to be in order and closes its output. */
+void BatchRunner::finishChunk(BatchTask &task, std::chrono::steady_clock::time_point started) {
+    if (task.chunksLeft.fetch_sub(1) != 1) {
+        return;
+    }
+
+    if (task.writer != nullptr) {
+        if (task.type == TASK_CONFID) {
+            OutputWriter::Buffer out(task.writer);
+
+            for (std::string &line : task.results) {
+                out.appendRaw(line);
+            }
+        }
+
+        // keys that were produced but never made it to the file don't count
+        if (!task.writer->close()) {
+            fmt::print(stderr, "ERROR: task {}: unable to write output file {}\n", task.name, task.outputFile);
+            task.failed += task.produced.exchange(0);
+        }
+    }
+
+    task.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+}
+
+/* Runs every task, writes summary.json next to the outputs, returns 0 when everything was produced. */
+int BatchRunner::run() {
+    auto started = std::chrono::steady_clock::now();
+
+    {
+        ThreadPool pool(threads);
+
+        // an empty task still gets one chunk, so its output is created and closed like any other
+        std::vector<QWORD> chunks(tasks.size());
+        QWORD rounds = 0;
+
+        for (size_t t = 0; t < tasks.size(); t++) {
+            BatchTask *task = tasks[t].get();
+            QWORD chunk = task->type == TASK_GENERATE ? BATCH_CHUNK_KEYS : BATCH_CHUNK_IIDS;
+
+            chunks[t] = std::max<QWORD>(1, (task->requested + chunk - 1) / chunk);
+            task->chunksLeft = chunks[t];
+            rounds = std::max(rounds, chunks[t]);
+        }
+
+        // The pool runs chunks in the order they are submitted, so they go in round-robin:
+        // chunk r of every task before chunk r + 1 of any, shorter tasks first within a round.
+        // A small task is done within its first rounds no matter what is listed before it.
+        std::vector<size_t> order(tasks.size());
+        for (size_t t = 0; t < order.size(); t++) {
+            order[t] = t;
+        }
+        std::stable_sort(order.begin(), order.end(), [&chunks](size_t a, size_t b) { return chunks[a] < chunks[b]; });
+
+        for (QWORD round = 0; round < rounds; round++) {
+            for (size_t t : order) {
+                if (round >= chunks[t]) {
+                    continue;
+                }
+
+                BatchTask *task = tasks[t].get();
+                QWORD chunk = task->type == TASK_GENERATE ? BATCH_CHUNK_KEYS : BATCH_CHUNK_IIDS;
+                QWORD first = round * chunk;
+                QWORD count = std::min(chunk, task->requested - std::min(first, task->requested));
+
+                pool.submit([this, task, first, count, started] {
+                    runChunk(*task, first, count);
+                    finishChunk(*task, started);
+                });
+            }
+        }
+
+        pool.shutdown();
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    json summary = { { "seconds", seconds }, { "tasks", json::array() } };
+    int status = 0;
+
+    for (auto &entry : tasks) {
+        BatchTask &task = *entry;
+
+        summary["tasks"].push_back({
+                { "name", task.name },
+                { "type", task.type == TASK_GENERATE ? "generate" : "confid" },
+                { "output", task.outputFile },
+                { "requested", task.requested },
+                { "produced", task.produced.load() },
+                { "failed", task.failed.load() },
+                { "seconds", task.seconds },
+                { "busy_seconds", (double)task.busyNanos.load() / 1e9 },
+        });
+
+        fmt::print("{}: {}/{} {} -> {} ({:.3f}s)\n", task.name, task.produced.load(), task.requested,
+                   task.type == TASK_GENERATE ? "keys" : "confirmation IDs", task.outputFile, task.seconds);
+
+        if (task.produced != task.requested) {
+            status = 1;
+        }
+    }
+
+    std::string summaryFile = (fs::path(outputDir) / BATCH_SUMMARY_FILE).string();
+    if (!Checkpoint::replaceFile(summaryFile, summary.dump(2) + "\n")) {
+        fmt::print("ERROR: Unable to write {}\n", summaryFile);
+        return 1;
+    }
+
+    fmt::print("{} tasks in {:.3f}s, summary in {}\n", tasks.size(), seconds, summaryFile);
+    return status;
+}
@@ -0,0 +1,111 @@
+/**
+ * This file is a part of the UMSKT Project
+ *
+ * Copyleft (C) 2019-2023 UMSKT Contributors (et.al.)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @FileCreated by Neo on 10/18/2026
+ * @Maintainer Neo
+ */
+
+
+
+#ifndef UMSKT_BATCH_H
+#define UMSKT_BATCH_H
+
+#include "header.h"
+#include "output.h"
+#include "pipeline.h"
+#include "threadpool.h"
+
+#include "libumskt/libumskt.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+
+#if UMSKT_THREADS
+#include <mutex>
+#endif
+
+#define BATCH_CHUNK_KEYS        4096    // keys per unit of work
+#define BATCH_CHUNK_IIDS        64      // installation IDs per unit of work
+#define BATCH_SUMMARY_FILE      "summary.json"
+
+enum BATCH_TASK_TYPE {
+    TASK_GENERATE = 0,
+    TASK_CONFID   = 1,
+};
+
+/* One entry of a batch manifest, plus the progress made on it. */
+struct BatchTask {
+    std::string name;
+    BATCH_TASK_TYPE type;
+    std::string outputFile;
+
+    // generate: job.binkid points into binkid
+    std::string binkid;
+    PipelineJob job;
+    OUTPUT_FORMAT format;
+    bool verify;
+
+    // confid: one "IID <tab> CID <tab> status" line per installation ID, written in input order
+    int activationMode;
+    std::string productid;
+    bool overrideVersion;
+    std::vector<std::string> iids;
+    std::vector<std::string> results;
+
+    OutputWriter *writer;
+    QWORD requested;
+    std::atomic<QWORD> produced;
+    std::atomic<QWORD> failed;
+    std::atomic<QWORD> busyNanos;
+    std::atomic<size_t> chunksLeft;
+    double seconds;
+#if UMSKT_THREADS
+    std::once_flag opened;
+#else
+    bool opened;
+#endif
+};
+
+/*
+ * Runs a whole manifest of generate and confirmation ID tasks in one process, see `umskt batch`.
+ *
+ * Tasks are cut into small chunks that all go through one shared pool, whichever worker is
+ * free takes the next chunk of whichever task, so a big task never leaves the other cores idle
+ * and small tasks don't wait for it. Curves come from the CurveRegistry and are set up once
+ * per BINK no matter how many tasks use it.
+ */
+class BatchRunner {
+    std::vector<std::unique_ptr<BatchTask>> tasks;
+    std::string outputDir;
+    int threads;
+
+    bool parseTask(const json &entry, const fs::path &baseDir, size_t number);
+    void openTask(BatchTask &task);
+    void runChunk(BatchTask &task, QWORD first, QWORD count);
+    void finishChunk(BatchTask &task, std::chrono::steady_clock::time_point started);
+
+public:
+    explicit BatchRunner(int threads);
+    ~BatchRunner();
+
+    bool load(const std::string &filename);
+    int run();
+};
+
+#endif //UMSKT_BATCH_H
@@ -0,0 +1,545 @@
+/**
+ * This file is a part of the UMSKT Project
+ *
+ * Copyleft (C) 2019-2023 UMSKT Contributors (et.al.)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @FileCreated by Neo on 10/18/2026
+ * @Maintainer Neo
+ */
+
+
+#include "../header.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <new>
+
+#include <cmrc/cmrc.hpp>
+#include <openssl/crypto.h>
+#include <openssl/opensslv.h>
+
+#include "../libumskt/libumskt.h"
+#include "../libumskt/pidgen3/PIDGEN3.h"
+#include "../libumskt/pidgen3/BINK1998.h"
+#include "../libumskt/pidgen3/BINK2002.h"
+#include "../libumskt/pidgen3/CurveRegistry.h"
+#include "../libumskt/confid/confid.h"
+#include "../libumskt/pidgen2/PIDGEN2.h"
+
+CMRC_DECLARE(umskt);
+
+/*
+ * Allocation accounting.
+ *
+ * Both the C++ heap and OpenSSL's allocator are routed through counters, so allocs/op
+ * covers the BIGNUM/EC_POINT churn inside the kernels as well as our own containers.
+ */
+static std::atomic<uint64_t> allocations(0);
+
+// GCC can't tell these replacements apart from the real ones and flags every inlined delete
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpragmas"
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+
+void *operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    void *p = malloc(size ? size : 1);
+    if (p == nullptr) {
+        std::abort();
+    }
+    return p;
+}
+
+void *operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void *p) noexcept {
+    free(p);
+}
+
+void operator delete[](void *p) noexcept {
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+    free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept {
+    free(p);
+}
+
+#pragma GCC diagnostic pop
+
+static void *countingMalloc(size_t size, const char *, int) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return malloc(size);
+}
+
+static void *countingRealloc(void *p, size_t size, const char *, int) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return realloc(p, size);
+}
+
+static void countingFree(void *p, const char *, int) {
+    free(p);
+}
+
+struct BenchResult {
+    std::string name;
+    std::string unit;
+    uint64_t iterations;
+    double nsPerOp;
+    double opsPerSec;
+    double allocsPerOp;
+};
+
+struct BenchOptions {
+    std::string filter;
+    double minSeconds;
+    bool json;
+};
+
+class Bench {
+    BenchOptions options;
+    std::vector<BenchResult> results;
+
+public:
+    explicit Bench(const BenchOptions &options) : options(options) {}
+
+    /* Runs fn in growing batches until the minimum time is reached, then records the per-op figures. */
+    void run(const std::string &name, const std::string &unit, const std::function<void()> &fn) {
+        if (!options.filter.empty() && name.find(options.filter) == std::string::npos) {
+            return;
+        }
+
+        // warm up caches, lazy tables and the allocator
+        for (int i = 0; i < 3; i++) {
+            fn();
+        }
+
+        uint64_t iterations = 0, batch = 1;
+        uint64_t allocStart = allocations.load();
+        auto start = std::chrono::steady_clock::now();
+        double elapsed = 0;
+
+        while (elapsed < options.minSeconds) {
+            for (uint64_t i = 0; i < batch; i++) {
+                fn();
+            }
+            iterations += batch;
+            batch = std::min<uint64_t>(batch * 2, 1 << 20);
+
+            elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+
+        uint64_t allocCount = allocations.load() - allocStart;
+
+        BenchResult result {
+                name,
+                unit,
+                iterations,
+                elapsed * 1e9 / (double)iterations,
+                (double)iterations / elapsed,
+                (double)allocCount / (double)iterations
+        };
+        results.push_back(result);
+
+        if (!options.json) {
+            fmt::print("{:<32} {:>12} {:>14.1f} ns/op {:>14.1f} {}/s {:>8.1f} allocs/op\n",
+                       result.name, result.iterations, result.nsPerOp, result.opsPerSec, result.unit, result.allocsPerOp);
+        }
+    }
+
+    void printJSON() const {
+        json output;
+        output["openssl"] = OPENSSL_VERSION_TEXT;
+        output["min_seconds"] = options.minSeconds;
+        output["benchmarks"] = json::array();
+
+        for (const BenchResult &result : results) {
+            output["benchmarks"].push_back({
+                    { "name", result.name },
+                    { "unit", result.unit },
+                    { "iterations", result.iterations },
+                    { "ns_per_op", result.nsPerOp },
+                    { result.unit + "_per_sec", result.opsPerSec },
+                    { "allocs_per_op", result.allocsPerOp },
+            });
+        }
+
+        fmt::print("{}\n", output.dump(2));
+    }
+};
+
+// confid.cpp keeps the curve of the last Generate call in these
+extern thread_local QWORD MOD, NON_RESIDUE;
+
+// what residue_sqrt returns for a non-square
+#define BAD_ROOT 0xFFFFFFFFFFFFFFFFull
+
+/* Reaches into the private confirmation ID arithmetic. */
+class ConfirmationIDBench {
+public:
+    static void run(Bench &bench) {
+        static const char *iid = "291412-777631-170665-907436-915002-080633-608376-783534-374066";
+        static const char *iidAcc = "665152-077423-528485-435114-879900-515662-962531-517616-970484-883";
+        static const char *names[] = { "windows", "officexp", "office2k3", "office2k7", "plusdme", "officeacc" };
+
+        char cid[49];
+
+        for (int mode = 0; mode <= 5; mode++) {
+            const char *input = mode == 5 ? iidAcc : iid;
+            bench.run(fmt::format("confid_generate_{}", names[mode]), "ids", [&] {
+                ConfirmationID::Generate(input, cid, mode, "12345-678-1234567-12345", true);
+            });
+        }
+
+        // the text kernels on their own
+        unsigned char parsed[20];
+        size_t digits;
+        bench.run("confid_parse_iid", "ids", [&] {
+            ConfirmationID::ParseInstallationID(iid, parsed, &digits);
+        });
+
+        QWORD lo = 0x0123456789ABCDEF, hi = 0x000F0E0D0C0B0A09;
+        bench.run("confid_format_cid", "ids", [&] {
+            ConfirmationID::FormatConfirmationID(lo++, hi, cid);
+        });
+
+        int fields[4];
+        bench.run("confid_parse_pid", "ids", [&] {
+            ConfirmationID::ParseProductID("12345-OEM-1234567-12345", fields);
+        });
+
+        // a matching pair costs one divisor_mul128, a CID that does not decode costs none
+        ConfirmationID::Generate(iid, cid, 0, "", true);
+        bench.run("confid_verify", "pairs", [&] {
+            ConfirmationID::Verify(iid, cid, 0, "", true);
+        });
+
+        static const char *garbage = "111110-222220-333330-444440-555550-666660-777770";
+        bench.run("confid_verify_garbage", "pairs", [&] {
+            ConfirmationID::Verify(iid, garbage, 0, "", true);
+        });
+
+        // leave the globals set up for the Windows curve
+        ConfirmationID::Generate(iid, cid, 0, "", true);
+
+        QWORD x = 0x123456789ABCDEF % MOD, y = 0xFEDCBA987654321 % MOD;
+        bench.run("confid_residue_mul", "ops", [&] {
+            x = ConfirmationID::residue_mul(x, y);
+        });
+
+        bench.run("confid_residue_inv", "ops", [&] {
+            x = ConfirmationID::residue_inv(x) + 1;
+        });
+
+        // about half the inputs are squares, like in find_divisor_v
+        bench.run("confid_residue_sqrt", "ops", [&] {
+            y = ConfirmationID::residue_sqrt(x);
+            x = ConfirmationID::residue_add(x, y == BAD_ROOT ? 1 : y);
+        });
+
+        // the per attempt hashing of Generate, one buffer at a time and CONFID_LANES at once
+        unsigned char key[16] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16 };
+        unsigned char buffers[CONFID_LANES][14] = {};
+        unsigned char *lanes[CONFID_LANES];
+        for (int lane = 0; lane < CONFID_LANES; lane++) {
+            lanes[lane] = buffers[lane];
+        }
+
+        bench.run("confid_mix", "ops", [&] {
+            for (int lane = 0; lane < CONFID_LANES; lane++) {
+                ConfirmationID::Mix(lanes[lane], 14, key, 16);
+            }
+        });
+
+        bench.run("confid_mix_lanes", "ops", [&] {
+            ConfirmationID::MixLanes(lanes, 14, key, 16);
+        });
+
+        // find a valid divisor the same way Generate does
+        TDivisor d{};
+        for (QWORD x1 = 1;; x1++) {
+            d.u[0] = ConfirmationID::residue_sub(ConfirmationID::residue_mul(x1, x1), ConfirmationID::residue_mul(NON_RESIDUE, 4));
+            d.u[1] = ConfirmationID::residue_add(x1, x1);
+            if (ConfirmationID::find_divisor_v(&d)) {
+                break;
+            }
+        }
+
+        TDivisor r;
+        bench.run("confid_divisor_mul128", "ops", [&] {
+            ConfirmationID::divisor_mul128(&d, 0x04E21B9D10F127C1, 0x40DA7C36D44C, &r);
+        });
+    }
+};
+
+static PIDGEN3::BINKParams loadParams(json &keys, const std::string &binkid) {
+    json &bink = keys["BINK"][binkid];
+
+    return PIDGEN3::BINKParams {
+            bink["p"].get<std::string>(),
+            bink["a"].get<std::string>(),
+            bink["b"].get<std::string>(),
+            bink["g"]["x"].get<std::string>(),
+            bink["g"]["y"].get<std::string>(),
+            bink["pub"]["x"].get<std::string>(),
+            bink["pub"]["y"].get<std::string>(),
+            bink["n"].get<std::string>(),
+            bink["priv"].get<std::string>()
+    };
+}
+
+static void benchPIDGEN3(Bench &bench, json &keys) {
+    PIDGEN3::CurveRegistry::add("2E", loadParams(keys, "2E"));
+    PIDGEN3::CurveRegistry::add("40", loadParams(keys, "40"));
+
+    const PIDGEN3::BINKCurve &xp = *PIDGEN3::CurveRegistry::get("2E");
+    const PIDGEN3::BINKCurve &srv = *PIDGEN3::CurveRegistry::get("40");
+
+    char pKey[PK_LENGTH + NULL_TERMINATOR];
+    QWORD pRaw[2]{};
+
+    PIDGEN3::BINK1998::Generate(xp, 640'000'000, false, pRaw);
+    PIDGEN3::base24(pKey, (BYTE *)pRaw);
+
+    bench.run("pidgen3_base24", "ops", [&] {
+        PIDGEN3::base24(pKey, (BYTE *)pRaw);
+    });
+
+    bench.run("pidgen3_unbase24", "ops", [&] {
+        PIDGEN3::unbase24((BYTE *)pRaw, pKey);
+    });
+
+    // SHA message assembly exactly as BINK1998/BINK2002 do it, from point coordinates to digest
+    BN_CTX *ctx = BN_CTX_new();
+    BIGNUM *x = BN_new(), *y = BN_new();
+    EC_POINT_get_affine_coordinates(xp.eCurve, xp.pubPoint, x, y, ctx);
+
+    bench.run("sha_message_1998", "ops", [&] {
+        BYTE msgDigest[SHA_DIGEST_LENGTH], msgBuffer[SHA_MSG_LENGTH_XP], xBin[FIELD_BYTES], yBin[FIELD_BYTES];
+        DWORD pData = 640'000'000 << 1;
+
+        PIDGEN3::BN_bn2lebin(x, xBin, FIELD_BYTES);
+        PIDGEN3::BN_bn2lebin(y, yBin, FIELD_BYTES);
+
+        memcpy(&msgBuffer[0], &pData, 4);
+        memcpy(&msgBuffer[4], xBin, FIELD_BYTES);
+        memcpy(&msgBuffer[4 + FIELD_BYTES], yBin, FIELD_BYTES);
+
+        SHA1(msgBuffer, SHA_MSG_LENGTH_XP, msgDigest);
+    });
+
+    EC_POINT_get_affine_coordinates(srv.eCurve, srv.pubPoint, x, y, ctx);
+
+    bench.run("sha_message_2002", "ops", [&] {
+        BYTE msgDigest[SHA_DIGEST_LENGTH], msgBuffer[SHA_MSG_LENGTH_2003], xBin[FIELD_BYTES_2003], yBin[FIELD_BYTES_2003];
+
+        PIDGEN3::BN_bn2lebin(x, xBin, FIELD_BYTES_2003);
+        PIDGEN3::BN_bn2lebin(y, yBin, FIELD_BYTES_2003);
+
+        msgBuffer[0x00] = 0x79;
+        msgBuffer[0x01] = 0x00;
+        msgBuffer[0x02] = 0x05;
+        memcpy(&msgBuffer[3], xBin, FIELD_BYTES_2003);
+        memcpy(&msgBuffer[3 + FIELD_BYTES_2003], yBin, FIELD_BYTES_2003);
+
+        SHA1(msgBuffer, SHA_MSG_LENGTH_2003, msgDigest);
+    });
+
+    // raw scalar multiplication with full size scalars, then the reduced/table path used by Generate
+    BIGNUM *k384 = BN_new(), *k512 = BN_new();
+    BN_rand(k384, FIELD_BITS, BN_RAND_TOP_ANY, BN_RAND_BOTTOM_ANY);
+    BN_rand(k512, FIELD_BITS_2003, BN_RAND_TOP_ANY, BN_RAND_BOTTOM_ANY);
+
+    EC_POINT *r384 = EC_POINT_new(xp.eCurve), *r512 = EC_POINT_new(srv.eCurve);
+
+    bench.run("ec_point_mul_384", "ops", [&] {
+        EC_POINT_mul(xp.eCurve, r384, nullptr, xp.pubPoint, k384, ctx);
+    });
+
+    bench.run("ec_point_mul_512", "ops", [&] {
+        EC_POINT_mul(srv.eCurve, r512, nullptr, srv.pubPoint, k512, ctx);
+    });
+
+    bench.run("ec_mul_generator_384", "ops", [&] {
+        xp.mulGenerator(r384, k384, ctx);
+    });
+
+    bench.run("ec_mul_generator_512", "ops", [&] {
+        srv.mulGenerator(r512, k512, ctx);
+    });
+
+    // Verify sized scalars on the public key and a variable point, plain OpenSSL against the endomorphism split
+    BIGNUM *h384 = BN_new(), *h512 = BN_new();
+    BN_rand(h384, 28, BN_RAND_TOP_ANY, BN_RAND_BOTTOM_ANY);
+    BN_rand(h512, 62, BN_RAND_TOP_ANY, BN_RAND_BOTTOM_ANY);
+
+    EC_POINT *v512 = EC_POINT_new(srv.eCurve);
+    EC_POINT_add(srv.eCurve, v512, srv.genPoint, srv.pubPoint, ctx);
+
+    bench.run("ec_mul_public_384_plain", "ops", [&] {
+        EC_POINT_mul(xp.eCurve, r384, nullptr, xp.pubPoint, h384, ctx);
+    });
+
+    bench.run("ec_mul_public_384", "ops", [&] {
+        xp.mulPublic(r384, h384, ctx);
+    });
+
+    bench.run("ec_mul_public_512_plain", "ops", [&] {
+        EC_POINT_mul(srv.eCurve, r512, nullptr, srv.pubPoint, h512, ctx);
+    });
+
+    bench.run("ec_mul_public_512", "ops", [&] {
+        srv.mulPublic(r512, h512, ctx);
+    });
+
+    bench.run("ec_mul_variable_512_plain", "ops", [&] {
+        EC_POINT_mul(srv.eCurve, r512, nullptr, v512, h512, ctx);
+    });
+
+    bench.run("ec_mul_endomorphism_512", "ops", [&] {
+        srv.mulEndomorphism(r512, v512, h512, ctx);
+    });
+
+    bench.run("bink1998_generate", "keys", [&] {
+        PIDGEN3::BINK1998::Generate(xp, 640'000'000, false, pRaw);
+    });
+
+    bench.run("bink1998_verify", "keys", [&] {
+        PIDGEN3::BINK1998::Verify(xp, pRaw);
+    });
+
+    bench.run("bink2002_generate", "keys", [&] {
+        PIDGEN3::BINK2002::Generate(srv, 640, 0, false, 0, 999999, nullptr, pRaw);
+    });
+
+    bench.run("bink2002_verify", "keys", [&] {
+        PIDGEN3::BINK2002::Verify(srv, nullptr, pRaw);
+    });
+
+    // macro: what the CLI does per key, text in and out
+    char key[25];
+    bench.run("bink1998_key_roundtrip", "keys", [&] {
+        PIDGEN3::BINK1998::Generate(xp, 640'000'000, false, key);
+        PIDGEN3::BINK1998::Verify(xp, key);
+    });
+
+    bench.run("bink2002_key_roundtrip", "keys", [&] {
+        PIDGEN3::BINK2002::Generate(srv, 640, 0, false, 0, 999999, key);
+        PIDGEN3::BINK2002::Verify(srv, nullptr, key);
+    });
+
+    EC_POINT_free(r384);
+    EC_POINT_free(r512);
+    EC_POINT_free(v512);
+    BN_free(h384);
+    BN_free(h512);
+    BN_free(k384);
+    BN_free(k512);
+    BN_free(x);
+    BN_free(y);
+    BN_CTX_free(ctx);
+}
+
+static void benchPIDGEN2(Bench &bench) {
+    char key[PIDGEN2_OEM_LENGTH + NULL_TERMINATOR];
+
+    bench.run("pidgen2_generate_retail", "keys", [&] {
+        PIDGEN2::Generate(PIDGEN2_RETAIL, key);
+    });
+
+    bench.run("pidgen2_generate_oem", "keys", [&] {
+        PIDGEN2::Generate(PIDGEN2_OEM, key);
+    });
+
+    // 1000 keys per call, starting just before a site and a date roll over
+    static char chunk[1000 * (PIDGEN2_OEM_LENGTH + 1)];
+
+    bench.run("pidgen2_generate_batch", "1k keys", [&] {
+        PIDGEN2::Generate(PIDGEN2_OEM, 1000, chunk, '\n');
+    });
+
+    bench.run("pidgen2_enumerate_retail", "1k keys", [&] {
+        PIDGEN2::Enumerate(PIDGEN2_RETAIL, PIDGEN2_BLOCKS - 500, 1000, chunk, '\n');
+    });
+
+    bench.run("pidgen2_enumerate_oem", "1k keys", [&] {
+        PIDGEN2::Enumerate(PIDGEN2_OEM, (QWORD)PIDGEN2_OEM_BLOCKS * PIDGEN2_OEM_TAILS - 500, 1000, chunk, '\n');
+    });
+
+    // the keys Enumerate just wrote, as a file of them would look
+    QWORD bitmap[1000 / 64 + 1];
+    bench.run("pidgen2_validate_batch", "1k keys", [&] {
+        PIDGEN2::ValidateBatch(PIDGEN2_OEM, chunk, PIDGEN2_OEM_LENGTH + 1, 1000, bitmap);
+    });
+}
+
+static void showHelp(char *argv[]) {
+    fmt::print("usage: {} \n", argv[0]);
+    fmt::print("\t-h --help\tshow this message\n");
+    fmt::print("\t-j --json\twrite results as JSON\n");
+    fmt::print("\t-f --filter\tonly run benchmarks whose name contains this string\n");
+    fmt::print("\t-t --time\tminimum seconds to spend on each benchmark (defaults to 0.5)\n");
+}
+
+int main(int argc, char *argv[]) {
+    // has to happen before OpenSSL allocates anything
+    CRYPTO_set_mem_functions(countingMalloc, countingRealloc, countingFree);
+
+    BenchOptions options { "", 0.5, false };
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+
+        if (arg == "-j" || arg == "--json") {
+            options.json = true;
+        } else if ((arg == "-f" || arg == "--filter") && i < argc - 1) {
+            options.filter = argv[++i];
+        } else if ((arg == "-t" || arg == "--time") && i < argc - 1) {
+            options.minSeconds = atof(argv[++i]);
+        } else {
+            showHelp(argv);
+            return arg == "-h" || arg == "--help" ? 0 : 1;
+        }
+    }
+
+    cmrc::embedded_filesystem fs = cmrc::umskt::get_filesystem();
+    cmrc::file keysFile = fs.open("keys.json");
+    json keys = json::parse(keysFile, nullptr, false, false);
+
+    if (keys.is_discarded()) {
+        fmt::print("ERROR: Unable to parse the internal keys file\n");
+        return 1;
+    }
+
+    Bench bench(options);
+
+    benchPIDGEN3(bench, keys);
+    benchPIDGEN2(bench);
+    ConfirmationIDBench::run(bench);
+
+    if (options.json) {
+        bench.printJSON();
+    }
+
+    return 0;
+}
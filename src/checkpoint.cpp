@@ -0,0 +1,277 @@
+/**
+ * This file is a part of the UMSKT Project
+ *
+ * Copyleft (C) 2019-2023 UMSKT Contributors (et.al.)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @FileCreated by Neo on 10/18/2026
+ * @Maintainer Neo
+ */
+
+
+#include "checkpoint.h"
+
+#include <algorithm>
+
+#if UMSKT_HAVE_WRITEV
+#include <unistd.h>
+#endif
+
+Checkpoint::Checkpoint(const std::string &filename, int interval) :
+    filename(filename), interval(interval), lastSave(std::time(nullptr)), state{} {
+}
+
+void JobParameters::toJSON(json &data) const {
+    data["bink"] = binkid;
+    data["format"] = OutputWriter::formatName(format);
+    data["nodashes"] = nodashes;
+    data["nonewlines"] = nonewlines;
+    data["channel"] = channelID;
+    data["serial_min"] = serMin;
+    data["serial_max"] = serMax;
+    data["serial_set"] = serialSet;
+    data["serial"] = pSerial;
+    data["upgrade"] = (bool)upgrade;
+    data["total"] = total;
+    data["seed"] = seed;
+    data["shard"] = { { "index", shardIndex }, { "count", shardCount } };
+}
+
+/* Counterpart of toJSON, false if anything is missing or of the wrong type. */
+bool JobParameters::fromJSON(const json &data) {
+    static const char *numbers[] = { "channel", "serial_min", "serial_max", "serial", "total", "seed" };
+    static const char *flags[] = { "nodashes", "nonewlines", "serial_set", "upgrade" };
+
+    if (!data.is_object() || !data.contains("bink") || !data["bink"].is_string() || !data.contains("format") || !data["format"].is_string()) {
+        return false;
+    }
+
+    for (const char *name : numbers) {
+        if (!data.contains(name) || !data[name].is_number_unsigned()) {
+            return false;
+        }
+    }
+    for (const char *name : flags) {
+        if (!data.contains(name) || !data[name].is_boolean()) {
+            return false;
+        }
+    }
+
+    if (!OutputWriter::parseFormat(data["format"].get<std::string>(), &format)) {
+        return false;
+    }
+
+    // runs from before sharding existed are shard 0 of 1
+    shardIndex = 0;
+    shardCount = 1;
+
+    if (data.contains("shard")) {
+        const json &shard = data["shard"];
+        if (!shard.is_object() || !shard.contains("index") || !shard["index"].is_number_unsigned() || !shard.contains("count") || !shard["count"].is_number_unsigned()) {
+            return false;
+        }
+
+        shardIndex = shard["index"].get<DWORD>();
+        shardCount = shard["count"].get<DWORD>();
+
+        if (shardCount == 0 || shardIndex >= shardCount) {
+            return false;
+        }
+    }
+
+    binkid = data["bink"].get<std::string>();
+    nodashes = data["nodashes"].get<bool>();
+    nonewlines = data["nonewlines"].get<bool>();
+    channelID = data["channel"].get<DWORD>();
+    serMin = data["serial_min"].get<DWORD>();
+    serMax = data["serial_max"].get<DWORD>();
+    serialSet = data["serial_set"].get<bool>();
+    pSerial = data["serial"].get<DWORD>();
+    upgrade = data["upgrade"].get<bool>();
+    total = data["total"].get<QWORD>();
+    seed = data["seed"].get<QWORD>();
+
+    return true;
+}
+
+/* Whether two runs are parts of the same job, they may only differ in which shard they are. */
+bool JobParameters::sameJob(const JobParameters &other) const {
+    return binkid == other.binkid && format == other.format && nodashes == other.nodashes && nonewlines == other.nonewlines &&
+           channelID == other.channelID && serMin == other.serMin && serMax == other.serMax && serialSet == other.serialSet &&
+           pSerial == other.pSerial && !upgrade == !other.upgrade && total == other.total && seed == other.seed && shardCount == other.shardCount;
+}
+
+/* The first stream from index on that a resumed run still has to write. */
+QWORD CheckpointState::nextUnwritten(QWORD index) const {
+    auto it = std::lower_bound(ahead.begin(), ahead.end(), index);
+    while (it != ahead.end() && *it == index) {
+        ++it;
+        index++;
+    }
+    return index;
+}
+
+/* Reads a checkpoint file, false if it's missing, malformed or from a different version. */
+bool Checkpoint::load(const std::string &filename, CheckpointState *state) {
+    std::ifstream f(filename);
+    if (!f) {
+        return false;
+    }
+
+    json data = json::parse(f, nullptr, false, false);
+    if (data.is_discarded() || !data.is_object() || data.value("version", 0) != CHECKPOINT_VERSION || !state->job.fromJSON(data)) {
+        return false;
+    }
+
+    static const char *numbers[] = { "written", "offset", "next_index" };
+    static const char *flags[] = { "held_terminator", "complete" };
+
+    if (!data.contains("output") || !data["output"].is_string()) {
+        return false;
+    }
+    for (const char *name : numbers) {
+        if (!data.contains(name) || !data[name].is_number_unsigned()) {
+            return false;
+        }
+    }
+    for (const char *name : flags) {
+        if (!data.contains(name) || !data[name].is_boolean()) {
+            return false;
+        }
+    }
+
+    state->outputFile = data["output"].get<std::string>();
+    state->written = data["written"].get<QWORD>();
+    state->offset = data["offset"].get<QWORD>();
+    state->heldTerminator = data["held_terminator"].get<bool>();
+    state->nextIndex = data["next_index"].get<QWORD>();
+    state->complete = data["complete"].get<bool>();
+
+    // left out while nothing was written out of order, runs of streams are stored as [first, last]
+    state->ahead.clear();
+    if (data.contains("ahead")) {
+        if (!data["ahead"].is_array()) {
+            return false;
+        }
+        for (const json &range : data["ahead"]) {
+            if (!range.is_array() || range.size() != 2 || !range[0].is_number_unsigned() || !range[1].is_number_unsigned()) {
+                return false;
+            }
+
+            QWORD first = range[0].get<QWORD>(), last = range[1].get<QWORD>();
+            if (first <= state->nextIndex || last < first || (!state->ahead.empty() && first <= state->ahead.back())) {
+                return false;
+            }
+            for (QWORD index = first; index <= last; index++) {
+                state->ahead.push_back(index);
+            }
+        }
+    }
+
+    return true;
+}
+
+/* Replaces a file, written to a temporary file first so a crash never leaves half of one. */
+bool Checkpoint::replaceFile(const std::string &filename, const std::string &text) {
+    std::string temporary = filename + ".tmp";
+
+    std::FILE *file = std::fopen(temporary.c_str(), "wb");
+    if (file == nullptr) {
+        return false;
+    }
+
+    bool ok = std::fwrite(text.data(), 1, text.size(), file) == text.size() && std::fflush(file) == 0;
+#if UMSKT_HAVE_WRITEV
+    ok = ok && fsync(fileno(file)) == 0;
+#endif
+    ok = std::fclose(file) == 0 && ok;
+
+    std::error_code error;
+    if (ok) {
+        fs::rename(temporary, filename, error);
+    }
+
+    if (!ok || error) {
+        fs::remove(temporary, error);
+        return false;
+    }
+
+    return true;
+}
+
+bool Checkpoint::save() {
+    json data = { { "version", CHECKPOINT_VERSION } };
+    state.job.toJSON(data);
+
+    data["output"] = state.outputFile;
+    data["written"] = state.written;
+    data["offset"] = state.offset;
+    data["held_terminator"] = state.heldTerminator;
+    data["next_index"] = state.nextIndex;
+    if (!state.ahead.empty()) {
+        json ranges = json::array();
+        for (QWORD index : state.ahead) {
+            if (!ranges.empty() && ranges.back()[1].get<QWORD>() + 1 == index) {
+                ranges.back()[1] = index;
+            } else {
+                ranges.push_back({ index, index });
+            }
+        }
+        data["ahead"] = ranges;
+    }
+    data["complete"] = state.complete;
+
+    if (!replaceFile(filename, data.dump(2) + "\n")) {
+        return false;
+    }
+
+    lastSave = std::time(nullptr);
+    return true;
+}
+
+bool Checkpoint::due() const {
+    return std::time(nullptr) - lastSave >= interval;
+}
+
+/* Puts everything written so far on disk, then records how far the run got. */
+bool Checkpoint::record(OutputWriter *writer, QWORD nextIndex) {
+    if (!writer->sync()) {
+        return false;
+    }
+
+    state.offset = writer->tell();
+    state.heldTerminator = writer->holdsTerminator();
+    state.nextIndex = nextIndex;
+
+    // the sequential loops only ever move nextIndex past streams in ahead
+    state.ahead.erase(state.ahead.begin(), std::lower_bound(state.ahead.begin(), state.ahead.end(), nextIndex));
+    return save();
+}
+
+/* Same, for a run that wrote the streams in ahead past nextIndex already. */
+bool Checkpoint::record(OutputWriter *writer, QWORD nextIndex, const std::vector<QWORD> &ahead) {
+    state.ahead = ahead;
+    return record(writer, nextIndex);
+}
+
+/* Marks the run as done, the writer has to be closed already. */
+bool Checkpoint::finish(OutputWriter *writer, QWORD nextIndex) {
+    state.offset = writer->tell();
+    state.heldTerminator = false;
+    state.nextIndex = nextIndex;
+    state.ahead.clear();
+    state.complete = true;
+    return save();
+}
@@ -0,0 +1,100 @@
+/**
+ * This file is a part of the UMSKT Project
+ *
+ * Copyleft (C) 2019-2023 UMSKT Contributors (et.al.)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @FileCreated by Neo on 10/18/2026
+ * @Maintainer Neo
+ */
+
+#ifndef UMSKT_CHECKPOINT_H
+#define UMSKT_CHECKPOINT_H
+
+#include "header.h"
+#include "output.h"
+
+#include "libumskt/libumskt.h"
+
+#define CHECKPOINT_VERSION          1
+#define CHECKPOINT_DEFAULT_INTERVAL 30      // seconds
+
+/* Parameters of a bulk generate run, shared by checkpoints and shard manifests (see shard.h). */
+struct JobParameters {
+    std::string binkid;
+    OUTPUT_FORMAT format;
+    bool nodashes;
+    bool nonewlines;
+    DWORD channelID;
+    DWORD serMin, serMax;
+    bool serialSet;
+    DWORD pSerial;          // BINK1998: channel * 1'000'000 + serial, picked once per job
+    BOOL upgrade;
+    QWORD total;            // keys in the whole job, across all shards
+    QWORD seed;
+    DWORD shardIndex, shardCount;
+
+    void toJSON(json &data) const;
+    bool fromJSON(const json &data);
+    bool sameJob(const JobParameters &other) const;
+};
+
+/*
+ * Everything needed to pick a bulk run back up where it stopped.
+ *
+ * Key number i of a run draws its randomness from stream i of the run's seed (see
+ * UMSKT::setRandomStream), so a run is described by its parameters plus how far it got:
+ * the first offset bytes of the output hold written complete keys, every stream below
+ * nextIndex is among them, and so are the streams listed in ahead. Keys are written out
+ * of order, so streams that were still in flight when the run stopped are redone on a
+ * resume, and the ones in ahead are not, so no key goes missing or shows up twice.
+ */
+struct CheckpointState {
+    JobParameters job;
+    std::string outputFile;
+
+    QWORD written;
+    QWORD offset;
+    bool heldTerminator;
+    QWORD nextIndex;
+    std::vector<QWORD> ahead;   // sorted, all past nextIndex
+    bool complete;
+
+    QWORD nextUnwritten(QWORD index) const;
+};
+
+/* A checkpoint file, rewritten atomically every interval seconds while a run makes progress. */
+class Checkpoint {
+    std::string filename;
+    int interval;
+    time_t lastSave;
+
+public:
+    CheckpointState state;
+
+    Checkpoint(const std::string &filename, int interval);
+
+    static bool load(const std::string &filename, CheckpointState *state);
+    static bool replaceFile(const std::string &filename, const std::string &text);
+    bool save();
+
+    void advance(QWORD records) { state.written += records; }
+    bool due() const;
+    bool record(OutputWriter *writer, QWORD nextIndex);
+    bool record(OutputWriter *writer, QWORD nextIndex, const std::vector<QWORD> &ahead);
+    bool finish(OutputWriter *writer, QWORD nextIndex);
+};
+
+#endif //UMSKT_CHECKPOINT_H
@@ -22,15 +22,6 @@
 
 #include "cli.h"
 
-CLI::~CLI()
-{
-    EC_GROUP_free(eCurve);
-    EC_POINT_free(genPoint);
-    EC_POINT_free(pubPoint);
-    BN_free(privateKey);
-    BN_free(genOrder);
-}
-
 bool CLI::loadJSON(const fs::path& filename, json *output) {
     if (!filename.empty() && !fs::exists(filename)) {
         fmt::print("ERROR: File {} does not exist\n", filename.string());
@@ -63,6 +54,7 @@ void CLI::showHelp(char *argv[]) {
     fmt::print("\t-f --file\tspecify which keys file to load\n");
     fmt::print("\t-i --instid\tinstallation ID used to generate confirmation ID (reads from stdin if no argument provided)\n");
     fmt::print("\t-m --mode\tproduct family to activate.\n\t\t\tvalid options are \"WINDOWS\", \"OFFICEXP\", \"OFFICE2K3\", \"OFFICE2K7\", \"PLUSDME\", or \"OFFICEACC\"\n\t\t\t(defaults to \"WINDOWS\")\n");
+    fmt::print("\t   --cid\twith -i, check that this confirmation ID belongs to the installation ID instead\n");
     fmt::print("\t-p --productid\tthe product ID of the Program to activate. only required for Office 2K3 and Office 2K7 programs\n");
     fmt::print("\t-b --binkid\tspecify which BINK identifier to load (defaults to 2E)\n");
     fmt::print("\t-l --list\tshow which products/binks can be loaded\n");
@@ -72,38 +64,164 @@ void CLI::showHelp(char *argv[]) {
     fmt::print("\t-V --validate\tproduct key to validate signature\n");
     fmt::print("\t-N --nonewlines\tdisables newlines (for easier embedding in other apps)\n");
     fmt::print("\t-o --override\tDisables version check for confirmation IDs, if you need this send an issue on GitHub\n");
-    fmt::print("\t-D --nodashes\tDisables dashes in product keys and confirmation IDs (for easier copy-pasting)");
+    fmt::print("\t-D --nodashes\tDisables dashes in product keys and confirmation IDs (for easier copy-pasting)\n");
+    fmt::print("\t-O --output\twrite generated keys to a file instead of stdout\n");
+    fmt::print("\t-F --format\toutput format for generated keys.\n\t\t\tvalid options are \"PLAIN\", \"NODASH\", \"CSV\", \"JSONL\", \"NUL\" or \"BINARY\" (defaults to \"PLAIN\")\n");
+    fmt::print("\t-T --threads\tworkers for the generate, verify and format stages when generating in bulk\n\t\t\t(eg. 4,12,1 - any stage left out or 0 is sized automatically)\n\t\t\ta single BINK2002 key in a narrow --serial range is searched for\n\t\t\twith as many workers as the first number, every core by default\n");
+    fmt::print("\t-x --noverify\tskip verifying generated keys\n");
+    fmt::print("\t-U --unique\tnever output the same key twice in a run, duplicates are regenerated\n");
+    fmt::print("\t-L --ledger\trecord generated keys in this ledger and never issue a key it already holds,\n\t\t\twith --validate, look the key up in it\n");
+    fmt::print("\t   --unique-memory\tmemory for --unique in MiB (defaults to {}, at least {}), past half of it\n\t\t\ta Bloom filter is used, which has no exact fallback and may reject fresh keys\n", DEDUPE_DEFAULT_MEMORY, DEDUPE_MIN_MEMORY);
+    fmt::print("\t   --checkpoint\tperiodically record the progress of a bulk run in this file, needs --output\n");
+    fmt::print("\t   --checkpoint-interval\tseconds between checkpoints (defaults to {})\n", CHECKPOINT_DEFAULT_INTERVAL);
+    fmt::print("\t   --resume\tcontinue the run recorded in this checkpoint file, with the parameters it was started with\n");
+    fmt::print("\t   --shard\tgenerate part i/N of a job split across machines (eg. 3/16), needs --seed and --output,\n\t\t\t-n is the size of the whole job. writes a manifest next to the output\n");
+    fmt::print("\t   --seed\tdraw keys from deterministic random streams, the same seed gives the same keys\n");
+    fmt::print("\t-S --stats\tprint attempt counts, rejection reasons and per-phase timings to stderr when done\n");
+    fmt::print("\t   --stats-json\tsame as --stats, formatted as JSON\n");
+    fmt::print("\t-R --read\tdecode a binary key file, writing its keys in the selected --format\n");
+    fmt::print("\t   --iid-file\tgenerate confirmation IDs for every installation ID in this file, \"-\" reads stdin.\n\t\t\teach line is IID [<tab> MODE] [<tab> PRODUCT ID], -m and -p fill in what is left out,\n\t\t\twrites IID <tab> CID <tab> status lines in input order, --workers sets the workers\n");
+    fmt::print("\t   --verify-file\tsame as --iid-file for lines of IID <tab> CID [<tab> MODE] [<tab> PRODUCT ID],\n\t\t\tchecking that each confirmation ID belongs to its installation ID\n");
+    fmt::print("\t   --cache\twith --iid-file or --verify-file, remember this many confirmation IDs so repeated\n\t\t\tinstallation IDs are answered at once, --cache-file keeps them between runs\n");
+    fmt::print("\t-A --audit\tvalidate every key in a binary key file\n");
+    fmt::print("\t   --pidgen2\tgenerate -n random Windows 95 era 10-digit keys, \"RETAIL\" (123-4567890)\n\t\t\tor \"OEM\" (12345-OEM-0123456-12345)\n");
+    fmt::print("\t\t\twith -V checks a single key, with -A every line of a text file (\"-\" reads stdin)\n");
+    fmt::print("\t   --enumerate\twith --pidgen2, write every valid key in order starting at this index,\n\t\t\t-n of them, -n 0 runs to the end of the keyspace\n");
+    fmt::print("\n");
+    fmt::print("usage: {} serve [--socket PATH] [--port N] [--workers N]\n", argv[0]);
+    fmt::print("\t   --socket\tanswer newline delimited JSON requests on a Unix domain socket\n");
+    fmt::print("\t   --port\tanswer JSON requests over HTTP on 127.0.0.1\n");
+    fmt::print("\t   --workers\tnumber of requests answered at once (defaults to one per core)\n");
+    fmt::print("\t   --pool\tkeep this many verified keys ready per generate profile, refilled in the background\n");
+    fmt::print("\t   --pool-dir\tpersist the key pools in this directory so they survive a restart\n");
+    fmt::print("\t   --cache\tremember up to this many confid and validate results, repeated requests skip the math\n");
+    fmt::print("\t   --cache-file\tload the --cache from this snapshot at startup and save it there on shutdown\n");
+    fmt::print("\n");
+    fmt::print("usage: {} merge --output FILE SHARD...\n", argv[0]);
+    fmt::print("\tchecks the manifests of the given --shard outputs and joins them into one file, in shard order\n");
+    fmt::print("\n");
+    fmt::print("usage: {} batch MANIFEST [--workers N]\n", argv[0]);
+    fmt::print("\truns every generate and confid task listed in a JSON manifest on one shared pool of workers,\n\t\t\twriting one output per task and a summary.json\n");
     fmt::print("\n");
 }
 
 int CLI::parseCommandLine(int argc, char* argv[], Options* options) {
     // set default options
-    *options = Options {
-            "2E",
-            "",
-            "",
-            "",
-            "",
-            640,
-            0,
-            999999,
-            1,
-            false,
-            false,
-            false,
-            false,
-            false,
-            false,
-	    false,
-	    false,
-	    false,
-            MODE_BINK1998_GENERATE,
-            WINDOWS
-    };
+    *options = Options();
 
     for (int i = 1; i < argc; i++) {
         std::string arg = argv[i];
-        if (arg == "-v" || arg == "--verbose") {
+        if (i == 1 && arg == "serve") {
+            options->applicationMode = MODE_SERVE;
+        } else if (i == 1 && arg == "merge") {
+            options->applicationMode = MODE_MERGE;
+        } else if (i == 1 && arg == "batch") {
+            options->applicationMode = MODE_BATCH;
+        } else if (options->applicationMode == MODE_BATCH && arg[0] != '-' && options->inputFile.empty()) {
+            options->inputFile = arg;
+        } else if (options->applicationMode == MODE_MERGE && arg[0] != '-') {
+            options->mergeInputs.push_back(arg);
+        } else if (arg == "--shard") {
+            if (i == argc - 1) {
+                options->error = true;
+                break;
+            }
+
+            DWORD index, count;
+            if (!KeyShards::parseSpec(argv[i+1], &index, &count)) {
+                options->error = true;
+            } else {
+                options->shardIndex = (int)index;
+                options->shardCount = (int)count;
+                options->sharded = true;
+            }
+            i++;
+        } else if (arg == "--socket") {
+            if (i == argc - 1) {
+                options->error = true;
+                break;
+            }
+
+            options->socketPath = argv[i+1];
+            i++;
+        } else if (arg == "--pool-dir") {
+            if (i == argc - 1) {
+                options->error = true;
+                break;
+            }
+
+            options->poolDir = argv[i+1];
+            i++;
+        } else if (arg == "--cache-file") {
+            if (i == argc - 1) {
+                options->error = true;
+                break;
+            }
+
+            options->cacheFile = argv[i+1];
+            i++;
+        } else if (arg == "-L" || arg == "--ledger") {
+            if (i == argc - 1) {
+                options->error = true;
+                break;
+            }
+
+            options->ledgerFile = argv[i+1];
+            i++;
+        } else if (arg == "--checkpoint" || arg == "--resume") {
+            if (i == argc - 1) {
+                options->error = true;
+                break;
+            }
+
+            options->checkpointFile = argv[i+1];
+            options->resume = arg == "--resume";
+            i++;
+        } else if (arg == "--seed") {
+            if (i == argc - 1) {
+                options->error = true;
+                break;
+            }
+
+            unsigned long long seed;
+            if (sscanf(argv[i+1], "%llu", &seed) != 1) {
+                options->error = true;
+            } else {
+                options->seed = seed;
+                options->seedSet = true;
+            }
+            i++;
+        } else if (arg == "-U" || arg == "--unique") {
+            options->unique = true;
+        } else if (arg == "--port" || arg == "--workers" || arg == "--pool" || arg == "--unique-memory" || arg == "--checkpoint-interval" || arg == "--cache") {
+            if (i == argc - 1) {
+                options->error = true;
+                break;
+            }
+
+            int value;
+            if (!sscanf(argv[i+1], "%d", &value) || value < 0 || (arg == "--port" && value > 65535)) {
+                options->error = true;
+            } else if (arg == "--port") {
+                options->port = value;
+            } else if (arg == "--pool") {
+                options->poolSize = value;
+            } else if (arg == "--unique-memory") {
+                // below this the Bloom filter fills up after a handful of keys and nothing is unique any more
+                if (value < DEDUPE_MIN_MEMORY) {
+                    options->error = true;
+                }
+                options->unique = true;
+                options->uniqueMemory = value;
+            } else if (arg == "--checkpoint-interval") {
+                options->checkpointInterval = value;
+            } else if (arg == "--cache") {
+                options->cacheSize = value;
+            } else {
+                options->workers = value;
+            }
+            i++;
+        } else if (arg == "-v" || arg == "--verbose") {
             options->verbose = true;
             UMSKT::setDebugOutput(stderr);
         } else if (arg == "-h" || arg == "--help") {
@@ -114,8 +232,9 @@ int CLI::parseCommandLine(int argc, char* argv[], Options* options) {
                 break;
             }
 
-            int nKeys;
-            if (!sscanf(argv[i+1], "%d", &nKeys)) {
+            // %llu would wrap a negative count around to an endless run
+            unsigned long long nKeys;
+            if (argv[i+1][0] == '-' || !sscanf(argv[i+1], "%llu", &nKeys)) {
                 options->error = true;
             } else {
                 options->numKeys = nKeys;
@@ -220,7 +339,9 @@ int CLI::parseCommandLine(int argc, char* argv[], Options* options) {
             }
 
             options->keyToCheck = argv[i+1];
-            options->applicationMode = MODE_BINK1998_VALIDATE;
+            if (options->applicationMode != MODE_PIDGEN2) {
+                options->applicationMode = MODE_BINK1998_VALIDATE;
+            }
             i++;
 		
 	} else if (arg == "-N" || arg == "--nonewlines") {
@@ -229,13 +350,117 @@ int CLI::parseCommandLine(int argc, char* argv[], Options* options) {
 	    options->overrideVersion = true;
 	} else if (arg == "-D" || arg == "--nodashes") {
 	    options->nodashes = true;
+        } else if (arg == "-O" || arg == "--output") {
+            if (i == argc - 1) {
+                options->error = true;
+                break;
+            }
+
+            options->outputFile = argv[i+1];
+            i++;
+        } else if (arg == "-F" || arg == "--format") {
+            if (i == argc - 1) {
+                options->error = true;
+                break;
+            }
+
+            if (!OutputWriter::parseFormat(argv[i+1], &options->outputFormat)) {
+                options->error = true;
+            }
+            i++;
+        } else if (arg == "-T" || arg == "--threads") {
+            if (i == argc - 1) {
+                options->error = true;
+                break;
+            }
+
+            int threads[3]{};
+            if (sscanf(argv[i+1], "%d,%d,%d", &threads[0], &threads[1], &threads[2]) < 1 || threads[0] < 0 || threads[1] < 0 || threads[2] < 0) {
+                options->error = true;
+            } else {
+                options->generateThreads = threads[0];
+                options->verifyThreads = threads[1];
+                options->formatThreads = threads[2];
+            }
+            i++;
+        } else if (arg == "-x" || arg == "--noverify") {
+            options->noverify = true;
+        } else if (arg == "-S" || arg == "--stats") {
+            options->stats = true;
+        } else if (arg == "--stats-json") {
+            options->stats = true;
+            options->statsJSON = true;
+        } else if (arg == "--iid-file" || arg == "--verify-file") {
+            if (i == argc - 1) {
+                options->error = true;
+                break;
+            }
+
+            options->inputFile = argv[i+1];
+            options->applicationMode = MODE_CONFID_STREAM;
+            options->verifyCIDs = arg == "--verify-file";
+            i++;
+        } else if (arg == "--pidgen2") {
+            if (i == argc - 1) {
+                options->error = true;
+                break;
+            }
+
+            std::string type = argv[i+1];
+            for (char &ch : type) {
+                ch = toupper((unsigned char)ch);
+            }
+
+            if (type == "RETAIL") {
+                options->pidgen2Type = PIDGEN2_RETAIL;
+            } else if (type == "OEM") {
+                options->pidgen2Type = PIDGEN2_OEM;
+            } else {
+                options->error = true;
+            }
+
+            options->applicationMode = MODE_PIDGEN2;
+            i++;
+        } else if (arg == "--enumerate") {
+            if (i == argc - 1) {
+                options->error = true;
+                break;
+            }
+
+            unsigned long long start;
+            if (sscanf(argv[i+1], "%llu", &start) != 1) {
+                options->error = true;
+            } else {
+                options->enumerateStart = start;
+                options->enumerate = true;
+            }
+            i++;
+        } else if (arg == "--cid") {
+            if (i == argc - 1) {
+                options->error = true;
+                break;
+            }
+
+            options->confirmationID = argv[i+1];
+            i++;
+        } else if (arg == "-R" || arg == "--read" || arg == "-A" || arg == "--audit") {
+            if (i == argc - 1) {
+                options->error = true;
+                break;
+            }
+
+            options->inputFile = argv[i+1];
+            if (options->applicationMode != MODE_PIDGEN2) {
+                options->applicationMode = (arg == "-R" || arg == "--read") ? MODE_DECODE_KEYS : MODE_AUDIT_KEYS;
+            }
+            i++;
 	} else {
             options->error = true;
         }
     }
 
-    // make sure that a product id is entered for OFFICE_2K3 or OFFICE_2K7 IIDs
-    if ((options->activationMode == OFFICE_2K3 || options->activationMode == OFFICE_2K7) && (options->productid.empty() || options->instid.empty()) ) {
+    // make sure that a product id is entered for OFFICE_2K3 or OFFICE_2K7 IIDs, streamed lines may bring their own
+    if (options->applicationMode != MODE_CONFID_STREAM && (options->activationMode == OFFICE_2K3 || options->activationMode == OFFICE_2K7) && (options->productid.empty() || options->instid.empty()) ) {
         return options->error = true;
     }
 
@@ -284,6 +509,104 @@ int CLI::validateCommandLine(Options* options, char *argv[], json *keys) {
         return 1;
     }
 
+    // a resumed run takes over the parameters it was started with, the command line only picks the file
+    if (options->resume) {
+        CheckpointState state;
+        if (!Checkpoint::load(options->checkpointFile, &state)) {
+            fmt::print("ERROR: Unable to read checkpoint {}\n", options->checkpointFile);
+            return 1;
+        }
+
+        options->binkid = state.job.binkid;
+        options->outputFile = state.outputFile;
+        options->outputFormat = state.job.format;
+        options->nodashes = state.job.nodashes;
+        options->nonewlines = state.job.nonewlines;
+        options->channelID = (int)state.job.channelID;
+        options->serialMin = (int)state.job.serMin;
+        options->serialMax = (int)state.job.serMax;
+        options->serialSet = state.job.serialSet;
+        options->upgrade = state.job.upgrade;
+        options->numKeys = state.job.total;
+        options->seed = state.job.seed;
+        options->seedSet = true;
+        options->shardIndex = (int)state.job.shardIndex;
+        options->shardCount = (int)state.job.shardCount;
+        options->sharded = options->sharded || state.job.shardCount > 1;
+    }
+
+    // every shard has to draw from the same seed, and the manifest goes next to the output
+    if (options->sharded && (!options->seedSet || options->outputFile.empty() || options->outputFile == "-")) {
+        fmt::print("ERROR: --shard needs the --seed shared by all shards of the job and an --output file\n");
+        return 1;
+    }
+
+    if (options->applicationMode == MODE_BATCH) {
+        if (options->inputFile.empty()) {
+            fmt::print("ERROR: batch needs a manifest file\n");
+            return 1;
+        }
+        return 0;
+    }
+
+    if (options->applicationMode == MODE_MERGE) {
+        if (options->outputFile.empty() || options->outputFile == "-" || options->mergeInputs.empty()) {
+            fmt::print("ERROR: merge needs --output FILE and at least one shard\n");
+            return 1;
+        }
+        return 0;
+    }
+
+    if (options->applicationMode == MODE_CONFID_STREAM) {
+        if (!options->productid.empty() && !RequestFields::isProductID(options->productid)) {
+            fmt::print("ERROR: {} is not a product ID of the form 12345-123-1234567-12345\n", options->productid);
+            return 1;
+        }
+        return 0;
+    }
+
+    if (options->applicationMode == MODE_PIDGEN2) {
+        if (!options->enumerate && options->numKeys == 0) {
+            fmt::print("ERROR: -n needs at least one key\n");
+            return 1;
+        }
+        if (options->enumerate && options->enumerateStart >= PIDGEN2::Keyspace(options->pidgen2Type)) {
+            fmt::print("ERROR: --enumerate {} is past the last of the {} valid keys\n", options->enumerateStart, PIDGEN2::Keyspace(options->pidgen2Type));
+            return 1;
+        }
+        return 0;
+    }
+
+    if (options->enumerate) {
+        fmt::print("ERROR: --enumerate only works with --pidgen2\n");
+        return 1;
+    }
+
+    if (options->applicationMode == MODE_BINK1998_GENERATE && options->numKeys == 0) {
+        fmt::print("ERROR: -n needs at least one key\n");
+        return 1;
+    }
+
+    if (!options->checkpointFile.empty() && (options->applicationMode != MODE_BINK1998_GENERATE || options->outputFile.empty() || options->outputFile == "-")) {
+        fmt::print("ERROR: --checkpoint and --resume only work when generating keys into an --output file\n");
+        return 1;
+    }
+
+    if (options->applicationMode == MODE_SERVE && options->socketPath.empty() && options->port == 0) {
+        fmt::print("ERROR: serve needs --socket PATH and/or --port N\n");
+        return 1;
+    }
+
+    // key files carry their own BINK ID, which is checked once the file is opened, serve takes it per request
+    if (options->applicationMode == MODE_DECODE_KEYS || options->applicationMode == MODE_AUDIT_KEYS || options->applicationMode == MODE_SERVE) {
+        return 0;
+    }
+
+    if (options->applicationMode != MODE_CONFIRMATION_ID && !(*keys)["BINK"].contains(options->binkid)) {
+        fmt::print("ERROR: BINK {} was not found in the keys file\n", options->binkid);
+        return 1;
+    }
+
     int intBinkID;
     sscanf(options->binkid.c_str(), "%x", &intBinkID);
 
@@ -391,23 +714,125 @@ std::string CLI::readFromStdin() {
     return input;
 }
 
+/* Prints the merged generation statistics to stderr. */
+void CLI::printStats(bool asJSON, double seconds) {
+    StatsCounters total = GenerationStats::collect();
+
+    if (asJSON) {
+        json output;
+        output["wall_seconds"] = seconds;
+        output["operations"] = json::object();
+
+        for (int op = 0; op < OP_COUNT; op++) {
+            const StatsBlock &block = total.ops[op];
+            if (!block.attempts && !block.calls[PHASE_VERIFY]) {
+                continue;
+            }
+
+            json entry;
+            entry["completed"] = block.completed;
+            entry["attempts"] = block.attempts;
+
+            for (int i = 0; i < REJECT_COUNT; i++) {
+                entry["rejects"][GenerationStats::rejectName((STATS_REJECT)i)] = block.rejects[i];
+            }
+
+            for (int i = 0; i < PHASE_COUNT; i++) {
+                entry["phases"][GenerationStats::phaseName((STATS_PHASE)i)] = {
+                        { "calls", block.calls[i] },
+                        { "nanos", block.nanos[i] },
+                };
+            }
+
+            entry["attempt_histogram"] = json::object();
+            for (int i = 0; i < STATS_HISTOGRAM_BUCKETS; i++) {
+                if (block.histogram[i]) {
+                    entry["attempt_histogram"][fmt::format(i == STATS_HISTOGRAM_BUCKETS - 1 ? "{}+" : "{}", i + 1)] = block.histogram[i];
+                }
+            }
+
+            output["operations"][GenerationStats::operationName((STATS_OPERATION)op)] = entry;
+        }
+
+        fmt::print(stderr, "{}\n", output.dump(2));
+        return;
+    }
+
+    fmt::print(stderr, "\nWall time: {:.3f}s\n", seconds);
+
+    for (int op = 0; op < OP_COUNT; op++) {
+        const StatsBlock &block = total.ops[op];
+        if (!block.attempts && !block.calls[PHASE_VERIFY]) {
+            continue;
+        }
+
+        fmt::print(stderr, "\n[{}] {} completed, {} attempts", GenerationStats::operationName((STATS_OPERATION)op), block.completed, block.attempts);
+        if (block.completed) {
+            fmt::print(stderr, " ({:.2f} per result)", (double)block.attempts / (double)block.completed);
+        }
+        fmt::print(stderr, "\n");
+
+        for (int i = 0; i < REJECT_COUNT; i++) {
+            if (block.rejects[i]) {
+                fmt::print(stderr, "  rejected ({}): {}\n", GenerationStats::rejectName((STATS_REJECT)i), block.rejects[i]);
+            }
+        }
+
+        fmt::print(stderr, "  attempts per result:");
+        for (int i = 0; i < STATS_HISTOGRAM_BUCKETS; i++) {
+            if (block.histogram[i]) {
+                fmt::print(stderr, " {}{}={}", i + 1, i == STATS_HISTOGRAM_BUCKETS - 1 ? "+" : "", block.histogram[i]);
+            }
+        }
+        fmt::print(stderr, "\n");
+
+        QWORD totalNanos = 0;
+        for (int i = 0; i < PHASE_COUNT; i++) {
+            totalNanos += block.nanos[i];
+        }
+
+        fmt::print(stderr, "  {:<12}{:>12}{:>14}{:>12}{:>8}\n", "phase", "calls", "total ms", "ns/call", "share");
+        for (int i = 0; i < PHASE_COUNT; i++) {
+            if (!block.calls[i]) {
+                continue;
+            }
+
+            fmt::print(stderr, "  {:<12}{:>12}{:>14.3f}{:>12.0f}{:>7.1f}%\n",
+                       GenerationStats::phaseName((STATS_PHASE)i),
+                       block.calls[i],
+                       (double)block.nanos[i] / 1e6,
+                       (double)block.nanos[i] / (double)block.calls[i],
+                       totalNanos ? 100.0 * (double)block.nanos[i] / (double)totalNanos : 0.0);
+        }
+    }
+}
+
+/* Hands the parameters of every BINK in the keys file to the curve registry. */
+void CLI::registerCurves(json &keys) {
+    for (auto el : keys["BINK"].items()) {
+        json &bink = el.value();
+
+        PIDGEN3::CurveRegistry::add(el.key(), PIDGEN3::BINKParams {
+                bink["p"].get<std::string>(),
+                bink["a"].get<std::string>(),
+                bink["b"].get<std::string>(),
+                bink["g"]["x"].get<std::string>(),
+                bink["g"]["y"].get<std::string>(),
+                bink["pub"]["x"].get<std::string>(),
+                bink["pub"]["y"].get<std::string>(),
+                bink["n"].get<std::string>(),
+                bink["priv"].get<std::string>()
+        });
+    }
+}
+
 CLI::CLI(Options options, json keys) {
     this->options = options;
     this->keys = keys;
 
-    this->BINKID = options.binkid.c_str();
+    this->BINKID = this->options.binkid.c_str();
 
-    // We cannot produce a valid key without knowing the private key k. The reason for this is that
-    // we need the result of the function K(x; y) = kG(x; y).
-    this->privateKey = BN_new();
-
-    // We can, however, validate any given key using the available public key: {p, a, b, G, K}.
-    // genOrder the order of the generator G, a value we have to reverse -> Schoof's Algorithm.
-    this->genOrder = BN_new();
-
-    /* Computed data */
-    BN_dec2bn(&this->genOrder,   this->keys["BINK"][this->BINKID]["n"].   get<std::string>().c_str());
-    BN_dec2bn(&this->privateKey, this->keys["BINK"][this->BINKID]["priv"].get<std::string>().c_str());
+    GenerationStats::enable(options.stats);
 
     if (options.verbose) {
         fmt::print("----------------------------------------------------------- \n");
@@ -425,132 +850,945 @@ CLI::CLI(Options options, json keys) {
         fmt::print("\n");
     }
 
+    // The curve (and its precomputed tables) is built once per process and shared from then on.
+    registerCurves(this->keys);
+    this->curve = nullptr;
+
+    if (options.applicationMode <= MODE_BINK2002_VALIDATE && options.applicationMode != MODE_CONFIRMATION_ID) {
+        this->curve = PIDGEN3::CurveRegistry::get(this->BINKID);
+    }
 
-    eCurve = PIDGEN3::initializeEllipticCurve(
-            this->keys["BINK"][this->BINKID]["p"].get<std::string>(),
-            this->keys["BINK"][this->BINKID]["a"].get<std::string>(),
-            this->keys["BINK"][this->BINKID]["b"].get<std::string>(),
-            this->keys["BINK"][this->BINKID]["g"]["x"].get<std::string>(),
-            this->keys["BINK"][this->BINKID]["g"]["y"].get<std::string>(),
-            this->keys["BINK"][this->BINKID]["pub"]["x"].get<std::string>(),
-            this->keys["BINK"][this->BINKID]["pub"]["y"].get<std::string>(),
-            this->genPoint,
-            this->pubPoint
-    );
+    // a server pays for every curve up front so no request has to
+    if (options.applicationMode == MODE_SERVE) {
+        PIDGEN3::CurveRegistry::warmUp();
+    }
 
     this->count = 0;
-    this->total = this->options.numKeys;
+    this->total = KeyShards::shareOf(this->options.numKeys, this->options.shardIndex, this->options.shardCount);
 }
 
-int CLI::BINK1998Generate() {
-    // raw PID/serial value
-    DWORD nRaw = this->options.channelID * 1'000'000 ; /* <- change */
-    DWORD serMin = this->options.serialMin;
-    DWORD serMax = this->options.serialMax;
-
-    // using user-provided serial
-    if ((serMin == serMax) && this->options.serialSet) {
-        // just in case, make sure it's less than 1000000
-        int serialRnd = (this->options.serialMin % 1000000);
-        nRaw += serialRnd;
-    } else {
-        // generate a random number to use as a serial
-        BIGNUM *bnrand = BN_new();
-        UMSKT::umskt_bn_rand(bnrand, 19, BN_RAND_TOP_ANY, BN_RAND_BOTTOM_ANY);
+/*
+ * Collects the parameters of a generate run, sets up its --checkpoint file or picks up
+ * the progress of the run that is being resumed. Fresh checkpointed runs without --seed
+ * get a random one, it has to be known to continue the same streams later.
+ */
+bool CLI::prepareJob() {
+    if (!this->options.checkpointFile.empty() && !this->options.seedSet) {
+        UMSKT::umskt_rand_bytes((BYTE *)&this->options.seed, sizeof(this->options.seed));
+        this->options.seedSet = true;
+    }
 
-        int oRaw;
-        char *cRaw = BN_bn2dec(bnrand);
+    this->job = JobParameters {
+            this->options.binkid,
+            this->options.outputFormat,
+            this->options.nodashes,
+            this->options.nonewlines,
+            (DWORD)this->options.channelID,
+            (DWORD)this->options.serialMin,
+            (DWORD)this->options.serialMax,
+            this->options.serialSet,
+            0,
+            this->options.upgrade,
+            this->options.numKeys,
+            this->options.seed,
+            (DWORD)this->options.shardIndex,
+            (DWORD)this->options.shardCount,
+    };
 
-        sscanf(cRaw, "%d", &oRaw);
-        nRaw += serMin + (oRaw % (serMax - serMin + 1)); // ensure our serial is within specified range
-	    BN_free(bnrand);
+    if (this->options.checkpointFile.empty()) {
+        return true;
     }
 
-    if (this->options.verbose) {
-        // print the resulting Product ID
-        // PID value is printed in BINK1998::Generate
-        printID(&nRaw);
+    this->checkpoint = std::make_unique<Checkpoint>(this->options.checkpointFile, this->options.checkpointInterval);
+    CheckpointState &state = this->checkpoint->state;
+
+    if (!this->options.resume) {
+        state.outputFile = this->options.outputFile;
+        return true;
     }
 
-    // generate a key
-    BN_sub(this->privateKey, this->genOrder, this->privateKey);
+    if (!Checkpoint::load(this->options.checkpointFile, &state)) {
+        fmt::print("ERROR: Unable to read checkpoint {}\n", this->options.checkpointFile);
+        return false;
+    }
 
-    for (int i = 0; i < this->total; i++) {
-        PIDGEN3::BINK1998::Generate(this->eCurve, this->genPoint, this->genOrder, this->privateKey, nRaw, options.upgrade, this->pKey);
+    this->job = state.job;
+    this->count = std::min(state.written, this->total);
+    return true;
+}
 
-        bool isValid = PIDGEN3::BINK1998::Verify(this->eCurve, this->genPoint, this->pubPoint, this->pKey);
-        if (isValid) {
-            CLI::printKey(this->pKey);
-            if (i < this->total - 1 || this->options.verbose) {
-                fmt::print("\n");
-            }
-            this->count += isValid;
-        }
-        else {
-            if (this->options.verbose) {
-                CLI::printKey(this->pKey);
-                fmt::print(" [Invalid]");
-                if (i < this->total - 1) {
-                    fmt::print("\n");
-                }
-            }
-            this->total++; // queue a redo, basically
-        }
+/* Records the progress of the run, at the end the writer has to be closed already. */
+void CLI::saveCheckpoint(OutputWriter *writer, QWORD nextIndex, bool complete) {
+    if (!this->checkpoint) {
+        return;
     }
 
-    if (this->options.verbose) {
-        fmt::print("\nSuccess count: {}/{}", this->count, this->total);
-    }
-    if (this->options.nonewlines == false) {
-	fmt::print("\n"); 
+    bool saved = complete ? this->checkpoint->finish(writer, nextIndex) : this->checkpoint->record(writer, nextIndex);
+    if (!saved) {
+        fmt::print(stderr, "WARNING: Unable to write checkpoint {}\n", this->options.checkpointFile);
     }
-    return 0;
 }
 
-int CLI::BINK2002Generate() {
-    DWORD pChannelID = this->options.channelID;
+/* Opens the configured output destination, writing the CSV header if needed. */
+OutputWriter *CLI::openOutput() {
+    OUTPUT_FORMAT format = this->options.outputFormat;
 
-    if (this->options.verbose) {
-        fmt::print("> Channel ID: {:03d}\n", this->options.channelID);
+    if (format == FORMAT_PLAIN && this->options.nodashes) {
+        format = FORMAT_NODASH;
     }
 
-    // generate a key
-    for (int i = 0; i < this->total; i++) {
-        DWORD pAuthInfo;
-        UMSKT::umskt_rand_bytes((BYTE *)&pAuthInfo, 4);
-        pAuthInfo &= BITMASK(10);
+    if (this->checkpoint && this->options.resume) {
+        const CheckpointState &state = this->checkpoint->state;
 
-        if (this->options.verbose) {
-            fmt::print("> AuthInfo: {}\n", pAuthInfo);
+        OutputWriter *writer = OutputWriter::reopen(this->options.outputFile, format, !this->options.nonewlines, state.offset, state.heldTerminator);
+        if (writer == nullptr) {
+            fmt::print("ERROR: Output file {} is missing or shorter than checkpoint {} says\n", this->options.outputFile, this->options.checkpointFile);
         }
 
-        PIDGEN3::BINK2002::Generate(this->eCurve, this->genPoint, this->genOrder, this->privateKey, pChannelID, pAuthInfo, options.upgrade, this->options.serialMin, this->options.serialMax, this->pKey);
-
-        bool isValid = PIDGEN3::BINK2002::Verify(this->eCurve, this->genPoint, this->pubPoint, NULL, this->pKey);
-        if (isValid) {
-            CLI::printKey(this->pKey);
-            if (i < this->total - 1 || this->options.verbose) { // check if end of list or verbose
-                fmt::print("\n");
-            }
-            this->count += isValid; // add to count
+        // the header went out with the first part of the run
+        if (writer != nullptr) {
+            saveCheckpoint(writer, state.nextIndex, false);
         }
-        else {
-            if (this->options.verbose) {
-                CLI::printKey(this->pKey); // print the key
-                fmt::print(" [Invalid]"); // and add " [Invalid]" to the key
-                if (i < this->total - 1) { // check if end of list
-                    fmt::print("\n");
+        return writer;
+    }
+
+    OutputWriter *writer = OutputWriter::open(this->options.outputFile, format, !this->options.nonewlines);
+    if (writer == nullptr) {
+        fmt::print("ERROR: Unable to open output file {}\n", this->options.outputFile);
+        return nullptr;
+    }
+
+    writer->writeHeader(this->options.binkid, this->options.applicationMode == MODE_BINK1998_GENERATE ? ALGORITHM_BINK1998 : ALGORITHM_BINK2002);
+
+    // from here on a killed run can always be resumed, even before its first interval is up
+    if (this->checkpoint) {
+        this->checkpoint->state.job = this->job;
+        saveCheckpoint(writer, this->checkpoint->state.nextIndex, false);
+    }
+
+    return writer;
+}
+
+/* The stream the next key of the run draws from, passing over those a resumed run wrote already. */
+QWORD CLI::nextStream(QWORD index) const {
+    return this->checkpoint ? this->checkpoint->state.nextUnwritten(index) : index;
+}
+
+/* Ends a run that can't go on, what made it out is kept but the run is not marked complete. */
+int CLI::abortJob(OutputWriter *writer, const std::string &reason) {
+    fmt::print(stderr, "ERROR: {}\n", reason);
+
+    writer->close();
+    delete writer;
+
+    return 1;
+}
+
+/* Closes the output, prints an error and returns false if any of it could not be written. */
+bool CLI::closeOutput(OutputWriter *writer) {
+    if (writer->close()) {
+        return true;
+    }
+
+    fmt::print(stderr, "ERROR: Unable to write output to {}\n", this->options.outputFile.empty() ? "stdout" : this->options.outputFile);
+    return false;
+}
+
+/* Closes the output of a generate run, then records that it's done in the checkpoint and shard manifest. */
+int CLI::finishJob(OutputWriter *writer, QWORD nextIndex) {
+    // a run that lost output is never marked complete, its last checkpoint still tells where to pick up
+    if (!closeOutput(writer)) {
+        delete writer;
+        return 1;
+    }
+
+    saveCheckpoint(writer, nextIndex, true);
+    delete writer;
+
+    if (!this->options.sharded) {
+        return 0;
+    }
+
+    QWORD headerBytes = 0;
+    if (this->job.format == FORMAT_CSV) {
+        headerBytes = strlen(OUTPUT_CSV_HEADER);
+    } else if (this->job.format == FORMAT_BINARY) {
+        headerBytes = KEYFILE_HEADER_SIZE;
+    }
+
+    if (!KeyShards::writeManifest(this->options.outputFile, this->job, this->count, headerBytes)) {
+        fmt::print("ERROR: Unable to write manifest {}\n", KeyShards::manifestPath(this->options.outputFile));
+        return 1;
+    }
+
+    return 0;
+}
+
+/* Bulk runs go through the staged pipeline, verbose runs stay sequential so their output reads in order. */
+bool CLI::usePipeline() {
+#if UMSKT_THREADS
+    return !this->options.verbose && this->total - this->count > 1;
+#else
+    return false;
+#endif
+}
+
+/* Duplicate tracking for --unique, sized for the whole run. */
+KeyDedupe *CLI::openDedupe(STATS_OPERATION op) {
+    if (!this->options.unique) {
+        return nullptr;
+    }
+
+    return new KeyDedupe(op, this->options.uniqueMemory, this->total);
+}
+
+std::string CLI::uniqueFullMessage() const {
+    return fmt::format("--unique is out of memory after {} keys, raise --unique-memory (currently {} MiB)", this->count, this->options.uniqueMemory);
+}
+
+/* Opens the --ledger file, prints an error if there is one that can't be opened. */
+KeyLedger *CLI::openLedger(bool readOnly) {
+    if (this->options.ledgerFile.empty()) {
+        return nullptr;
+    }
+
+    bool inUse;
+    KeyLedger *ledger = KeyLedger::open(this->options.ledgerFile, readOnly, &inUse);
+    if (ledger == nullptr && inUse) {
+        fmt::print("ERROR: Ledger {} is in use by another process\n", this->options.ledgerFile);
+    } else if (ledger == nullptr) {
+        fmt::print("ERROR: Unable to open ledger {}\n", this->options.ledgerFile);
+    }
+
+    return ledger;
+}
+
+/* Adds a key to the ledger, a key that was issued before counts as a duplicate. */
+bool CLI::recordIssued(KeyLedger *ledger, STATS_OPERATION op, const KeyRecord &record) {
+    if (ledger == nullptr) {
+        return true;
+    }
+
+    BYTE binkid = 0;
+    KeyFile::parseBINK(record.binkid, &binkid);
+
+    if (ledger->append(binkid, record.raw, record.serial, record.channelID, record.upgrade)) {
+        return true;
+    }
+
+    GenerationStats::reject(op, REJECT_DUPLICATE);
+    return false;
+}
+
+/* Tells whether, when and how a validated key was issued according to the ledger. */
+void CLI::printIssued(char (&pKey)[25]) {
+    std::unique_ptr<KeyLedger> ledger(openLedger(true));
+    if (!ledger) {
+        return;
+    }
+
+    QWORD pRaw[2]{};
+    PIDGEN3::unbase24((BYTE *)pRaw, pKey);
+
+    BYTE binkid = 0;
+    KeyFile::parseBINK(this->options.binkid, &binkid);
+
+    LedgerRecord entry;
+    if (!ledger->lookup(binkid, pRaw, &entry)) {
+        fmt::print("Key is not in ledger {}\n", this->options.ledgerFile);
+        return;
+    }
+
+    char issued[32] = "unknown";
+    time_t timestamp = (time_t)entry.timestamp;
+    std::tm *utc = std::gmtime(&timestamp);
+    if (utc != nullptr) {
+        std::strftime(issued, sizeof(issued), "%Y-%m-%d %H:%M:%S UTC", utc);
+    }
+
+    fmt::print("Issued {} (channel {:03d}, serial {:06d}{})\n", issued, entry.channelID, entry.serial, entry.flags & LEDGER_FLAG_UPGRADE ? ", upgrade" : "");
+}
+
+int CLI::runPipeline(PipelineJob &job, OutputWriter *writer) {
+    PipelineConfig config {
+            this->options.generateThreads,
+            this->options.verifyThreads,
+            this->options.formatThreads,
+            !this->options.noverify
+    };
+
+    job.total = this->total - this->count;
+    job.seeded = isSeeded();
+    job.seed = this->job.seed;
+    job.firstIndex = this->checkpoint ? this->checkpoint->state.nextIndex : 0;
+    job.shardIndex = this->job.shardIndex;
+    job.shardCount = this->job.shardCount;
+    job.checkpoint = this->checkpoint.get();
+
+    // streams a resumed run wrote past its nextIndex are skipped, so the run ends that much later
+    QWORD lastIndex = job.firstIndex + job.total + (this->checkpoint ? this->checkpoint->state.ahead.size() : 0);
+
+    this->count += KeyPipeline::run(job, config, writer);
+
+    if (job.dedupe != nullptr && job.dedupe->isFull()) {
+        return abortJob(writer, uniqueFullMessage());
+    }
+
+    return finishJob(writer, lastIndex);
+}
+
+int CLI::BINK1998Generate() {
+    if (!prepareJob()) {
+        return 1;
+    }
+
+    // raw PID/serial value
+    DWORD nRaw = this->options.channelID * 1'000'000 ; /* <- change */
+    DWORD serMin = this->options.serialMin;
+    DWORD serMax = this->options.serialMax;
+
+    // a resumed run keeps the serial it started with
+    if (this->options.resume) {
+        nRaw = this->job.pSerial;
+    }
+    // using user-provided serial
+    else if ((serMin == serMax) && this->options.serialSet) {
+        // just in case, make sure it's less than 1000000
+        int serialRnd = (this->options.serialMin % 1000000);
+        nRaw += serialRnd;
+    } else {
+        // generate a random number to use as a serial within the specified range
+        nRaw += KeyShards::pickSerial(serMin, serMax, isSeeded(), this->job.seed);
+    }
+
+    this->job.pSerial = nRaw;
+
+    if (this->options.verbose) {
+        // print the resulting Product ID
+        // PID value is printed in BINK1998::Generate
+        printID(&nRaw);
+    }
+
+    std::unique_ptr<KeyLedger> ledger(openLedger(false));
+    if (!ledger && !this->options.ledgerFile.empty()) {
+        return 1;
+    }
+
+    OutputWriter *writer = openOutput();
+    if (writer == nullptr) {
+        return 1;
+    }
+
+    // one serial for the whole batch makes collisions a real possibility on long runs
+    std::unique_ptr<KeyDedupe> dedupe(openDedupe(OP_BINK1998));
+
+    if (usePipeline()) {
+        PipelineJob job{};
+        job.curve = this->curve;
+        job.binkid = this->BINKID;
+        job.dedupe = dedupe.get();
+        job.ledger = ledger.get();
+        job.pSerial = nRaw;
+        job.pUpgrade = this->options.upgrade;
+
+        return runPipeline(job, writer);
+    }
+
+    // key number n of a seeded run draws from stream n, one substream per attempt
+    QWORD nextIndex = nextStream(this->checkpoint ? this->checkpoint->state.nextIndex : 0);
+    QWORD attempt = 0;
+
+    {
+        OutputWriter::Buffer out(writer);
+
+        KeyRecord record{};
+        record.binkid = this->BINKID;
+        record.serial = nRaw % 1'000'000;
+        record.channelID = nRaw / 1'000'000;
+        record.upgrade = this->options.upgrade;
+
+
+        // generate a key
+        for (QWORD i = this->count; i < this->total && !writer->hasFailed(); i++) {
+            if (isSeeded()) {
+                UMSKT::setRandomStream(this->job.seed, KeyShards::streamIndex(nextIndex, this->job.shardIndex, this->job.shardCount), attempt++);
+            }
+
+            PIDGEN3::BINK1998::Generate(*this->curve, nRaw, options.upgrade, record.raw);
+
+            bool isValid = this->options.noverify || PIDGEN3::BINK1998::Verify(*this->curve, record.raw);
+            bool isDuplicate = isValid && ((dedupe && !dedupe->insert(record.raw)) || !recordIssued(ledger.get(), OP_BINK1998, record));
+
+            if (dedupe && dedupe->isFull()) {
+                break;
+            }
+
+            // binary output stores the packed payload, only text formats pay for the Base24 conversion
+            if (!writer->isBinary() || !isValid || isDuplicate) {
+                GenerationStats::Clock clock(OP_BINK1998);
+                PIDGEN3::base24(record.key, (BYTE *)record.raw);
+                clock.lap(PHASE_ENCODE);
+            }
+
+            if (isValid && !isDuplicate) {
+                out.append(record);
+                this->count += isValid;
+                nextIndex = nextStream(nextIndex + 1);
+                attempt = 0;
+
+                if (this->checkpoint) {
+                    this->checkpoint->advance(1);
+
+                    if (this->checkpoint->due()) {
+                        out.flush();
+                        saveCheckpoint(writer, nextIndex, false);
+                    }
+                }
+            }
+            else {
+                if (this->options.verbose) {
+                    char key[PK_LENGTH + 4 + NULL_TERMINATOR];
+                    OutputWriter::formatKey(key, record.key, !this->options.nodashes);
+                    printVerbose(out, writer, fmt::format("{} [{}]\n", key, isValid ? "Duplicate" : "Invalid"));
+                }
+                this->total++; // queue a redo, basically
+            }
+        }
+
+        if (this->options.verbose) {
+            printVerbose(out, writer, fmt::format("\nSuccess count: {}/{}\n", this->count, this->total));
+        }
+
+        UMSKT::clearRandomStream();
+    }
+
+    if (dedupe && dedupe->isFull()) {
+        saveCheckpoint(writer, nextIndex, false);
+        return abortJob(writer, uniqueFullMessage());
+    }
+
+    return finishJob(writer, nextIndex);
+}
+
+int CLI::BINK2002Generate() {
+    if (!prepareJob()) {
+        return 1;
+    }
+
+    DWORD pChannelID = this->options.channelID;
+
+    if (this->options.verbose) {
+        fmt::print("> Channel ID: {:03d}\n", this->options.channelID);
+    }
+
+    std::unique_ptr<KeyLedger> ledger(openLedger(false));
+    if (!ledger && !this->options.ledgerFile.empty()) {
+        return 1;
+    }
+
+    OutputWriter *writer = openOutput();
+    if (writer == nullptr) {
+        return 1;
+    }
+
+    std::unique_ptr<KeyDedupe> dedupe(openDedupe(OP_BINK2002));
+
+    PipelineJob job{};
+    job.curve = this->curve;
+    job.binkid = this->BINKID;
+    job.dedupe = dedupe.get();
+    job.ledger = ledger.get();
+    job.bink2002 = true;
+    job.pChannelID = pChannelID;
+    job.serMin = this->options.serialMin;
+    job.serMax = this->options.serialMax;
+    job.pUpgrade = this->options.upgrade;
+
+    if (usePipeline()) {
+        return runPipeline(job, writer);
+    }
+
+    // a lone key in a narrow serial range is searched for on every core at once
+    job.seeded = isSeeded();
+    bool search = this->total - this->count == 1 && KeyPipeline::worthSearching(job);
+
+    // key number n of a seeded run draws from stream n, one substream per attempt
+    QWORD nextIndex = nextStream(this->checkpoint ? this->checkpoint->state.nextIndex : 0);
+    QWORD attempt = 0;
+
+    {
+        OutputWriter::Buffer out(writer);
+
+        KeyRecord record{};
+        record.binkid = this->BINKID;
+        record.channelID = pChannelID;
+        record.upgrade = this->options.upgrade;
+        record.hasAuthInfo = true;
+
+        // generate a key
+
+        for (QWORD i = this->count; i < this->total && !writer->hasFailed(); i++) {
+            if (isSeeded()) {
+                UMSKT::setRandomStream(this->job.seed, KeyShards::streamIndex(nextIndex, this->job.shardIndex, this->job.shardCount), attempt++);
+            }
+
+            DWORD pAuthInfo;
+            bool isValid, isDuplicate;
+
+            // the search verifies and checks for duplicates on its own
+            if (search && KeyPipeline::searchKey(job, this->options.generateThreads, !this->options.noverify, record)) {
+                pAuthInfo = record.authInfo;
+                isValid = true;
+                isDuplicate = false;
+
+                if (this->options.verbose) {
+                    printVerbose(out, writer, fmt::format("> AuthInfo: {}\n", pAuthInfo));
+                }
+            } else {
+                UMSKT::umskt_rand_bytes((BYTE *)&pAuthInfo, 4);
+                pAuthInfo &= BITMASK(10);
+
+                if (this->options.verbose) {
+                    printVerbose(out, writer, fmt::format("> AuthInfo: {}\n", pAuthInfo));
+                }
+
+                PIDGEN3::BINK2002::Generate(*this->curve, pChannelID, pAuthInfo, options.upgrade, this->options.serialMin, this->options.serialMax, &record.serial, record.raw);
+
+                isValid = this->options.noverify || PIDGEN3::BINK2002::Verify(*this->curve, &record.serial, record.raw);
+                isDuplicate = isValid && ((dedupe && !dedupe->insert(record.raw)) || !recordIssued(ledger.get(), OP_BINK2002, record));
+            }
+
+            if (dedupe && dedupe->isFull()) {
+                break;
+            }
+
+            if (!writer->isBinary() || !isValid || isDuplicate) {
+                GenerationStats::Clock clock(OP_BINK2002);
+                PIDGEN3::base24(record.key, (BYTE *)record.raw);
+                clock.lap(PHASE_ENCODE);
+            }
+
+            if (isValid && !isDuplicate) {
+                record.authInfo = pAuthInfo;
+                out.append(record);
+                this->count += isValid; // add to count
+                nextIndex = nextStream(nextIndex + 1);
+                attempt = 0;
+
+                if (this->checkpoint) {
+                    this->checkpoint->advance(1);
+
+                    if (this->checkpoint->due()) {
+                        out.flush();
+                        saveCheckpoint(writer, nextIndex, false);
+                    }
+                }
+            }
+            else {
+                if (this->options.verbose) {
+                    char key[PK_LENGTH + 4 + NULL_TERMINATOR];
+                    OutputWriter::formatKey(key, record.key, !this->options.nodashes);
+                    printVerbose(out, writer, fmt::format("{} [{}]\n", key, isValid ? "Duplicate" : "Invalid")); // the key with " [Invalid]" added
+                }
+                this->total++; // queue a redo, basically
+            }
+        }
+
+        if (this->options.verbose) {
+            printVerbose(out, writer, fmt::format("\nSuccess count: {}/{}\n", this->count, this->total));
+        }
+
+        UMSKT::clearRandomStream();
+    }
+
+    if (dedupe && dedupe->isFull()) {
+        saveCheckpoint(writer, nextIndex, false);
+        return abortJob(writer, uniqueFullMessage());
+    }
+
+    return finishJob(writer, nextIndex);
+}
+
+/* Verbose chatter goes in line with plain keys, but must not end up inside structured output. */
+void CLI::printVerbose(OutputWriter::Buffer &out, OutputWriter *writer, const std::string &text) {
+    if (writer->isText()) {
+        out.appendRaw(text);
+    } else {
+        fmt::print(stderr, "{}", text);
+    }
+}
+
+/* Opens the key file given with --read or --audit and loads the curve named in its header. */
+KeyFileReader *CLI::openKeyFile() {
+    KeyFileReader *reader = KeyFileReader::open(this->options.inputFile);
+    if (reader == nullptr) {
+        fmt::print("ERROR: {} is not a valid key file\n", this->options.inputFile);
+        return nullptr;
+    }
+
+    this->options.binkid = KeyFile::formatBINK(reader->getHeader().binkid);
+    this->BINKID = this->options.binkid.c_str();
+
+    GenerationStats::enable(options.stats);
+    this->curve = PIDGEN3::CurveRegistry::get(this->options.binkid);
+
+    if (this->curve == nullptr) {
+        fmt::print("ERROR: BINK {} was not found in the keys file\n", this->options.binkid);
+        delete reader;
+        return nullptr;
+    }
+
+    return reader;
+}
+
+/* Fills in the fields of a record that can be recovered from its packed payload. */
+void CLI::describeRecord(KeyRecord &record, KEYFILE_ALGORITHM algorithm, bool needSerial) {
+    QWORD pSignature;
+    DWORD pHash;
+
+    if (algorithm == ALGORITHM_BINK1998) {
+        DWORD nRaw;
+        PIDGEN3::BINK1998::Unpack(record.raw, record.upgrade, nRaw, pHash, pSignature);
+
+        record.serial = nRaw % 1'000'000;
+        record.channelID = nRaw / 1'000'000;
+        record.hasAuthInfo = false;
+        return;
+    }
+
+    PIDGEN3::BINK2002::Unpack(record.raw, record.upgrade, record.channelID, pHash, pSignature, record.authInfo);
+    record.hasAuthInfo = true;
+    record.serial = 0;
+
+    // BINK2002 keys don't carry their serial, it falls out of the signature check
+    if (needSerial) {
+        PIDGEN3::BINK2002::Verify(*this->curve, &record.serial, record.raw);
+    }
+}
+
+int CLI::DecodeKeys() {
+    KeyFileReader *reader = openKeyFile();
+    if (reader == nullptr) {
+        return 1;
+    }
+
+    OutputWriter *writer = openOutput();
+    if (writer == nullptr) {
+        delete reader;
+        return 1;
+    }
+
+    KEYFILE_ALGORITHM algorithm = reader->getHeader().algorithm;
+    bool needSerial = writer->getFormat() == FORMAT_CSV || writer->getFormat() == FORMAT_JSONL;
+
+    {
+        OutputWriter::Buffer out(writer);
+
+        KeyRecord record{};
+        record.binkid = this->BINKID;
+
+        while (reader->next(record.raw)) {
+            if (needSerial) {
+                describeRecord(record, algorithm, true);
+            }
+
+            PIDGEN3::base24(record.key, (BYTE *)record.raw);
+            out.append(record);
+        }
+    }
+
+    bool written = closeOutput(writer);
+    delete writer;
+    delete reader;
+    return written ? 0 : 1;
+}
+
+int CLI::AuditKeys() {
+    KeyFileReader *reader = openKeyFile();
+    if (reader == nullptr) {
+        return 1;
+    }
+
+    bool bink1998 = reader->getHeader().algorithm == ALGORITHM_BINK1998;
+    QWORD pRaw[2];
+    int checked = 0, invalid = 0;
+
+    while (reader->next(pRaw)) {
+        bool isValid = bink1998 ? PIDGEN3::BINK1998::Verify(*this->curve, pRaw)
+                                : PIDGEN3::BINK2002::Verify(*this->curve, nullptr, pRaw);
+        checked++;
+
+        if (!isValid) {
+            char pk[PK_LENGTH + NULL_TERMINATOR];
+            PIDGEN3::base24(pk, (BYTE *)pRaw);
+
+            printKey(pk);
+            fmt::print(" [Invalid]\n");
+            invalid++;
+        }
+    }
+
+    delete reader;
+
+    fmt::print("Checked {} keys against BINK {}: {} valid, {} invalid\n", checked, this->BINKID, checked - invalid, invalid);
+    return invalid != 0;
+}
+
+int CLI::Serve() {
+    KeyServer server(ServerConfig {
+            this->options.socketPath,
+            this->options.poolDir,
+            this->options.ledgerFile,
+            this->options.port,
+            this->options.workers,
+            this->options.poolSize,
+            this->options.cacheSize,
+            this->options.cacheFile
+    });
+
+    return server.run();
+}
+
+/* Runs a manifest of tasks, see BatchRunner. */
+int CLI::Batch() {
+    BatchRunner runner(this->options.workers);
+
+    if (!runner.load(this->options.inputFile)) {
+        return 1;
+    }
+
+    return runner.run();
+}
+
+/*
+ * Windows 95 era keys, see PIDGEN2. Random keys draw from the --seed stream when there
+ * is one, --enumerate formats whole runs of the keyspace straight into the output buffer.
+ */
+int CLI::PIDGEN2Generate() {
+    const PIDGEN2_KEY_TYPE type = this->options.pidgen2Type;
+    const size_t record = PIDGEN2::keyLength(type) + 1;
+    const char terminator = this->options.outputFormat == FORMAT_NUL ? '\0' : '\n';
+
+    OutputWriter *writer = OutputWriter::open(this->options.outputFile, this->options.outputFormat == FORMAT_NUL ? FORMAT_NUL : FORMAT_PLAIN, !this->options.nonewlines);
+    if (writer == nullptr) {
+        fmt::print("ERROR: Unable to open output file {}\n", this->options.outputFile);
+        return 1;
+    }
+
+    {
+        OutputWriter::Buffer out(writer);
+        char chunk[(OUTPUT_BUFFER_SIZE / (PIDGEN2_OEM_LENGTH + 1)) * (PIDGEN2_OEM_LENGTH + 1)];
+        const size_t perChunk = sizeof(chunk) / record;
+
+        if (this->options.enumerate) {
+            QWORD next = this->options.enumerateStart;
+            QWORD end = PIDGEN2::Keyspace(type);
+
+            if (this->options.numKeys != 0 && this->options.numKeys < end - next) {
+                end = next + this->options.numKeys;
+            }
+
+            while (next < end && !writer->hasFailed()) {
+                size_t count = (size_t)std::min((QWORD)perChunk, end - next);
+                out.appendRaw(chunk, PIDGEN2::Enumerate(type, next, count, chunk, terminator));
+                next += count;
+            }
+        } else {
+            if (this->options.seedSet) {
+                UMSKT::setRandomStream(this->options.seed, 0, 0);
+            }
+
+            for (QWORD left = this->options.numKeys; left > 0 && !writer->hasFailed();) {
+                size_t count = (size_t)std::min((QWORD)perChunk, left);
+                out.appendRaw(chunk, PIDGEN2::Generate(type, count, chunk, terminator));
+                left -= count;
+            }
+
+            UMSKT::clearRandomStream();
+        }
+    }
+
+    bool written = closeOutput(writer);
+    delete writer;
+    return written ? 0 : 1;
+}
+
+/*
+ * Checks the -V key or every line of the -A file against PIDGEN2. The file is read in
+ * large blocks and runs of lines that are exactly one key long go to ValidateBatch
+ * straight from the read buffer, anything else is checked one line at a time.
+ */
+int CLI::PIDGEN2Validate() {
+    const PIDGEN2_KEY_TYPE type = this->options.pidgen2Type;
+    const size_t length = PIDGEN2::keyLength(type), stride = length + 1;
+
+    if (this->options.inputFile.empty()) {
+        const std::string &key = this->options.keyToCheck;
+
+        if (!PIDGEN2::isValidKey(type, key.c_str(), key.size())) {
+            fmt::print("ERROR: {} is not a valid {} key\n", key, type == PIDGEN2_OEM ? "OEM" : "retail");
+            return 1;
+        }
+
+        fmt::print("Key validated successfully!\n");
+        return 0;
+    }
+
+    bool fromStdin = this->options.inputFile == "-";
+    std::FILE *file = fromStdin ? stdin : std::fopen(this->options.inputFile.c_str(), "rb");
+    if (file == nullptr) {
+        fmt::print("ERROR: Unable to open {}\n", this->options.inputFile);
+        return 1;
+    }
+
+    std::vector<char> buffer(PIDGEN2_AUDIT_BUFFER);
+    QWORD bitmap[PIDGEN2_AUDIT_BATCH / 64];
+    QWORD checked = 0, invalid = 0;
+    size_t filled = 0;
+    bool done = false;
+
+    auto report = [&](const char *key, size_t size) {
+        fmt::print("{} [Invalid]\n", fmt::string_view(key, size));
+        invalid++;
+    };
+
+    while (!done) {
+        size_t got = std::fread(buffer.data() + filled, 1, buffer.size() - filled, file);
+        filled += got;
+        done = got == 0;
+
+        // only whole lines, unless there is no more to come or a single line fills the buffer
+        const char *p = buffer.data(), *end = p + filled;
+        if (!done) {
+            while (end > p && end[-1] != '\n') {
+                end--;
+            }
+            if (end == p && filled == buffer.size()) {
+                end = p + filled;
+            }
+        }
+
+        while (p < end) {
+            size_t run = 0;
+            while (run < PIDGEN2_AUDIT_BATCH && p + (run + 1) * stride <= end && p[run * stride + length] == '\n') {
+                run++;
+            }
+
+            if (run != 0) {
+                PIDGEN2::ValidateBatch(type, p, stride, run, bitmap);
+
+                for (size_t i = 0; i < run; i++) {
+                    if (bitmap[i / 64] >> (i % 64) & 1) {
+                        continue;
+                    }
+
+                    // two shorter lines that happen to line up, let the slow path split them
+                    if (memchr(p + i * stride, '\n', length) != nullptr) {
+                        run = i;
+                        break;
+                    }
+                    report(p + i * stride, length);
+                }
+
+                checked += run;
+                p += run * stride;
+
+                if (run != 0) {
+                    continue;
+                }
+            }
+
+            const char *newline = (const char *)memchr(p, '\n', end - p);
+            const char *lineEnd = newline ? newline : end;
+            size_t size = lineEnd - p;
+
+            if (size && p[size - 1] == '\r') {
+                size--;
+            }
+
+            if (size) {
+                checked++;
+                if (!PIDGEN2::isValidKey(type, p, size)) {
+                    report(p, size);
                 }
             }
-            this->total++; // queue a redo, basically
+
+            p = newline ? newline + 1 : end;
+        }
+
+        filled -= p - buffer.data();
+        memmove(buffer.data(), p, filled);
+    }
+
+    if (!fromStdin) {
+        std::fclose(file);
+    }
+
+    fmt::print("Checked {} {} keys: {} valid, {} invalid\n", checked, type == PIDGEN2_OEM ? "OEM" : "retail", checked - invalid, invalid);
+    return invalid != 0;
+}
+
+/* Confirmation IDs for a whole file of installation IDs, see ConfidStream. */
+int CLI::ConfirmationIDStream() {
+    std::ifstream file;
+    bool fromStdin = this->options.inputFile == "-";
+
+    if (!fromStdin) {
+        file.open(this->options.inputFile);
+        if (!file) {
+            fmt::print("ERROR: Unable to open {}\n", this->options.inputFile);
+            return 1;
         }
     }
 
+    std::unique_ptr<OutputWriter> writer(OutputWriter::open(this->options.outputFile, FORMAT_PLAIN, true));
+    if (!writer) {
+        fmt::print("ERROR: Unable to open output file {}\n", this->options.outputFile);
+        return 1;
+    }
+
+    std::unique_ptr<ResultCache> cache;
+    if (this->options.cacheSize > 0) {
+        cache.reset(new ResultCache(this->options.cacheSize));
+
+        if (!this->options.cacheFile.empty() && !cache->load(this->options.cacheFile)) {
+            fmt::print(stderr, "WARNING: {} is not a cache snapshot, starting empty\n", this->options.cacheFile);
+        }
+    }
+
+    ConfidStream stream(ConfidDefaults {
+            this->options.activationMode,
+            this->options.productid,
+            this->options.overrideVersion,
+            !this->options.nodashes,
+            this->options.verifyCIDs
+    }, this->options.workers, cache.get());
+
+    bool ok = stream.run(fromStdin ? std::cin : file, writer.get());
+    ok = closeOutput(writer.get()) && ok;
+
+    if (cache && !this->options.cacheFile.empty() && !cache->save(this->options.cacheFile)) {
+        fmt::print(stderr, "WARNING: unable to save the cache to {}\n", this->options.cacheFile);
+    }
+
     if (this->options.verbose) {
-        fmt::print("\nSuccess count: {}/{}", this->count, this->total);
+        fmt::print(stderr, "{} confirmation IDs {}, {} failed\n", stream.succeeded.load(), this->options.verifyCIDs ? "matched" : "generated", stream.failed.load());
+        if (cache) {
+            fmt::print(stderr, "cache: {:.1f}% hits, {} entries\n", cache->hitRate() * 100, cache->size());
+        }
     }
-    if (this->options.nonewlines == false) {
-	fmt::print("\n"); 
+
+    return ok ? 0 : 1;
+}
+
+/* Joins the outputs of a sharded job, see KeyShards::merge. */
+int CLI::Merge() {
+    if (!KeyShards::merge(this->options.mergeInputs, this->options.outputFile)) {
+        return 1;
+    }
+
+    if (this->options.verbose) {
+        fmt::print("Merged {} shards into {}\n", this->options.mergeInputs.size(), this->options.outputFile);
     }
 
     return 0;
@@ -566,12 +1804,13 @@ int CLI::BINK1998Validate() {
 
     CLI::printKey(product_key);
     fmt::print("\n");
-    if (!PIDGEN3::BINK1998::Verify(this->eCurve, this->genPoint, this->pubPoint, product_key)) {
+    if (!PIDGEN3::BINK1998::Verify(*this->curve, product_key)) {
         fmt::print("ERROR: Product key is invalid! Wrong BINK ID?\n");
         return 1;
     }
 
     fmt::print("Key validated successfully!\n");
+    printIssued(product_key);
     return 0;
 }
 
@@ -585,12 +1824,13 @@ int CLI::BINK2002Validate() {
 
     CLI::printKey(product_key);
     fmt::print("\n");
-    if (!PIDGEN3::BINK2002::Verify(this->eCurve, this->genPoint, this->pubPoint, nullptr, product_key)) {
+    if (!PIDGEN3::BINK2002::Verify(*this->curve, nullptr, product_key)) {
         fmt::print("ERROR: Product key is invalid! Wrong BINK ID?\n");
         return 1;
     }
 
     fmt::print("Key validated successfully!\n");
+    printIssued(product_key);
     return 0;
 }
 
@@ -602,8 +1842,22 @@ int CLI::ConfirmationID() {
     if (instid.empty()) {
         instid = readFromStdin();
     }
-    
-    int err = ConfirmationID::Generate(instid.c_str(), confirmation_id, options.activationMode, options.productid, options.overrideVersion);
+
+    if (!this->options.confirmationID.empty()) {
+        int err = ConfirmationID::Verify(instid.c_str(), this->options.confirmationID.c_str(), options.activationMode, options.productid.c_str(), options.overrideVersion);
+        if (err != SUCCESS) {
+            fmt::print("ERROR: {}\n", RequestFields::confidError(err));
+            return 1;
+        }
+
+        fmt::print("Confirmation ID matches the installation ID");
+        if (this->options.nonewlines == false) {
+            fmt::print("\n");
+        }
+        return 0;
+    }
+
+    int err = ConfirmationID::Generate(instid.c_str(), confirmation_id, options.activationMode, options.productid.c_str(), options.overrideVersion);
 
     switch (err) {
         case ERR_TOO_SHORT:
@@ -630,6 +1884,10 @@ int CLI::ConfirmationID() {
             fmt::print("ERROR: Unable to generate valid confirmation ID.\n");
             return 1;
 
+        case ERR_INVALID_PRODUCT_ID:
+            fmt::print("ERROR: Product ID is not of the form 12345-123-1234567-12345.\n");
+            return 1;
+
         case SUCCESS:
 	    if (this->options.nodashes == true) {
 		int j = 0;
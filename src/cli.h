@@ -24,6 +24,15 @@
 #define UMSKT_CLI_H
 
 #include "header.h"
+#include "batch.h"
+#include "checkpoint.h"
+#include "confidstream.h"
+#include "ledger.h"
+#include "output.h"
+#include "pipeline.h"
+#include "request.h"
+#include "server.h"
+#include "shard.h"
 
 #include <cmrc/cmrc.hpp>
 
@@ -32,10 +41,16 @@
 #include "libumskt/pidgen3/PIDGEN3.h"
 #include "libumskt/pidgen3/BINK1998.h"
 #include "libumskt/pidgen3/BINK2002.h"
+#include "libumskt/pidgen3/CurveRegistry.h"
 #include "libumskt/confid/confid.h"
+#include "libumskt/stats.h"
 
 CMRC_DECLARE(umskt);
 
+// --pidgen2 -A reads this much of the file at once and validates up to this many lines per call
+#define PIDGEN2_AUDIT_BUFFER    (4 * 1024 * 1024)
+#define PIDGEN2_AUDIT_BATCH     4096
+
 enum ACTIVATION_ALGORITHM {
     WINDOWS     = 0,
     OFFICE_XP   = 1,
@@ -51,60 +66,128 @@ enum MODE {
     MODE_CONFIRMATION_ID   = 2,
     MODE_BINK1998_VALIDATE = 3,
     MODE_BINK2002_VALIDATE = 4,
+    MODE_DECODE_KEYS       = 5,
+    MODE_AUDIT_KEYS        = 6,
+    MODE_SERVE             = 7,
+    MODE_MERGE             = 8,
+    MODE_BATCH             = 9,
+    MODE_CONFID_STREAM     = 10,
+    MODE_PIDGEN2           = 11,
 };
 
 struct Options {
-    std::string binkid;
+    std::string binkid = "2E";
     std::string keysFilename;
     std::string instid;
     std::string keyToCheck;
     std::string productid;
-    int channelID;
-    int serialMin;
-    int serialMax;
-    int numKeys;
-    bool upgrade;
-    bool serialSet;
-    bool verbose;
-    bool help;
-    bool error;
-    bool list;
-    bool nonewlines;
-    bool overrideVersion;
-    bool nodashes;
-
-    MODE applicationMode;
-    ACTIVATION_ALGORITHM activationMode;
+    std::string outputFile;
+    std::string inputFile;
+    std::string socketPath;
+    std::string poolDir;
+    std::string ledgerFile;
+    std::string checkpointFile;
+    std::string confirmationID;
+    std::string cacheFile;
+    int channelID = 640;
+    int serialMin = 0;
+    int serialMax = 999999;
+    QWORD numKeys = 1;
+    int generateThreads = 0;
+    int verifyThreads = 0;
+    int formatThreads = 0;
+    int port = 0;
+    int workers = 0;
+    int poolSize = 0;
+    int uniqueMemory = DEDUPE_DEFAULT_MEMORY;
+    int checkpointInterval = CHECKPOINT_DEFAULT_INTERVAL;
+    int cacheSize = 0;
+    int shardIndex = 0;
+    int shardCount = 1;
+    QWORD seed = 0;
+    QWORD enumerateStart = 0;
+    bool upgrade = false;
+    bool serialSet = false;
+    bool verbose = false;
+    bool help = false;
+    bool error = false;
+    bool list = false;
+    bool nonewlines = false;
+    bool overrideVersion = false;
+    bool nodashes = false;
+    bool noverify = false;
+    bool stats = false;
+    bool statsJSON = false;
+    bool unique = false;
+    bool seedSet = false;
+    bool resume = false;
+    bool sharded = false;
+    bool verifyCIDs = false;
+    bool enumerate = false;
+
+    MODE applicationMode = MODE_BINK1998_GENERATE;
+    ACTIVATION_ALGORITHM activationMode = WINDOWS;
+    OUTPUT_FORMAT outputFormat = FORMAT_PLAIN;
+    PIDGEN2_KEY_TYPE pidgen2Type = PIDGEN2_RETAIL;
+
+    std::vector<std::string> mergeInputs;
 };
 
 class CLI {
     Options options;
     json keys;
     const char* BINKID;
-    BIGNUM *privateKey, *genOrder;
-    EC_POINT *genPoint, *pubPoint;
-    EC_GROUP *eCurve;
+    const PIDGEN3::BINKCurve *curve;
     char pKey[25];
-    int count, total;
+    QWORD count, total;
+    JobParameters job;
+    std::unique_ptr<Checkpoint> checkpoint;
 
 public:
     CLI(Options options, json keys);
-    ~CLI();
 
     static bool loadJSON(const fs::path& filename, json *output);
     static void showHelp(char *argv[]);
     static int parseCommandLine(int argc, char* argv[], Options *options);
     static int validateCommandLine(Options* options, char *argv[], json *keys);
+    static void registerCurves(json &keys);
     static void printID(DWORD *pid);
     void printKey(char *pk);
     static bool stripKey(const char *in_key, char out_key[PK_LENGTH]);
     static std::string readFromStdin();
+    static void printStats(bool asJSON, double seconds);
+    bool isSeeded() const { return this->options.seedSet || !this->options.checkpointFile.empty(); }
+    bool prepareJob();
+    void saveCheckpoint(OutputWriter *writer, QWORD nextIndex, bool complete);
+    QWORD nextStream(QWORD index) const;
+    OutputWriter *openOutput();
+    bool closeOutput(OutputWriter *writer);
+    int finishJob(OutputWriter *writer, QWORD nextIndex);
+    int abortJob(OutputWriter *writer, const std::string &reason);
+    bool usePipeline();
+    int runPipeline(PipelineJob &job, OutputWriter *writer);
+    KeyDedupe *openDedupe(STATS_OPERATION op);
+    std::string uniqueFullMessage() const;
+    KeyLedger *openLedger(bool readOnly);
+    static bool recordIssued(KeyLedger *ledger, STATS_OPERATION op, const KeyRecord &record);
+    void printIssued(char (&pKey)[25]);
+    static void printVerbose(OutputWriter::Buffer &out, OutputWriter *writer, const std::string &text);
+    KeyFileReader *openKeyFile();
+    void describeRecord(KeyRecord &record, KEYFILE_ALGORITHM algorithm, bool needSerial);
 
     int BINK1998Generate();
     int BINK2002Generate();
     int BINK1998Validate();
     int BINK2002Validate();
     int ConfirmationID();
+    int ConfirmationIDStream();
+    int PIDGEN2Generate();
+    int PIDGEN2Validate();
+    int DecodeKeys();
+    int AuditKeys();
+    int Serve();
+    int Merge();
+    int Batch();
 };
 
 #endif //UMSKT_CLI_H
@@ -0,0 +1,248 @@
+/**
+ * This file is a part of the UMSKT Project
+ *
+ * Copyleft (C) 2019-2023 UMSKT Contributors (et.al.)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @FileCreated by Neo on 10/18/2026
+ * @Maintainer Neo
+ */
+
+
+#include "confidstream.h"
+#include "cli.h"
+#include "request.h"
+
+#include "libumskt/confid/confid.h"
+
+#include <deque>
+
+#if UMSKT_THREADS
+#include <condition_variable>
+#include <mutex>
+#endif
+
+ConfidStream::ConfidStream(const ConfidDefaults &defaults, int threads, ResultCache *cache) :
+    defaults(defaults), threads(threads), cache(cache), succeeded(0), failed(0) {
+}
+
+/* Whether two confirmation IDs are the same, dashes and spaces aside. */
+bool ConfidStream::sameDigits(const std::string &a, const std::string &b) {
+    size_t i = 0, j = 0;
+
+    while (true) {
+        while (i < a.size() && (a[i] == '-' || a[i] == ' ')) {
+            i++;
+        }
+        while (j < b.size() && (b[j] == '-' || b[j] == ' ')) {
+            j++;
+        }
+        if (i == a.size() || j == b.size()) {
+            return i == a.size() && j == b.size();
+        }
+        if (a[i++] != b[j++]) {
+            return false;
+        }
+    }
+}
+
+/* Works out a single input line, appending its output line. */
+void ConfidStream::processLine(const std::string &line, std::string &output) {
+    int mode = defaults.activationMode;
+    std::string productid = defaults.productid;
+
+    size_t tab = line.find('\t');
+    std::string iid = line.substr(0, tab);
+    std::string cid;
+    const char *status = nullptr;
+
+    if (defaults.verify) {
+        if (tab == std::string::npos) {
+            status = "A confirmation ID is required to verify.";
+        } else {
+            size_t next = line.find('\t', tab + 1);
+            cid = line.substr(tab + 1, next == std::string::npos ? std::string::npos : next - tab - 1);
+            tab = next;
+        }
+    }
+
+    // the optional fields can come in either order, a product ID is easy to tell apart from a mode
+    while (tab != std::string::npos) {
+        size_t next = line.find('\t', tab + 1);
+        std::string field = line.substr(tab + 1, next == std::string::npos ? std::string::npos : next - tab - 1);
+        tab = next;
+
+        if (field.empty()) {
+            continue;
+        }
+
+        if (RequestFields::isProductID(field)) {
+            productid = field;
+        } else if (!RequestFields::parseActivationMode(field, mode)) {
+            status = "Unknown activation mode.";
+        }
+    }
+
+    // caught here rather than in Generate, which would only say the product ID is malformed
+    if (status == nullptr && (mode == OFFICE_2K3 || mode == OFFICE_2K7) && !RequestFields::isProductID(productid)) {
+        status = "A product ID is required for this mode.";
+    }
+
+    char confirmation_id[49]{};
+    bool ok = false;
+
+    std::string cacheKey, cached;
+    bool hit = false;
+    if (status == nullptr && cache != nullptr) {
+        cacheKey = ResultCache::confidKey(mode, iid, productid, defaults.overrideVersion);
+        hit = cache->lookup(cacheKey, cached);
+    }
+
+    if (status == nullptr && defaults.verify) {
+        // a cached CID settles a match, anything else gets the full check for the exact reason
+        if (hit && sameDigits(cached, cid)) {
+            status = "ok";
+            ok = true;
+        } else {
+            int err = ConfirmationID::Verify(iid.c_str(), cid.c_str(), mode, productid.c_str(), defaults.overrideVersion);
+            status = err == SUCCESS ? "ok" : RequestFields::confidError(err);
+            ok = err == SUCCESS;
+        }
+    } else if (status == nullptr && hit) {
+        snprintf(confirmation_id, sizeof(confirmation_id), "%s", cached.c_str());
+        status = "ok";
+        ok = true;
+    } else if (status == nullptr) {
+        int err = ConfirmationID::Generate(iid.c_str(), confirmation_id, mode, productid.c_str(), defaults.overrideVersion);
+        status = err == SUCCESS ? "ok" : RequestFields::confidError(err);
+        ok = err == SUCCESS;
+
+        if (err != SUCCESS) {
+            confirmation_id[0] = 0;
+        } else if (cache != nullptr) {
+            cache->insert(cacheKey, confirmation_id);
+        }
+    }
+
+    if (!defaults.dashes) {
+        char *out = confirmation_id;
+        for (const char *in = confirmation_id; *in; in++) {
+            if (*in != '-') {
+                *out++ = *in;
+            }
+        }
+        *out = 0;
+    }
+
+    if (ok) {
+        succeeded++;
+    } else {
+        failed++;
+    }
+
+    // a verified CID is echoed as it was given
+    output.append(iid);
+    output.push_back('\t');
+    output.append(defaults.verify ? cid.c_str() : confirmation_id);
+    output.push_back('\t');
+    output.append(status);
+    output.push_back('\n');
+}
+
+void ConfidStream::process(Chunk &chunk) {
+    for (const std::string &line : chunk.lines) {
+        processLine(line, chunk.output);
+    }
+}
+
+/* Reads in until it runs dry, returns false when any line failed. */
+bool ConfidStream::run(std::istream &in, OutputWriter *writer) {
+    ThreadPool pool(threads);
+    size_t window = (size_t)pool.size() * CONFID_STREAM_WINDOW;
+
+    std::deque<std::unique_ptr<Chunk>> inFlight;
+#if UMSKT_THREADS
+    std::mutex lock;
+    std::condition_variable ready;
+#endif
+
+    OutputWriter::Buffer out(writer);
+
+    // writes the oldest chunk once it is done, so a slow line holds back what comes after it but never reorders it
+    auto writeOldest = [&] {
+        Chunk &chunk = *inFlight.front();
+#if UMSKT_THREADS
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            ready.wait(guard, [&chunk] { return chunk.done; });
+        }
+#endif
+        out.appendRaw(chunk.output);
+        inFlight.pop_front();
+
+        // whoever reads the other end gets every chunk as soon as it is in order
+        out.flush();
+        writer->flush();
+    };
+
+    std::string line;
+    bool more = true;
+
+    while (more) {
+        auto chunk = std::make_unique<Chunk>();
+        chunk->done = false;
+
+        while (chunk->lines.size() < CONFID_STREAM_CHUNK && (more = (bool)std::getline(in, line))) {
+            while (!line.empty() && (line.back() == '\r' || line.back() == ' ')) {
+                line.pop_back();
+            }
+            if (!line.empty()) {
+                chunk->lines.push_back(line);
+            }
+        }
+
+        if (chunk->lines.empty()) {
+            break;
+        }
+
+        Chunk *work = chunk.get();
+        inFlight.push_back(std::move(chunk));
+
+        pool.submit([&, work] {
+            process(*work);
+#if UMSKT_THREADS
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                work->done = true;
+            }
+            ready.notify_all();
+#else
+            work->done = true;
+#endif
+        });
+
+        while (inFlight.size() >= window) {
+            writeOldest();
+        }
+    }
+
+    while (!inFlight.empty()) {
+        writeOldest();
+    }
+
+    pool.shutdown();
+
+    return failed == 0;
+}
@@ -0,0 +1,85 @@
+/**
+ * This file is a part of the UMSKT Project
+ *
+ * Copyleft (C) 2019-2023 UMSKT Contributors (et.al.)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @FileCreated by Neo on 10/18/2026
+ * @Maintainer Neo
+ */
+
+
+#ifndef UMSKT_CONFIDSTREAM_H
+#define UMSKT_CONFIDSTREAM_H
+
+#include "header.h"
+#include "output.h"
+#include "resultcache.h"
+#include "threadpool.h"
+
+#include "libumskt/libumskt.h"
+
+#include <atomic>
+#include <memory>
+
+#define CONFID_STREAM_CHUNK     64      // installation IDs per unit of work
+#define CONFID_STREAM_WINDOW    4       // chunks in flight per worker
+
+/* Settings for lines that don't bring their own. */
+struct ConfidDefaults {
+    int activationMode;
+    std::string productid;
+    bool overrideVersion;
+    bool dashes;
+    bool verify;
+};
+
+/*
+ * Confirmation IDs for a stream of installation IDs, see --iid-file.
+ *
+ * Every input line is "IID [<tab> MODE] [<tab> PRODUCT ID]", every output line is
+ * "IID <tab> CID <tab> status", in input order. With verify (--verify-file) every line
+ * brings its CID as "IID <tab> CID [...]" and the status says whether it belongs to the IID.
+ * With a cache, repeated installation IDs are answered from it. Lines are read in chunks that go out to
+ * a pool of workers, at most a few chunks per worker are in flight at a time so memory
+ * stays flat no matter how long the input is, and finished chunks are written as soon as
+ * everything before them is.
+ */
+class ConfidStream {
+    struct Chunk {
+        std::vector<std::string> lines;
+        std::string output;
+        bool done;
+    };
+
+    ConfidDefaults defaults;
+    int threads;
+    ResultCache *cache;
+
+    static bool sameDigits(const std::string &a, const std::string &b);
+
+    void process(Chunk &chunk);
+    void processLine(const std::string &line, std::string &output);
+
+public:
+    std::atomic<QWORD> succeeded;
+    std::atomic<QWORD> failed;
+
+    ConfidStream(const ConfidDefaults &defaults, int threads, ResultCache *cache = nullptr);
+
+    bool run(std::istream &in, OutputWriter *writer);
+};
+
+#endif //UMSKT_CONFIDSTREAM_H
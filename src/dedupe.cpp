@@ -0,0 +1,190 @@
+/**
+ * This file is a part of the UMSKT Project
+ *
+ * Copyleft (C) 2019-2023 UMSKT Contributors (et.al.)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @FileCreated by Neo on 10/18/2026
+ * @Maintainer Neo
+ */
+
+
+#include "dedupe.h"
+
+#include <cmath>
+
+#define DEDUPE_USED             (1ULL << 63)
+
+KeyDedupe::KeyDedupe(STATS_OPERATION op, size_t memoryMiB, size_t expectedKeys) :
+    op(op), budget(memoryMiB * 1024 * 1024), slots(DEDUPE_MIN_SLOTS), used(0), blockMask(0), bloomLimit(0), inserted(0), duplicates(0), full(false) {
+    // start out big enough for the whole run at 3/4 load, if the budget allows
+    while (slots * 3 / 4 < expectedKeys && slots * 2 * 2 * sizeof(QWORD) <= budget / 2) {
+        slots *= 2;
+    }
+
+    table.assign(slots * 2, 0);
+}
+
+/* splitmix64 finalizer over both halves of the payload. */
+QWORD KeyDedupe::hash(const QWORD (&pRaw)[2]) {
+    QWORD h = pRaw[0] ^ (pRaw[1] * 0x9E3779B97F4A7C15ULL);
+
+    h ^= h >> 30;
+    h *= 0xBF58476D1CE4E5B9ULL;
+    h ^= h >> 27;
+    h *= 0x94D049BB133111EBULL;
+    h ^= h >> 31;
+
+    return h;
+}
+
+bool KeyDedupe::insertExact(QWORD lo, QWORD hi, QWORD h) {
+    size_t mask = slots - 1;
+
+    for (size_t i = h & mask;; i = (i + 1) & mask) {
+        QWORD *slot = &table[i * 2];
+
+        if (!(slot[1] & DEDUPE_USED)) {
+            slot[0] = lo;
+            slot[1] = hi | DEDUPE_USED;
+            used++;
+            return true;
+        }
+
+        if (slot[0] == lo && slot[1] == (hi | DEDUPE_USED)) {
+            return false;
+        }
+    }
+}
+
+bool KeyDedupe::insertBloom(QWORD h) {
+    QWORD *block = &bloom[((h >> 32) & blockMask) * DEDUPE_BLOCK_WORDS];
+
+    // double hashing inside the 512-bit block, the odd step visits DEDUPE_PROBES distinct bits
+    DWORD bit = (DWORD)h & 511, step = ((DWORD)(h >> 9) & 511) | 1;
+    bool isNew = false;
+
+    for (int i = 0; i < DEDUPE_PROBES; i++, bit = (bit + step) & 511) {
+        QWORD mask = 1ULL << (bit & 63);
+
+        if (!(block[bit >> 6] & mask)) {
+            block[bit >> 6] |= mask;
+            isNew = true;
+        }
+    }
+
+    return isNew;
+}
+
+/*
+ * Doubles the exact table, or gives up on exactness when that would not fit half the budget.
+ * The old table is still around while the new one fills, half keeps the two within budget.
+ */
+void KeyDedupe::grow() {
+    if (slots * 2 * 2 * sizeof(QWORD) > budget / 2) {
+        switchToBloom();
+        return;
+    }
+
+    std::vector<QWORD> old;
+    old.swap(table);
+
+    slots *= 2;
+    used = 0;
+    table.assign(slots * 2, 0);
+
+    for (size_t i = 0; i < old.size(); i += 2) {
+        if (old[i + 1] & DEDUPE_USED) {
+            QWORD pRaw[2] = { old[i], old[i + 1] & ~DEDUPE_USED };
+            insertExact(pRaw[0], pRaw[1], hash(pRaw));
+        }
+    }
+}
+
+void KeyDedupe::switchToBloom() {
+    // the table is only freed once its keys are in the filter, which gets what is left
+    size_t room = budget - table.size() * sizeof(QWORD);
+
+    size_t blocks = 1;
+    while (blocks * 2 * DEDUPE_BLOCK_WORDS * sizeof(QWORD) <= room) {
+        blocks *= 2;
+    }
+
+    blockMask = blocks - 1;
+    bloom.assign(blocks * DEDUPE_BLOCK_WORDS, 0);
+
+    // falsePositiveRate() solved for the number of keys at DEDUPE_MAX_FALSE_RATE
+    double perBlock = -512.0 / DEDUPE_PROBES * std::log(1.0 - std::pow(DEDUPE_MAX_FALSE_RATE, 1.0 / DEDUPE_PROBES));
+    bloomLimit = (QWORD)(perBlock * (double)blocks);
+
+    for (size_t i = 0; i < table.size(); i += 2) {
+        if (table[i + 1] & DEDUPE_USED) {
+            QWORD pRaw[2] = { table[i], table[i + 1] & ~DEDUPE_USED };
+            insertBloom(hash(pRaw));
+        }
+    }
+
+    table = std::vector<QWORD>();
+    slots = used = 0;
+}
+
+/*
+ * Returns true if the key was not seen before, false (and counts a rejection) for a duplicate.
+ * A full set returns false for every key without counting anything, see isFull().
+ */
+bool KeyDedupe::insert(const QWORD (&pRaw)[2]) {
+    QWORD h = hash(pRaw);
+    bool isNew;
+
+    {
+#if UMSKT_THREADS
+        std::lock_guard<std::mutex> guard(lock);
+#endif
+        if (isExact()) {
+            if (used + 1 > slots * 3 / 4) {
+                grow();
+            }
+        }
+
+        if (!isExact() && inserted >= bloomLimit) {
+            full.store(true, std::memory_order_relaxed);
+            return false;
+        }
+
+        isNew = isExact() ? insertExact(pRaw[0], pRaw[1], h) : insertBloom(h);
+
+        if (isNew) {
+            inserted++;
+        } else {
+            duplicates++;
+        }
+    }
+
+    if (!isNew) {
+        GenerationStats::reject(op, REJECT_DUPLICATE);
+    }
+
+    return isNew;
+}
+
+/* Chance that a fresh key is mistaken for a duplicate at the current fill level. */
+double KeyDedupe::falsePositiveRate() const {
+    if (isExact()) {
+        return 0.0;
+    }
+
+    double perBlock = (double)inserted / (double)(blockMask + 1);
+    return std::pow(1.0 - std::exp(-DEDUPE_PROBES * perBlock / 512.0), DEDUPE_PROBES);
+}
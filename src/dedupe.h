@@ -0,0 +1,94 @@
+/**
+ * This file is a part of the UMSKT Project
+ *
+ * Copyleft (C) 2019-2023 UMSKT Contributors (et.al.)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @FileCreated by Neo on 10/18/2026
+ * @Maintainer Neo
+ */
+
+
+#ifndef UMSKT_DEDUPE_H
+#define UMSKT_DEDUPE_H
+
+#include "header.h"
+
+#include "libumskt/libumskt.h"
+#include "libumskt/stats.h"
+
+#include <atomic>
+
+#if UMSKT_THREADS
+#include <mutex>
+#endif
+
+#define DEDUPE_DEFAULT_MEMORY   256     // MiB
+#define DEDUPE_MIN_MEMORY       16      // MiB
+#define DEDUPE_MAX_FALSE_RATE   0.25    // a fuller Bloom filter rejects too many fresh keys to be of use
+#define DEDUPE_MIN_SLOTS        1024
+#define DEDUPE_BLOCK_WORDS      8       // one 64-byte cache line per Bloom block
+#define DEDUPE_PROBES           8
+
+/*
+ * Remembers every key payload of a run so duplicates can be thrown away and regenerated.
+ *
+ * Keys are 114 bits, so the packed payload (pRaw[0], pRaw[1]) itself is the set member.
+ * As long as it fits into half the memory budget this is an exact open addressing hash set,
+ * once it would outgrow that it turns into a blocked Bloom filter sized to what the budget
+ * leaves next to the table, so the two together never take more than the budget while the
+ * keys are moved over. The filter never lets a duplicate through, a false positive only
+ * costs a regeneration. There is no exact fallback behind the filter, what it forgets
+ * about a key can't be recovered.
+ * Once the false positive rate would pass DEDUPE_MAX_FALSE_RATE the set is full: insert
+ * rejects everything from then on and callers have to give up on the run.
+ */
+class KeyDedupe {
+    STATS_OPERATION op;
+    size_t budget;
+
+    // exact mode: 2 QWORDs per slot, pRaw[1] only uses 50 bits so bit 63 marks a used slot
+    std::vector<QWORD> table;
+    size_t slots, used;
+
+    // Bloom mode: blocks of DEDUPE_BLOCK_WORDS words, all probes of a key land in one block
+    std::vector<QWORD> bloom;
+    size_t blockMask;
+    QWORD bloomLimit;   // keys the filter takes before it counts as full
+
+    QWORD inserted, duplicates;
+    std::atomic<bool> full;
+#if UMSKT_THREADS
+    std::mutex lock;
+#endif
+
+    static QWORD hash(const QWORD (&pRaw)[2]);
+    bool insertExact(QWORD lo, QWORD hi, QWORD h);
+    bool insertBloom(QWORD h);
+    void grow();
+    void switchToBloom();
+
+public:
+    KeyDedupe(STATS_OPERATION op, size_t memoryMiB, size_t expectedKeys);
+
+    bool insert(const QWORD (&pRaw)[2]);
+
+    bool isExact() const { return bloom.empty(); }
+    bool isFull() const { return full.load(std::memory_order_relaxed); }
+    QWORD getDuplicates() const { return duplicates; }
+    double falsePositiveRate() const;
+};
+
+#endif //UMSKT_DEDUPE_H
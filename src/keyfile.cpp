@@ -0,0 +1,137 @@
+/**
+ * This file is a part of the UMSKT Project
+ *
+ * Copyleft (C) 2019-2023 UMSKT Contributors (et.al.)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @FileCreated by Neo on 10/18/2026
+ * @Maintainer Neo
+ */
+
+
+#include "keyfile.h"
+
+/* Parses a BINK ID such as "2E" into its byte value. */
+bool KeyFile::parseBINK(const std::string &binkid, BYTE *out) {
+    unsigned int value;
+
+    if (binkid.empty() || binkid.size() > 2 || sscanf(binkid.c_str(), "%x", &value) != 1) {
+        return false;
+    }
+
+    *out = (BYTE)value;
+    return true;
+}
+
+std::string KeyFile::formatBINK(BYTE binkid) {
+    return fmt::format("{:02X}", binkid);
+}
+
+void KeyFile::encodeHeader(BYTE *out, const KeyFileHeader &header) {
+    memset(out, 0, KEYFILE_HEADER_SIZE);
+    memcpy(out, KEYFILE_MAGIC, KEYFILE_MAGIC_LENGTH);
+
+    out[8] = KEYFILE_VERSION;
+    out[9] = header.algorithm;
+    out[10] = KEYFILE_RECORD_SIZE;
+    out[11] = header.binkid;
+}
+
+bool KeyFile::decodeHeader(const BYTE *in, KeyFileHeader *header) {
+    if (memcmp(in, KEYFILE_MAGIC, KEYFILE_MAGIC_LENGTH) != 0) {
+        return false;
+    }
+
+    if (in[8] != KEYFILE_VERSION || in[10] != KEYFILE_RECORD_SIZE) {
+        return false;
+    }
+
+    if (in[9] != ALGORITHM_BINK1998 && in[9] != ALGORITHM_BINK2002) {
+        return false;
+    }
+
+    header->algorithm = (KEYFILE_ALGORITHM)in[9];
+    header->binkid = in[11];
+    return true;
+}
+
+/* Records are always little-endian on disk, regardless of the host. */
+void KeyFile::encodeRecord(BYTE *out, const QWORD (&pRaw)[2]) {
+    for (int i = 0; i < 8; i++) {
+        out[i] = (BYTE)(pRaw[0] >> (i * 8));
+        out[i + 8] = (BYTE)(pRaw[1] >> (i * 8));
+    }
+}
+
+void KeyFile::decodeRecord(const BYTE *in, QWORD (&pRaw)[2]) {
+    pRaw[0] = pRaw[1] = 0;
+
+    for (int i = 7; i >= 0; i--) {
+        pRaw[0] = pRaw[0] << 8 | in[i];
+        pRaw[1] = pRaw[1] << 8 | in[i + 8];
+    }
+}
+
+KeyFileReader::KeyFileReader(std::FILE *file, bool ownsFile) :
+    file(file), ownsFile(ownsFile), header(), position(0), length(0) {
+}
+
+KeyFileReader::~KeyFileReader() {
+    if (ownsFile) {
+        std::fclose(file);
+    }
+}
+
+/* Opens a key file and checks its header, an empty name or "-" means stdin. Returns nullptr on failure. */
+KeyFileReader *KeyFileReader::open(const std::string &filename) {
+    bool useStdin = filename.empty() || filename == "-";
+
+    std::FILE *file = useStdin ? stdin : std::fopen(filename.c_str(), "rb");
+    if (file == nullptr) {
+        return nullptr;
+    }
+
+    KeyFileReader *reader = new KeyFileReader(file, !useStdin);
+
+    BYTE header[KEYFILE_HEADER_SIZE];
+    if (std::fread(header, 1, KEYFILE_HEADER_SIZE, file) != KEYFILE_HEADER_SIZE || !KeyFile::decodeHeader(header, &reader->header)) {
+        delete reader;
+        return nullptr;
+    }
+
+    reader->block.resize(KEYFILE_READ_RECORDS * KEYFILE_RECORD_SIZE);
+    return reader;
+}
+
+/* Fetches the next record, returns false once the file is exhausted. A truncated trailing record is ignored. */
+bool KeyFileReader::next(QWORD (&pRaw)[2]) {
+    if (length - position < KEYFILE_RECORD_SIZE) {
+        position = 0;
+        length = std::fread(block.data(), 1, block.size(), file);
+
+        // fread only comes up short at the end of the file, but pipes may hand us partial blocks
+        while (length % KEYFILE_RECORD_SIZE && !std::feof(file) && !std::ferror(file)) {
+            length += std::fread(block.data() + length, 1, block.size() - length, file);
+        }
+
+        if (length < KEYFILE_RECORD_SIZE) {
+            return false;
+        }
+    }
+
+    KeyFile::decodeRecord(&block[position], pRaw);
+    position += KEYFILE_RECORD_SIZE;
+    return true;
+}
@@ -0,0 +1,97 @@
+/**
+ * This file is a part of the UMSKT Project
+ *
+ * Copyleft (C) 2019-2023 UMSKT Contributors (et.al.)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @FileCreated by Neo on 10/18/2026
+ * @Maintainer Neo
+ */
+
+
+#ifndef UMSKT_KEYFILE_H
+#define UMSKT_KEYFILE_H
+
+#include "header.h"
+
+#include "libumskt/libumskt.h"
+
+/*
+ * Binary key files.
+ *
+ * A key only carries 114 bits of information, so instead of 29 characters of dashed
+ * Base24 text we store the packed payload (pRaw[0], pRaw[1]) as a 16-byte little-endian
+ * record. The 16-byte header up front says which BINK and algorithm the records belong to:
+ *
+ *   0..7   magic "UMSKTKEY"
+ *   8      format version
+ *   9      algorithm (KEYFILE_ALGORITHM)
+ *   10     record size in bytes
+ *   11     BINK ID
+ *   12..15 reserved, zero
+ */
+
+#define KEYFILE_MAGIC           "UMSKTKEY"
+#define KEYFILE_MAGIC_LENGTH    8
+#define KEYFILE_VERSION         1
+#define KEYFILE_HEADER_SIZE     16
+#define KEYFILE_RECORD_SIZE     16
+#define KEYFILE_READ_RECORDS    4096
+
+enum KEYFILE_ALGORITHM {
+    ALGORITHM_BINK1998 = 1,
+    ALGORITHM_BINK2002 = 2,
+};
+
+struct KeyFileHeader {
+    KEYFILE_ALGORITHM algorithm;
+    BYTE binkid;
+};
+
+class KeyFile {
+public:
+    static bool parseBINK(const std::string &binkid, BYTE *out);
+    static std::string formatBINK(BYTE binkid);
+
+    static void encodeHeader(BYTE *out, const KeyFileHeader &header);
+    static bool decodeHeader(const BYTE *in, KeyFileHeader *header);
+
+    static void encodeRecord(BYTE *out, const QWORD (&pRaw)[2]);
+    static void decodeRecord(const BYTE *in, QWORD (&pRaw)[2]);
+};
+
+/* Streams records out of a binary key file, reading them in large blocks. */
+class KeyFileReader {
+    std::FILE *file;
+    bool ownsFile;
+    KeyFileHeader header;
+    std::vector<BYTE> block;
+    size_t position, length;
+
+    KeyFileReader(std::FILE *file, bool ownsFile);
+
+public:
+    ~KeyFileReader();
+
+    KeyFileReader(const KeyFileReader &) = delete;
+    KeyFileReader &operator=(const KeyFileReader &) = delete;
+
+    static KeyFileReader *open(const std::string &filename);
+
+    const KeyFileHeader &getHeader() const { return header; }
+    bool next(QWORD (&pRaw)[2]);
+};
+
+#endif //UMSKT_KEYFILE_H
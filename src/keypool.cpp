@@ -0,0 +1,349 @@
+/**
+ * This file is a part of the UMSKT Project
+ *
+ * Copyleft (C) 2019-2023 UMSKT Contributors (et.al.)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @FileCreated by Neo on 10/18/2026
+ * @Maintainer Neo
+ */
+
+
+#include "keypool.h"
+#include "keyfile.h"
+#include "shard.h"
+
+#include "libumskt/pidgen3/BINK1998.h"
+#include "libumskt/pidgen3/BINK2002.h"
+
+std::string PoolProfile::name() const {
+    return fmt::format("{}-{:03d}-{:06d}-{:06d}-{}", binkid, channelID, serMin, serMax, upgrade ? 1 : 0);
+}
+
+bool PoolProfile::parseName(const std::string &name, PoolProfile *profile) {
+    char binkid[3];
+    unsigned channelID, serMin, serMax, upgrade;
+
+    if (sscanf(name.c_str(), "%2[0-9A-Fa-f]-%u-%u-%u-%u", binkid, &channelID, &serMin, &serMax, &upgrade) != 5) {
+        return false;
+    }
+
+    *profile = PoolProfile { binkid, channelID, serMin, serMax, upgrade != 0 };
+    return profile->name() == name;
+}
+
+KeyPool::KeyPool(const PoolProfile &profile, const PIDGEN3::BINKCurve *curve, DWORD capacity) :
+    profile(profile), curve(curve), capacity(capacity), header(nullptr), slots(nullptr), stopping(false) {
+    int intBinkID = 0;
+    sscanf(profile.binkid.c_str(), "%x", &intBinkID);
+    bink2002 = intBinkID >= 0x40;
+
+    memory.resize((KEYPOOL_HEADER_SIZE + (size_t)capacity * KEYPOOL_RECORD_SIZE) / sizeof(QWORD));
+    header = (KeyPoolHeader *)memory.data();
+    slots = (BYTE *)memory.data() + KEYPOOL_HEADER_SIZE;
+    reset();
+}
+
+KeyPool::~KeyPool() {
+    stop();
+}
+
+/* Starts over with an empty pool for our profile. */
+void KeyPool::reset() {
+    memset(header, 0, KEYPOOL_HEADER_SIZE);
+    memcpy(header->magic, KEYPOOL_MAGIC, KEYPOOL_MAGIC_LENGTH);
+    header->version = KEYPOOL_VERSION;
+    header->capacity = capacity;
+    header->channelID = profile.channelID;
+    header->serMin = profile.serMin;
+    header->serMax = profile.serMax;
+    header->upgrade = profile.upgrade ? 1 : 0;
+    KeyFile::parseBINK(profile.binkid, &header->binkid);
+}
+
+/*
+ * Moves the pool into a memory mapped file so its keys survive a restart. Keys already
+ * in the file are kept as long as it belongs to the same profile, a file of a different
+ * capacity is repacked. Must be called before start().
+ */
+bool KeyPool::attach(const std::string &filename) {
+    size_t length = KEYPOOL_HEADER_SIZE + (size_t)capacity * KEYPOOL_RECORD_SIZE;
+
+    if (!file.open(filename, KEYPOOL_HEADER_SIZE)) {
+        return false;
+    }
+
+    const KeyPoolHeader *existing = (const KeyPoolHeader *)file.get();
+    std::vector<BYTE> keys;
+
+    BYTE binkid = 0;
+    KeyFile::parseBINK(profile.binkid, &binkid);
+
+    bool sameProfile = memcmp(existing->magic, KEYPOOL_MAGIC, KEYPOOL_MAGIC_LENGTH) == 0 &&
+                       existing->version == KEYPOOL_VERSION &&
+                       existing->binkid == binkid &&
+                       existing->channelID == profile.channelID &&
+                       existing->serMin == profile.serMin &&
+                       existing->serMax == profile.serMax &&
+                       existing->upgrade == (profile.upgrade ? 1 : 0) &&
+                       existing->capacity != 0 &&
+                       existing->count <= existing->capacity &&
+                       file.size() >= KEYPOOL_HEADER_SIZE + (size_t)existing->capacity * KEYPOOL_RECORD_SIZE;
+
+    if (sameProfile && existing->capacity == capacity && file.size() == length) {
+        header = (KeyPoolHeader *)file.get();
+        slots = file.get() + KEYPOOL_HEADER_SIZE;
+        memory = std::vector<QWORD>();
+        return true;
+    }
+
+    // different layout, pull out whatever keys fit before repacking
+    if (sameProfile) {
+        const BYTE *oldSlots = file.get() + KEYPOOL_HEADER_SIZE;
+        QWORD keep = std::min<QWORD>(existing->count, capacity);
+
+        for (QWORD i = 0; i < keep; i++) {
+            const BYTE *slot = oldSlots + ((existing->head + i) % existing->capacity) * KEYPOOL_RECORD_SIZE;
+            keys.insert(keys.end(), slot, slot + KEYPOOL_RECORD_SIZE);
+        }
+    }
+
+    if (file.size() != length && !file.resize(length)) {
+        file.close();
+        return false;
+    }
+
+    header = (KeyPoolHeader *)file.get();
+    slots = file.get() + KEYPOOL_HEADER_SIZE;
+    memory = std::vector<QWORD>();
+
+    reset();
+    memcpy(slots, keys.data(), keys.size());
+    header->count = keys.size() / KEYPOOL_RECORD_SIZE;
+    return true;
+}
+
+/* Generates and verifies a single key for our profile, gives up without a key once the pool is stopping. */
+bool KeyPool::generate(QWORD (&pRaw)[2]) {
+    if (bink2002) {
+        DWORD random;
+        UMSKT::umskt_rand_bytes((BYTE *)&random, sizeof(random));
+
+        // a narrow serial range can take minutes per key, stop() must not wait for that
+        DWORD pSerial;
+        return PIDGEN3::BINK2002::Generate(*curve, profile.channelID, random & BITMASK(10), profile.upgrade, profile.serMin, profile.serMax, &pSerial, pRaw, &stopping)
+            && PIDGEN3::BINK2002::Verify(*curve, &pSerial, pRaw);
+    }
+
+    DWORD nRaw = profile.channelID * 1'000'000 + KeyShards::pickSerial(profile.serMin, profile.serMax, false, 0);
+    PIDGEN3::BINK1998::Generate(*curve, nRaw, profile.upgrade, pRaw);
+    return PIDGEN3::BINK1998::Verify(*curve, pRaw);
+}
+
+#if UMSKT_THREADS
+void KeyPool::fillLoop() {
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            refill.wait(guard, [this] { return stopping || header->count < capacity; });
+
+            if (stopping) {
+                return;
+            }
+        }
+
+        // the expensive part runs unlocked, takers only wait for the slot update below
+        QWORD pRaw[2]{};
+        if (!generate(pRaw)) {
+            if (stopping) {
+                return;
+            }
+            continue;
+        }
+
+        std::lock_guard<std::mutex> guard(lock);
+        if (header->count < capacity) {
+            KeyFile::encodeRecord(slots + ((header->head + header->count) % capacity) * KEYPOOL_RECORD_SIZE, pRaw);
+            header->count++;
+        }
+    }
+}
+
+void KeyPool::start() {
+    if (!filler.joinable()) {
+        stopping = false;
+        filler = std::thread(&KeyPool::fillLoop, this);
+    }
+}
+
+/* Stops refilling, cancels a key that is being generated and flushes the file. */
+void KeyPool::stop() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    refill.notify_all();
+
+    if (filler.joinable()) {
+        filler.join();
+    }
+
+    file.sync();
+}
+
+bool KeyPool::take(QWORD (&pRaw)[2]) {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (header->count == 0) {
+            return false;
+        }
+
+        QWORD head = header->head;
+        header->head = (head + 1) % capacity;
+        header->count--;
+
+        KeyFile::decodeRecord(slots + head * KEYPOOL_RECORD_SIZE, pRaw);
+    }
+
+    refill.notify_one();
+    return true;
+}
+
+DWORD KeyPool::available() {
+    std::lock_guard<std::mutex> guard(lock);
+    return (DWORD)header->count;
+}
+#else
+// without threads nobody refills the pool, it only hands out what was persisted
+void KeyPool::fillLoop() {
+}
+
+void KeyPool::start() {
+}
+
+void KeyPool::stop() {
+    file.sync();
+}
+
+bool KeyPool::take(QWORD (&pRaw)[2]) {
+    if (header->count == 0) {
+        return false;
+    }
+
+    QWORD head = header->head;
+    header->head = (head + 1) % capacity;
+    header->count--;
+
+    KeyFile::decodeRecord(slots + head * KEYPOOL_RECORD_SIZE, pRaw);
+    return true;
+}
+
+DWORD KeyPool::available() {
+    return (DWORD)header->count;
+}
+#endif
+
+KeyPoolSet::KeyPoolSet(DWORD capacity, const std::string &directory) : capacity(capacity), directory(directory), stopped(false) {
+}
+
+KeyPoolSet::~KeyPoolSet() {
+    stop();
+}
+
+/* Returns the running pool of a profile, or nullptr if pooling is off, the BINK is unknown or there are too many pools. */
+KeyPool *KeyPoolSet::get(const PoolProfile &profile) {
+    if (capacity == 0) {
+        return nullptr;
+    }
+
+    std::string name = profile.name();
+
+#if UMSKT_THREADS
+    std::lock_guard<std::mutex> guard(lock);
+#endif
+    auto it = pools.find(name);
+    if (it != pools.end()) {
+        return it->second.get();
+    }
+
+    if (stopped) {
+        return nullptr;
+    }
+
+    const PIDGEN3::BINKCurve *curve = PIDGEN3::CurveRegistry::get(profile.binkid);
+    if (curve == nullptr || pools.size() >= KEYPOOL_MAX_POOLS) {
+        return nullptr;
+    }
+
+    auto pool = std::make_unique<KeyPool>(profile, curve, capacity);
+
+    if (!directory.empty()) {
+        std::string filename = (fs::path(directory) / (name + ".pool")).string();
+        if (!pool->attach(filename)) {
+            fmt::print(stderr, "WARNING: unable to persist key pool {}, keeping it in memory\n", filename);
+        }
+    }
+
+    pool->start();
+    return pools.emplace(name, std::move(pool)).first->second.get();
+}
+
+/* Brings back every pool persisted in the directory, returns how many were found. */
+int KeyPoolSet::load() {
+    if (capacity == 0 || directory.empty()) {
+        return 0;
+    }
+
+    std::error_code error;
+    fs::create_directories(directory, error);
+
+    int loaded = 0;
+    for (auto &entry : fs::directory_iterator(directory, error)) {
+        PoolProfile profile;
+
+        if (entry.path().extension() == ".pool" && PoolProfile::parseName(entry.path().stem().string(), &profile) && get(profile) != nullptr) {
+            loaded++;
+        }
+    }
+
+    return loaded;
+}
+
+void KeyPoolSet::stop() {
+#if UMSKT_THREADS
+    std::lock_guard<std::mutex> guard(lock);
+#endif
+    stopped = true;
+    for (auto &pool : pools) {
+        pool.second->stop();
+    }
+}
+
+json KeyPoolSet::status() {
+#if UMSKT_THREADS
+    std::lock_guard<std::mutex> guard(lock);
+#endif
+    json result = json::array();
+
+    for (auto &pool : pools) {
+        result.push_back({
+                { "profile", pool.first },
+                { "available", pool.second->available() },
+                { "capacity", pool.second->getCapacity() },
+        });
+    }
+
+    return result;
+}
@@ -0,0 +1,152 @@
+/**
+ * This file is a part of the UMSKT Project
+ *
+ * Copyleft (C) 2019-2023 UMSKT Contributors (et.al.)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @FileCreated by Neo on 10/18/2026
+ * @Maintainer Neo
+ */
+
+
+#ifndef UMSKT_KEYPOOL_H
+#define UMSKT_KEYPOOL_H
+
+#include "header.h"
+#include "mappedfile.h"
+
+#include "libumskt/libumskt.h"
+#include "libumskt/pidgen3/CurveRegistry.h"
+
+#include <atomic>
+#include <map>
+#include <memory>
+
+#if UMSKT_THREADS
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
+
+#define KEYPOOL_MAGIC           "UMSKTPOL"
+#define KEYPOOL_MAGIC_LENGTH    8
+#define KEYPOOL_VERSION         1
+#define KEYPOOL_HEADER_SIZE     64
+#define KEYPOOL_RECORD_SIZE     16
+#define KEYPOOL_MAX_POOLS       64
+
+/* Everything that has to match for two keys to be interchangeable. */
+struct PoolProfile {
+    std::string binkid;
+    DWORD channelID;
+    DWORD serMin, serMax;
+    BOOL upgrade;
+
+    std::string name() const;
+    static bool parseName(const std::string &name, PoolProfile *profile);
+};
+
+/*
+ * Start of a pool file, followed by capacity records in the key file record layout.
+ *
+ * The slots form a ring, keys are taken at head and added at head + count. head is
+ * advanced before a key is handed out, so a crash can lose a key but never issue one
+ * twice. Stored in host byte order, pool files are not meant to be moved around.
+ */
+struct KeyPoolHeader {
+    char magic[KEYPOOL_MAGIC_LENGTH];
+    DWORD version;
+    DWORD capacity;
+    QWORD head;
+    QWORD count;
+    DWORD channelID;
+    DWORD serMin;
+    DWORD serMax;
+    BYTE binkid;
+    BYTE upgrade;
+    BYTE reserved[18];
+};
+
+static_assert(sizeof(KeyPoolHeader) == KEYPOOL_HEADER_SIZE, "pool header layout");
+
+/*
+ * Verified keys of a single profile, ready to be handed out.
+ *
+ * A background thread tops the pool up to its capacity whenever keys are taken,
+ * so issuing a key is a couple of loads and stores under a lock instead of a round
+ * of elliptic curve math with an unpredictable number of retries.
+ */
+class KeyPool {
+    PoolProfile profile;
+    const PIDGEN3::BINKCurve *curve;
+    bool bink2002;
+    DWORD capacity;
+
+    MappedFile file;
+    std::vector<QWORD> memory;
+    KeyPoolHeader *header;
+    BYTE *slots;
+    std::atomic<bool> stopping;     // also cancels a BINK2002 search that is under way
+
+#if UMSKT_THREADS
+    std::mutex lock;
+    std::condition_variable refill;
+    std::thread filler;
+#endif
+
+    void reset();
+    bool generate(QWORD (&pRaw)[2]);
+    void fillLoop();
+
+public:
+    KeyPool(const PoolProfile &profile, const PIDGEN3::BINKCurve *curve, DWORD capacity);
+    ~KeyPool();
+
+    KeyPool(const KeyPool &) = delete;
+    KeyPool &operator=(const KeyPool &) = delete;
+
+    bool attach(const std::string &filename);
+    void start();
+    void stop();
+
+    bool take(QWORD (&pRaw)[2]);
+    DWORD available();
+    DWORD getCapacity() const { return capacity; }
+    const PoolProfile &getProfile() const { return profile; }
+};
+
+/* One pool per profile, created on first use and persisted in directory if one is given. */
+class KeyPoolSet {
+    DWORD capacity;
+    std::string directory;
+    std::map<std::string, std::unique_ptr<KeyPool>> pools;
+    bool stopped;       // no new pools once set
+#if UMSKT_THREADS
+    std::mutex lock;
+#endif
+
+public:
+    KeyPoolSet(DWORD capacity, const std::string &directory);
+    ~KeyPoolSet();
+
+    bool isEnabled() const { return capacity != 0; }
+
+    KeyPool *get(const PoolProfile &profile);
+    int load();
+    void stop();
+    json status();
+};
+
+#endif //UMSKT_KEYPOOL_H
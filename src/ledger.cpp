@@ -0,0 +1,405 @@
+/**
+ * This file is a part of the UMSKT Project
+ *
+ * Copyleft (C) 2019-2023 UMSKT Contributors (et.al.)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @FileCreated by Neo on 10/18/2026
+ * @Maintainer Neo
+ */
+
+
+#include "ledger.h"
+#include "keyfile.h"
+
+#include <ctime>
+
+#if UMSKT_HAVE_MMAP
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#endif
+
+#define LEDGER_INDEX_BITS       40
+#define LEDGER_INDEX_MASK       BITMASK(LEDGER_INDEX_BITS)
+
+namespace {
+    // slot = fingerprint << 40 | (record + 1), 0 marks an empty slot
+    void placeSlot(QWORD *table, QWORD slotCount, QWORD h, QWORD i) {
+        QWORD mask = slotCount - 1;
+
+        for (QWORD s = h & mask;; s = (s + 1) & mask) {
+            if (table[s] == 0) {
+                table[s] = (h >> LEDGER_INDEX_BITS) << LEDGER_INDEX_BITS | (i + 1);
+                return;
+            }
+        }
+    }
+
+    bool isBlank(const BYTE *data, size_t length) {
+        for (size_t i = 0; i < length; i++) {
+            if (data[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+KeyLedger::KeyLedger(const std::string &filename, bool readOnly) : filename(filename), readOnly(readOnly), capacity(0), lockFd(-1) {
+}
+
+KeyLedger::~KeyLedger() {
+    if (!readOnly && records.isOpen()) {
+        sync();
+    }
+
+    // unmap before letting go of the lock, the next writer may rebuild the index right away
+    index.close();
+    records.close();
+
+#if UMSKT_HAVE_MMAP
+    if (lockFd >= 0) {
+        ::close(lockFd);
+    }
+#endif
+}
+
+/* Takes the exclusive writer lock on the ledger without waiting for it. */
+bool KeyLedger::lockWriter(bool *inUse) {
+#if UMSKT_HAVE_MMAP
+    lockFd = ::open(filename.c_str(), O_RDWR | O_CREAT, 0644);
+    if (lockFd < 0) {
+        return false;
+    }
+
+    if (flock(lockFd, LOCK_EX | LOCK_NB) != 0) {
+        if (inUse != nullptr && errno == EWOULDBLOCK) {
+            *inUse = true;
+        }
+        return false;
+    }
+#endif
+    return true;
+}
+
+/*
+ * Opens (or for writers creates) a ledger, returns nullptr if the file is not a ledger
+ * or, for writers, if another writer has it open.
+ */
+KeyLedger *KeyLedger::open(const std::string &filename, bool readOnly, bool *inUse) {
+    KeyLedger *ledger = new KeyLedger(filename, readOnly);
+
+    if (inUse != nullptr) {
+        *inUse = false;
+    }
+
+    // the lock comes first, even creating the file and writing its header is the writer's job
+    if (!readOnly && !ledger->lockWriter(inUse)) {
+        delete ledger;
+        return nullptr;
+    }
+
+    if (!ledger->records.open(filename, readOnly ? 0 : LEDGER_HEADER_SIZE + LEDGER_MIN_RECORDS * LEDGER_RECORD_SIZE, readOnly) ||
+        ledger->records.size() < LEDGER_HEADER_SIZE) {
+        delete ledger;
+        return nullptr;
+    }
+
+    LedgerHeader *header = ledger->header();
+
+    if (!readOnly && isBlank(ledger->records.get(), LEDGER_HEADER_SIZE)) {
+        memcpy(header->magic, LEDGER_MAGIC, LEDGER_MAGIC_LENGTH);
+        header->version = LEDGER_VERSION;
+        header->recordSize = LEDGER_RECORD_SIZE;
+        header->count = 0;
+    }
+
+    ledger->capacity = (ledger->records.size() - LEDGER_HEADER_SIZE) / LEDGER_RECORD_SIZE;
+
+    if (memcmp(header->magic, LEDGER_MAGIC, LEDGER_MAGIC_LENGTH) != 0 || header->version != LEDGER_VERSION ||
+        header->recordSize != LEDGER_RECORD_SIZE || header->count > ledger->capacity) {
+        delete ledger;
+        return nullptr;
+    }
+
+    if (!ledger->openIndex() && !readOnly) {
+        delete ledger;
+        return nullptr;
+    }
+
+    return ledger;
+}
+
+QWORD KeyLedger::hash(BYTE binkid, const BYTE *payload) {
+    QWORD lo, hi;
+    memcpy(&lo, payload, 8);
+    memcpy(&hi, payload + 8, 8);
+
+    QWORD h = lo ^ (hi * 0x9E3779B97F4A7C15ULL) ^ ((QWORD)binkid << 56);
+
+    h ^= h >> 30;
+    h *= 0xBF58476D1CE4E5B9ULL;
+    h ^= h >> 27;
+    h *= 0x94D049BB133111EBULL;
+    h ^= h >> 31;
+
+    return h;
+}
+
+bool KeyLedger::matches(QWORD i, BYTE binkid, const BYTE *payload) const {
+    const LedgerRecord *r = record(i);
+    return r->binkid == binkid && memcmp(r->payload, payload, sizeof(r->payload)) == 0;
+}
+
+/* Maps the index, writers rebuild it if it is missing or broken and catch it up with the ledger. */
+bool KeyLedger::openIndex() {
+    std::string indexName = filename + ".idx";
+
+    bool valid = index.open(indexName, readOnly ? 0 : LEDGER_HEADER_SIZE, readOnly) &&
+                 memcmp(indexHeader()->magic, LEDGER_INDEX_MAGIC, LEDGER_MAGIC_LENGTH) == 0 &&
+                 indexHeader()->version == LEDGER_VERSION &&
+                 indexHeader()->slots >= LEDGER_MIN_SLOTS &&
+                 (indexHeader()->slots & (indexHeader()->slots - 1)) == 0 &&
+                 index.size() >= LEDGER_HEADER_SIZE + indexHeader()->slots * sizeof(QWORD) &&
+                 indexHeader()->indexed <= header()->count;
+
+    if (readOnly) {
+        if (!valid) {
+            index.close();
+        }
+        return valid;
+    }
+
+    if (!valid) {
+        QWORD slotCount = LEDGER_MIN_SLOTS;
+        while (slotCount < header()->count * 2) {
+            slotCount *= 2;
+        }
+
+        // whatever is mapped is no index at all
+        if (!rebuildIndex(slotCount)) {
+            index.close();
+            return false;
+        }
+        return true;
+    }
+
+    // a rebuild on the way covers everything, so go by what the index says it holds,
+    // what can't be indexed is left to the tail scan
+    while (index.isOpen() && indexHeader()->indexed < header()->count && insertIndex(indexHeader()->indexed)) {
+    }
+
+    return index.isOpen();
+}
+
+/* Writes a fresh index of slotCount slots next to the old one and swaps it in. */
+bool KeyLedger::rebuildIndex(QWORD slotCount) {
+    std::string indexName = filename + ".idx";
+    std::string tempName = indexName + ".tmp";
+
+    std::remove(tempName.c_str());
+
+    {
+        MappedFile rebuilt;
+        if (!rebuilt.open(tempName, LEDGER_HEADER_SIZE + slotCount * sizeof(QWORD))) {
+            return false;
+        }
+
+        LedgerIndexHeader *h = (LedgerIndexHeader *)rebuilt.get();
+        QWORD *table = (QWORD *)(rebuilt.get() + LEDGER_HEADER_SIZE);
+        QWORD count = header()->count;
+
+        for (QWORD i = 0; i < count; i++) {
+            placeSlot(table, slotCount, hash(record(i)->binkid, record(i)->payload), i);
+        }
+
+        h->slots = slotCount;
+        h->used = count;
+        h->indexed = count;
+        h->version = LEDGER_VERSION;
+        memcpy(h->magic, LEDGER_INDEX_MAGIC, LEDGER_MAGIC_LENGTH);
+
+        rebuilt.sync();
+    }
+
+    // the old index stays mapped until the new one is in place, readers that still have it
+    // mapped keep a consistent (if stale) view of it
+    if (std::rename(tempName.c_str(), indexName.c_str()) != 0) {
+        std::remove(tempName.c_str());
+        return false;
+    }
+
+    MappedFile fresh;
+    if (!fresh.open(indexName, 0)) {
+        return false;
+    }
+
+    index.swap(fresh);
+    return true;
+}
+
+/* Indexes record i, a record that can't be is still found by the tail scan in find(). */
+bool KeyLedger::insertIndex(QWORD i) {
+    if (!index.isOpen()) {
+        return false;
+    }
+
+    LedgerIndexHeader *h = indexHeader();
+
+    // keep the load at or below one half, probes stay short and misses end quickly.
+    // a rebuild that failed leaves the records past indexed to the tail scan, it is only retried now and then
+    if ((h->used + 1) * 2 > h->slots) {
+        return (i - h->indexed) % LEDGER_TAIL_LIMIT == 0 && rebuildIndex(h->slots * 2);
+    }
+
+    placeSlot(slots(), h->slots, hash(record(i)->binkid, record(i)->payload), i);
+    h->used++;
+    __atomic_store_n(&h->indexed, i + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+/* Readers pick up records and index rebuilds of the writer. */
+bool KeyLedger::refresh() {
+    QWORD count = __atomic_load_n(&header()->count, __ATOMIC_ACQUIRE);
+
+    if (count > capacity) {
+        if (!records.open(filename, 0, true)) {
+            return false;
+        }
+        capacity = (records.size() - LEDGER_HEADER_SIZE) / LEDGER_RECORD_SIZE;
+    }
+
+    QWORD indexed = index.isOpen() ? __atomic_load_n(&indexHeader()->indexed, __ATOMIC_ACQUIRE) : 0;
+    if (count - std::min(count, indexed) > LEDGER_TAIL_LIMIT) {
+        openIndex();
+    }
+
+    return true;
+}
+
+bool KeyLedger::find(BYTE binkid, const BYTE *payload, QWORD *found) {
+    QWORD count = std::min(__atomic_load_n(&header()->count, __ATOMIC_ACQUIRE), capacity);
+    QWORD tail = 0;
+
+    if (index.isOpen()) {
+        LedgerIndexHeader *h = indexHeader();
+        QWORD h64 = hash(binkid, payload), mask = h->slots - 1;
+        QWORD *table = slots();
+
+        for (QWORD s = h64 & mask;; s = (s + 1) & mask) {
+            QWORD entry = __atomic_load_n(&table[s], __ATOMIC_ACQUIRE);
+            if (entry == 0) {
+                break;
+            }
+
+            QWORD i = (entry & LEDGER_INDEX_MASK) - 1;
+            if (entry >> LEDGER_INDEX_BITS == h64 >> LEDGER_INDEX_BITS && i < count && matches(i, binkid, payload)) {
+                *found = i;
+                return true;
+            }
+        }
+
+        tail = std::min(__atomic_load_n(&h->indexed, __ATOMIC_ACQUIRE), count);
+    }
+
+    for (QWORD i = tail; i < count; i++) {
+        if (matches(i, binkid, payload)) {
+            *found = i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/* Records a newly issued key, returns false if it is already in the ledger (or can't be written). */
+bool KeyLedger::append(BYTE binkid, const QWORD (&pRaw)[2], DWORD serial, DWORD channelID, BOOL upgrade) {
+    if (readOnly) {
+        return false;
+    }
+
+    LedgerRecord entry{};
+    KeyFile::encodeRecord(entry.payload, pRaw);
+    entry.serial = serial;
+    entry.channelID = (WORD)channelID;
+    entry.binkid = binkid;
+    entry.flags = upgrade ? LEDGER_FLAG_UPGRADE : 0;
+    entry.timestamp = (QWORD)std::time(nullptr);
+
+#if UMSKT_THREADS
+    std::lock_guard<std::mutex> guard(lock);
+#endif
+    QWORD existing;
+    if (find(binkid, entry.payload, &existing)) {
+        return false;
+    }
+
+    QWORD n = header()->count;
+
+    if (n == capacity) {
+        if (!records.resize(LEDGER_HEADER_SIZE + capacity * 2 * LEDGER_RECORD_SIZE)) {
+            return false;
+        }
+        capacity *= 2;
+    }
+
+    memcpy(record(n), &entry, sizeof(entry));
+
+    // publish the record only once it is complete, readers never look past count
+    __atomic_store_n(&header()->count, n + 1, __ATOMIC_RELEASE);
+
+    insertIndex(n);
+    return true;
+}
+
+bool KeyLedger::lookup(BYTE binkid, const QWORD (&pRaw)[2], LedgerRecord *out) {
+    BYTE payload[16];
+    KeyFile::encodeRecord(payload, pRaw);
+
+#if UMSKT_THREADS
+    std::lock_guard<std::mutex> guard(lock);
+#endif
+    if (readOnly && !refresh()) {
+        return false;
+    }
+
+    QWORD i;
+    if (!find(binkid, payload, &i)) {
+        return false;
+    }
+
+    if (out != nullptr) {
+        memcpy(out, record(i), sizeof(*out));
+    }
+    return true;
+}
+
+bool KeyLedger::contains(BYTE binkid, const QWORD (&pRaw)[2]) {
+    return lookup(binkid, pRaw, nullptr);
+}
+
+QWORD KeyLedger::size() {
+#if UMSKT_THREADS
+    std::lock_guard<std::mutex> guard(lock);
+#endif
+    return std::min(__atomic_load_n(&header()->count, __ATOMIC_ACQUIRE), capacity);
+}
+
+void KeyLedger::sync() {
+    records.sync();
+    index.sync();
+}
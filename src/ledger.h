@@ -0,0 +1,144 @@
+/**
+ * This file is a part of the UMSKT Project
+ *
+ * Copyleft (C) 2019-2023 UMSKT Contributors (et.al.)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @FileCreated by Neo on 10/18/2026
+ * @Maintainer Neo
+ */
+
+
+#ifndef UMSKT_LEDGER_H
+#define UMSKT_LEDGER_H
+
+#include "header.h"
+#include "mappedfile.h"
+
+#include "libumskt/libumskt.h"
+
+#if UMSKT_THREADS
+#include <mutex>
+#endif
+
+#define LEDGER_MAGIC            "UMSKTLDG"
+#define LEDGER_INDEX_MAGIC      "UMSKTIDX"
+#define LEDGER_MAGIC_LENGTH     8
+#define LEDGER_VERSION          1
+#define LEDGER_HEADER_SIZE      64
+#define LEDGER_RECORD_SIZE      32
+#define LEDGER_MIN_RECORDS      4096
+#define LEDGER_MIN_SLOTS        8192
+#define LEDGER_TAIL_LIMIT       4096    // unindexed records a reader scans before reopening the index
+
+#define LEDGER_FLAG_UPGRADE     0x01
+
+/*
+ * One issued key: the packed payload in the key file record layout (see keyfile.h)
+ * followed by what we knew about it when it was issued.
+ */
+struct LedgerRecord {
+    BYTE payload[16];
+    DWORD serial;
+    WORD channelID;
+    BYTE binkid;
+    BYTE flags;
+    QWORD timestamp;    // seconds since the epoch
+};
+
+struct LedgerHeader {
+    char magic[LEDGER_MAGIC_LENGTH];
+    DWORD version;
+    DWORD recordSize;
+    QWORD count;        // records that are complete, published last
+    BYTE reserved[40];
+};
+
+struct LedgerIndexHeader {
+    char magic[LEDGER_MAGIC_LENGTH];
+    DWORD version;
+    DWORD reserved0;
+    QWORD slots;
+    QWORD used;
+    QWORD indexed;      // ledger records covered by the index
+    BYTE reserved[24];
+};
+
+static_assert(sizeof(LedgerRecord) == LEDGER_RECORD_SIZE, "ledger record layout");
+static_assert(sizeof(LedgerHeader) == LEDGER_HEADER_SIZE, "ledger header layout");
+static_assert(sizeof(LedgerIndexHeader) == LEDGER_HEADER_SIZE, "ledger index header layout");
+
+/*
+ * Append-only record of every key ever issued.
+ *
+ * FILE holds the records, FILE.idx an open addressing hash table over (BINK, payload)
+ * whose slots are 8 bytes: a 24-bit fingerprint and the record number plus one. Both
+ * are memory mapped, so contains() and lookup() are a hash probe or two.
+ *
+ * There is a single writer per ledger, enforced with an exclusive lock on FILE that is
+ * held for as long as the writer has it open (index rebuilds included). Any number of processes may open it read-only
+ * at the same time: the record count is published only after the record itself, and
+ * records the index has not caught up with yet are found by scanning the short tail.
+ * A writer that was interrupted catches its index up the next time it opens the ledger.
+ * Files are in host byte order, except the payload.
+ */
+class KeyLedger {
+    std::string filename;
+    bool readOnly;
+
+    MappedFile records;
+    MappedFile index;
+    QWORD capacity;
+    int lockFd;
+
+#if UMSKT_THREADS
+    std::mutex lock;
+#endif
+
+    KeyLedger(const std::string &filename, bool readOnly);
+
+    LedgerHeader *header() const { return (LedgerHeader *)records.get(); }
+    LedgerIndexHeader *indexHeader() const { return (LedgerIndexHeader *)index.get(); }
+    LedgerRecord *record(QWORD i) const { return (LedgerRecord *)(records.get() + LEDGER_HEADER_SIZE) + i; }
+    QWORD *slots() const { return (QWORD *)(index.get() + LEDGER_HEADER_SIZE); }
+
+    bool lockWriter(bool *inUse);
+
+    static QWORD hash(BYTE binkid, const BYTE *payload);
+    bool matches(QWORD i, BYTE binkid, const BYTE *payload) const;
+
+    bool openIndex();
+    bool rebuildIndex(QWORD slotCount);
+    bool insertIndex(QWORD i);
+    bool refresh();
+    bool find(BYTE binkid, const BYTE *payload, QWORD *found);
+
+public:
+    ~KeyLedger();
+
+    KeyLedger(const KeyLedger &) = delete;
+    KeyLedger &operator=(const KeyLedger &) = delete;
+
+    // inUse (if given) is set when a writer fails because another writer holds the ledger
+    static KeyLedger *open(const std::string &filename, bool readOnly, bool *inUse = nullptr);
+
+    bool append(BYTE binkid, const QWORD (&pRaw)[2], DWORD serial, DWORD channelID, BOOL upgrade);
+    bool contains(BYTE binkid, const QWORD (&pRaw)[2]);
+    bool lookup(BYTE binkid, const QWORD (&pRaw)[2], LedgerRecord *out);
+    QWORD size();
+    void sync();
+};
+
+#endif //UMSKT_LEDGER_H
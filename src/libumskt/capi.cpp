@@ -0,0 +1,252 @@
+/**
+ * This file is a part of the UMSKT Project
+ *
+ * Copyleft (C) 2019-2023 UMSKT Contributors (et.al.)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @FileCreated by Neo on 10/18/2026
+ * @Maintainer Neo
+ */
+
+
+#include "capi.h"
+
+#include "libumskt.h"
+#include "confid/confid.h"
+#include "pidgen3/PIDGEN3.h"
+#include "pidgen3/BINK1998.h"
+#include "pidgen3/BINK2002.h"
+#include "pidgen3/CurveRegistry.h"
+
+#include <new>
+
+// attempts at a key before umskt_generate_n gives up, a bad one is rare to begin with
+#define CAPI_GENERATE_ATTEMPTS  64
+
+struct umskt_bink {
+    const PIDGEN3::BINKCurve *curve;
+    bool bink2002;
+};
+
+/* Copies the key at in (stride bytes at most) into out without dashes, false unless that leaves 25 valid characters. */
+static bool readKey(const char *in, size_t stride, char (&out)[PK_LENGTH]) {
+    size_t length = 0;
+
+    for (size_t i = 0; i < stride && in[i]; i++) {
+        char c = (char)toupper((unsigned char)in[i]);
+
+        if (c == '-') {
+            continue;
+        }
+
+        if (length == PK_LENGTH || memchr(PIDGEN3::pKeyCharset, c, sizeof(PIDGEN3::pKeyCharset) - 1) == nullptr) {
+            return false;
+        }
+        out[length++] = c;
+    }
+
+    return length == PK_LENGTH;
+}
+
+int umskt_abi_version(void) {
+    return UMSKT_ABI_VERSION;
+}
+
+const char *umskt_strerror(int status) {
+    switch (status) {
+        case UMSKT_OK:                          return "success";
+        case UMSKT_ERR_INVALID_ARGUMENT:        return "invalid argument";
+        case UMSKT_ERR_UNKNOWN_BINK:            return "unknown BINK";
+        case UMSKT_ERR_UNSUPPORTED_BINK:        return "unsupported BINK";
+        case UMSKT_ERR_GENERATE_FAILED:         return "unable to generate a valid key";
+        case UMSKT_ERR_OUT_OF_MEMORY:           return "out of memory";
+        case UMSKT_CONFID_TOO_SHORT:            return "installation ID is too short";
+        case UMSKT_CONFID_TOO_LARGE:            return "installation ID is too long";
+        case UMSKT_CONFID_INVALID_CHARACTER:    return "invalid character in installation ID";
+        case UMSKT_CONFID_INVALID_CHECK_DIGIT:  return "installation ID checksum failed";
+        case UMSKT_CONFID_UNKNOWN_VERSION:      return "unknown installation ID version";
+        case UMSKT_CONFID_UNLUCKY:              return "unable to generate a valid confirmation ID";
+        case UMSKT_CONFID_INVALID_PRODUCT_ID:   return "invalid product ID";
+    }
+
+    return "unknown error";
+}
+
+/* Makes a BINK known to umskt_bink_open, registering the same ID again keeps the first. */
+int umskt_bink_register(const char *binkid, const umskt_bink_params *params) {
+    if (binkid == nullptr || params == nullptr) {
+        return UMSKT_ERR_INVALID_ARGUMENT;
+    }
+
+    const char *fields[] = { params->p, params->a, params->b, params->gx, params->gy, params->kx, params->ky, params->n, params->priv };
+    for (const char *field : fields) {
+        if (field == nullptr) {
+            return UMSKT_ERR_INVALID_ARGUMENT;
+        }
+    }
+
+    PIDGEN3::CurveRegistry::add(binkid, PIDGEN3::BINKParams {
+            params->p, params->a, params->b,
+            params->gx, params->gy,
+            params->kx, params->ky,
+            params->n, params->priv
+    });
+
+    return UMSKT_OK;
+}
+
+/* Sets up a registered BINK, the curve and its tables are shared by every handle of that BINK. */
+int umskt_bink_open(const char *binkid, umskt_bink_handle **handle) {
+    if (binkid == nullptr || handle == nullptr) {
+        return UMSKT_ERR_INVALID_ARGUMENT;
+    }
+
+    unsigned int id;
+    if (sscanf(binkid, "%x", &id) != 1) {
+        return UMSKT_ERR_INVALID_ARGUMENT;
+    }
+
+    // FE and FF are BINK 1998, but do not generate valid keys
+    if (id >= 0xFE) {
+        return UMSKT_ERR_UNSUPPORTED_BINK;
+    }
+
+    const PIDGEN3::BINKCurve *curve = PIDGEN3::CurveRegistry::get(binkid);
+    if (curve == nullptr) {
+        return UMSKT_ERR_UNKNOWN_BINK;
+    }
+
+    *handle = new (std::nothrow) umskt_bink { curve, id >= 0x40 };
+    return *handle == nullptr ? UMSKT_ERR_OUT_OF_MEMORY : UMSKT_OK;
+}
+
+void umskt_bink_close(umskt_bink_handle *handle) {
+    delete handle;
+}
+
+int umskt_generate_n(const umskt_bink_handle *bink, const umskt_generate_params *params, size_t count, char *keys) {
+    if (bink == nullptr || params == nullptr || (keys == nullptr && count != 0)) {
+        return UMSKT_ERR_INVALID_ARGUMENT;
+    }
+
+    if (params->channel_id > 999 || params->serial_min > params->serial_max || params->serial_max > 999999) {
+        return UMSKT_ERR_INVALID_ARGUMENT;
+    }
+
+    const PIDGEN3::BINKCurve &curve = *bink->curve;
+    const DWORD range = params->serial_max - params->serial_min + 1;
+
+    for (size_t i = 0; i < count; i++) {
+        QWORD pRaw[2];
+        bool isValid = false;
+
+        for (int attempt = 0; attempt < CAPI_GENERATE_ATTEMPTS && !isValid; attempt++) {
+            if (bink->bink2002) {
+                DWORD pAuthInfo, pSerial;
+                UMSKT::umskt_rand_bytes((BYTE *)&pAuthInfo, sizeof(pAuthInfo));
+
+                isValid = PIDGEN3::BINK2002::Generate(curve, params->channel_id, pAuthInfo & BITMASK(10), params->upgrade != 0, params->serial_min, params->serial_max, &pSerial, pRaw)
+                       && PIDGEN3::BINK2002::Verify(curve, nullptr, pRaw);
+            } else {
+                DWORD serial;
+                UMSKT::umskt_rand_bytes((BYTE *)&serial, sizeof(serial));
+
+                PIDGEN3::BINK1998::Generate(curve, params->channel_id * 1'000'000 + params->serial_min + serial % range, params->upgrade != 0, pRaw);
+                isValid = PIDGEN3::BINK1998::Verify(curve, pRaw);
+            }
+        }
+
+        if (!isValid) {
+            return UMSKT_ERR_GENERATE_FAILED;
+        }
+
+        char key[PK_LENGTH + NULL_TERMINATOR];
+        PIDGEN3::base24(key, (BYTE *)pRaw);
+        memcpy(keys + i * UMSKT_KEY_LENGTH, key, UMSKT_KEY_LENGTH);
+    }
+
+    return UMSKT_OK;
+}
+
+int umskt_verify_n(const umskt_bink_handle *bink, const char *keys, size_t stride, size_t count, uint8_t *valid, uint32_t *serials) {
+    if (bink == nullptr || stride < UMSKT_KEY_LENGTH || (count != 0 && (keys == nullptr || valid == nullptr))) {
+        return UMSKT_ERR_INVALID_ARGUMENT;
+    }
+
+    const PIDGEN3::BINKCurve &curve = *bink->curve;
+
+    for (size_t i = 0; i < count; i++) {
+        char key[PK_LENGTH];
+        QWORD pRaw[2];
+        DWORD serial = 0;
+        bool isValid = false;
+
+        if (readKey(keys + i * stride, stride, key)) {
+            PIDGEN3::unbase24((BYTE *)pRaw, key);
+
+            if (bink->bink2002) {
+                isValid = PIDGEN3::BINK2002::Verify(curve, &serial, pRaw);
+            } else if ((isValid = PIDGEN3::BINK1998::Verify(curve, pRaw))) {
+                BOOL pUpgrade;
+                DWORD nRaw, pHash;
+                QWORD pSignature;
+
+                PIDGEN3::BINK1998::Unpack(pRaw, pUpgrade, nRaw, pHash, pSignature);
+                serial = nRaw % 1'000'000;
+            }
+        }
+
+        valid[i] = isValid;
+        if (serials != nullptr) {
+            serials[i] = isValid ? serial : 0;
+        }
+    }
+
+    return UMSKT_OK;
+}
+
+int umskt_confid_n(const char *iids, size_t stride, size_t count, int mode, const char *product_id, int override_version, char *cids, int *statuses) {
+    if (count != 0 && (iids == nullptr || stride == 0 || cids == nullptr || statuses == nullptr)) {
+        return UMSKT_ERR_INVALID_ARGUMENT;
+    }
+
+    if (mode < UMSKT_MODE_WINDOWS || mode > UMSKT_MODE_OFFICE_ACC) {
+        return UMSKT_ERR_INVALID_ARGUMENT;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        const char *record = iids + i * stride;
+        char *cid = cids + i * UMSKT_CID_SIZE;
+        char iid[UMSKT_IID_MAX + NULL_TERMINATOR];
+
+        size_t length = 0;
+        while (length < stride && length <= UMSKT_IID_MAX && record[length]) {
+            length++;
+        }
+
+        cid[0] = 0;
+        if (length > UMSKT_IID_MAX) {
+            statuses[i] = UMSKT_CONFID_TOO_LARGE;
+            continue;
+        }
+
+        memcpy(iid, record, length);
+        iid[length] = 0;
+
+        statuses[i] = ConfirmationID::Generate(iid, cid, mode, product_id ? product_id : "", override_version != 0);
+    }
+
+    return UMSKT_OK;
+}
@@ -0,0 +1,132 @@
+/**
+ * This file is a part of the UMSKT Project
+ *
+ * Copyleft (C) 2019-2023 UMSKT Contributors (et.al.)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @FileCreated by Neo on 10/18/2026
+ * @Maintainer Neo
+ */
+
+
+#ifndef UMSKT_CAPI_H
+#define UMSKT_CAPI_H
+
+/*
+ * Stable C interface of libumskt for FFI consumers.
+ *
+ * Everything here is plain C: opaque handles, fixed size records in caller provided
+ * buffers and int status codes, no C++ types cross this boundary. A BINK handle is
+ * set up once and is immutable afterwards, any number of threads can share one. The
+ * batch functions don't allocate anything per call on their own.
+ *
+ * Bump UMSKT_ABI_VERSION whenever a signature or struct below changes.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_MSC_VER)
+#define UMSKT_API __declspec(dllexport)
+#elif defined(__EMSCRIPTEN__)
+#include <emscripten/emscripten.h>
+#define UMSKT_API EMSCRIPTEN_KEEPALIVE
+#else
+#define UMSKT_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define UMSKT_ABI_VERSION       1
+#define UMSKT_KEY_LENGTH        25      // product keys are written without dashes or terminator
+#define UMSKT_CID_SIZE          49      // 48 characters with dashes and a terminating NUL
+#define UMSKT_IID_MAX           127     // longest installation ID accepted, dashes included
+
+enum umskt_status {
+    UMSKT_OK                    = 0,
+    UMSKT_ERR_INVALID_ARGUMENT  = -1,
+    UMSKT_ERR_UNKNOWN_BINK      = -2,   // never registered with umskt_bink_register
+    UMSKT_ERR_UNSUPPORTED_BINK  = -3,   // Terminal Services BINKs FE and FF
+    UMSKT_ERR_GENERATE_FAILED   = -4,
+    UMSKT_ERR_OUT_OF_MEMORY     = -5,
+
+    // per installation ID results of umskt_confid_n
+    UMSKT_CONFID_TOO_SHORT          = 1,
+    UMSKT_CONFID_TOO_LARGE          = 2,
+    UMSKT_CONFID_INVALID_CHARACTER  = 3,
+    UMSKT_CONFID_INVALID_CHECK_DIGIT = 4,
+    UMSKT_CONFID_UNKNOWN_VERSION    = 5,
+    UMSKT_CONFID_UNLUCKY            = 6,
+    UMSKT_CONFID_INVALID_PRODUCT_ID = 10,
+};
+
+enum umskt_confid_mode {
+    UMSKT_MODE_WINDOWS      = 0,
+    UMSKT_MODE_OFFICE_XP    = 1,
+    UMSKT_MODE_OFFICE_2K3   = 2,
+    UMSKT_MODE_OFFICE_2K7   = 3,
+    UMSKT_MODE_PLUS_DME     = 4,
+    UMSKT_MODE_OFFICE_ACC   = 5,
+};
+
+typedef struct umskt_bink umskt_bink_handle;
+
+/* Decimal curve parameters of a BINK, as found in keys.json. */
+typedef struct umskt_bink_params {
+    const char *p, *a, *b;
+    const char *gx, *gy;
+    const char *kx, *ky;
+    const char *n, *priv;
+} umskt_bink_params;
+
+/* What goes into generated keys, serials are drawn at random from [serial_min, serial_max]. */
+typedef struct umskt_generate_params {
+    uint32_t channel_id;
+    uint32_t serial_min;
+    uint32_t serial_max;
+    uint32_t upgrade;
+} umskt_generate_params;
+
+UMSKT_API int umskt_abi_version(void);
+UMSKT_API const char *umskt_strerror(int status);
+
+UMSKT_API int umskt_bink_register(const char *binkid, const umskt_bink_params *params);
+UMSKT_API int umskt_bink_open(const char *binkid, umskt_bink_handle **handle);
+UMSKT_API void umskt_bink_close(umskt_bink_handle *handle);
+
+/* Writes count keys of UMSKT_KEY_LENGTH characters each back to back into keys. */
+UMSKT_API int umskt_generate_n(const umskt_bink_handle *bink, const umskt_generate_params *params, size_t count, char *keys);
+
+/*
+ * Checks count keys, one every stride bytes, with or without dashes. valid[i] is set
+ * to 1 or 0, serials (optional) receives the serial of every valid key.
+ */
+UMSKT_API int umskt_verify_n(const umskt_bink_handle *bink, const char *keys, size_t stride, size_t count, uint8_t *valid, uint32_t *serials);
+
+/*
+ * Confirmation IDs for count installation IDs, one every stride bytes and each ending
+ * at a NUL or at the end of its record. cids receives UMSKT_CID_SIZE bytes per ID,
+ * statuses the UMSKT_OK or UMSKT_CONFID_ result of each. product_id is only needed
+ * for Office 2003 and 2007 and may be NULL otherwise.
+ */
+UMSKT_API int umskt_confid_n(const char *iids, size_t stride, size_t count, int mode, const char *product_id, int override_version, char *cids, int *statuses);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //UMSKT_CAPI_H
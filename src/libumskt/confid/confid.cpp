@@ -28,16 +28,30 @@
  */
 
 #include "confid.h"
+#include "../stats.h"
 
 #if defined(_MSC_VER)
 #include <intrin.h>
 #endif
 
-QWORD MOD = 0;
-QWORD NON_RESIDUE = 0;
-QWORD f[6] = { 0x0, 0x0, 0x0, 0x0, 0x0, 0x0 };
-int productID[4];
-int activationMode;
+// 64-bit targets divide in hardware and the extended Euclid beats the shift-and-subtract
+// inversion there, 32-bit ones (DJGPP, Win32, ARM) call into the runtime for every 64-bit division
+#ifndef RESIDUE_INV_DIVISION
+#if defined(__x86_64__) || defined(_M_X64) || defined(__aarch64__) || defined(_M_ARM64)
+#define RESIDUE_INV_DIVISION 1
+#else
+#define RESIDUE_INV_DIVISION 0
+#endif
+#endif
+
+// Per-thread curve state, Generate sets these up for the requested mode before doing any math,
+// so confirmation IDs for different products can be computed on several threads at once.
+thread_local QWORD MOD = 0;
+thread_local QWORD NON_RESIDUE = 0;
+thread_local const TResidueField *residueField = nullptr;
+thread_local QWORD f[6] = { 0x0, 0x0, 0x0, 0x0, 0x0, 0x0 };
+thread_local int productID[4];
+thread_local int activationMode;
 
 int ConfirmationID::calculateCheckDigit(int pid)
 {
@@ -213,6 +227,74 @@ QWORD ConfirmationID::residue_pow(QWORD x, QWORD y)
 	return res;
 }
 
+/* Works out the sliding window schedule of a fixed exponent, see TResidueChain. */
+void ConfirmationID::residue_chain(QWORD exponent, TResidueChain* chain)
+{
+	chain->length = 0;
+
+	int i = 63;
+	while (i > 0 && !(exponent >> i & 1)) {
+		i--;
+	}
+
+	int squarings = 0;
+	while (i >= 0) {
+		if (!(exponent >> i & 1)) {
+			squarings++;
+			i--;
+			continue;
+		}
+
+		// the longest window starting at bit i that ends in a set bit
+		int low = i - RESIDUE_CHAIN_WINDOW + 1 < 0 ? 0 : i - RESIDUE_CHAIN_WINDOW + 1;
+		while (!(exponent >> low & 1)) {
+			low++;
+		}
+
+		chain->squarings[chain->length] = squarings + i - low + 1;
+		chain->digits[chain->length] = (exponent >> low) & ((1 << (i - low + 1)) - 1);
+		chain->length++;
+
+		squarings = 0;
+		i = low - 1;
+	}
+
+	if (squarings) {
+		chain->squarings[chain->length] = squarings;
+		chain->digits[chain->length] = 0;
+		chain->length++;
+	}
+}
+
+/* x^e for the exponent the chain was made for, about a fifth fewer multiplications than residue_pow. */
+QWORD ConfirmationID::residue_pow_chain(QWORD x, const TResidueChain* chain)
+{
+	// odd[k] = x^(2k + 1)
+	QWORD odd[1 << (RESIDUE_CHAIN_WINDOW - 1)];
+	QWORD x2 = residue_mul(x, x);
+
+	odd[0] = x;
+	for (int k = 1; k < (1 << (RESIDUE_CHAIN_WINDOW - 1)); k++) {
+		odd[k] = residue_mul(odd[k - 1], x2);
+	}
+
+	if (chain->length == 0) {
+		return 1;
+	}
+
+	QWORD res = odd[chain->digits[0] >> 1];
+	for (int i = 1; i < chain->length; i++) {
+		for (int j = 0; j < chain->squarings[i]; j++) {
+			res = residue_mul(res, res);
+		}
+		if (chain->digits[i]) {
+			res = residue_mul(res, odd[chain->digits[i] >> 1]);
+		}
+	}
+
+	return res;
+}
+
 QWORD ConfirmationID::inverse(QWORD u, QWORD v)
 {
 	//assert(u);
@@ -228,58 +310,175 @@ QWORD ConfirmationID::inverse(QWORD u, QWORD v)
 	return xu;
 }
 
-QWORD ConfirmationID::residue_inv(QWORD x)
+static inline int trailing_zeros(QWORD x)
 {
-    return inverse(x, MOD);
-    // return residue_pow(x, MOD - 2);
+#if defined(_MSC_VER)
+	unsigned long index;
+	if (_BitScanForward(&index, (unsigned long)x)) {
+		return (int)index;
+	}
+	_BitScanForward(&index, (unsigned long)(x >> 32));
+	return (int)index + 32;
+#else
+	return __builtin_ctzll(x);
+#endif
 }
 
-#define BAD 0xFFFFFFFFFFFFFFFFull
-
-QWORD ConfirmationID::residue_sqrt(QWORD what)
+/*
+ * 1/x, see RESIDUE_INV_DIVISION for which way.
+ *
+ * The division free way is Kaliski's almost inverse: it keeps MOD = u * s + v * r while
+ * u and v shrink by subtracting and shifting out trailing zeros, which leaves
+ * r = -x^-1 * 2^k. The 2^k comes off with one multiplication by a precomputed 2^-k,
+ * k never gets past 2 * 57.
+ */
+QWORD ConfirmationID::residue_inv(QWORD x)
 {
-	if (!what) {
-        return 0;
-    }
+#if RESIDUE_INV_DIVISION
+	return inverse(x, MOD);
+#else
+	// same as what inverse() comes out with
+	if (!x) {
+		return 1;
+	}
+
+	QWORD u = MOD, v = x, r = 0, s = 1;
+	int k = trailing_zeros(v);
+	v >>= k;
+
+	// Which of u and v shrinks is a coin flip, so both sides are computed and picked without branching.
+	for (;;) {
+		bool larger = u > v;
+		QWORD d = larger ? u - v : v - u;
+		QWORD sum = r + s;
+
+		// u = v is only reached at the very end, with u = v = 1
+		if (!d) {
+			r <<= 1;
+			k++;
+			break;
+		}
+
+		int z = trailing_zeros(d);
+		d >>= z;
+		k += z;
 
-	QWORD g = NON_RESIDUE, z, y, r, x, b, t;
-	QWORD e = 0, q = MOD - 1;
+		u = larger ? d : u;
+		v = larger ? v : d;
+		r = larger ? sum : r << z;
+		s = larger ? s << z : sum;
+	}
+
+	if (r >= MOD) {
+		r -= MOD;
+	}
+
+	return residue_mul(MOD - r, residueField->inversePowers[k]);
+#endif
+}
+
+/* Works out the Tonelli-Shanks constants of the curve currently in MOD and NON_RESIDUE. */
+void ConfirmationID::residue_setup(TResidueField* field)
+{
+	QWORD q = MOD - 1;
 
+	field->twoAdicity = 0;
 	while (!(q & 1)) {
-        e++, q >>= 1;
-    }
+		field->twoAdicity++, q >>= 1;
+	}
 
-	z = residue_pow(g, q);
-	y = z;
-	r = e;
-	x = residue_pow(what, (q - 1) / 2);
-	b = residue_mul(residue_mul(what, x), x);
-	x = residue_mul(what, x);
-	while (b != 1) {
-		QWORD m = 0, b2 = b;
-
-        do {
-			m++;
-			b2 = residue_mul(b2, b2);
-		} while (b2 != 1);
-
-        if (m == r) {
-            return BAD;
-        }
+	assert(field->twoAdicity <= RESIDUE_MAX_TWO_ADICITY);
 
-		t = residue_pow(y, 1 << (r - m - 1));
-		y = residue_mul(t, t);
-		r = m;
-		x = residue_mul(x, t);
-		b = residue_mul(b, y);
+	// 2^-k for residue_inv, 1/2 = (MOD + 1) / 2
+	field->inversePowers[0] = 1;
+	for (int k = 1; k < RESIDUE_INV_SHIFTS; k++) {
+		field->inversePowers[k] = residue_mul(field->inversePowers[k - 1], (MOD + 1) / 2);
 	}
 
-	if (residue_mul(x, x) != what) {
-		//printf("internal error in sqrt\n");
-		return BAD;
+	residue_chain((q - 1) / 2, &field->sqrtChain);
+
+	QWORD z = residue_pow(NON_RESIDUE, q);
+	QWORD zz = residue_mul(z, z);
+
+	for (int j = 0; j < 1 << (field->twoAdicity - 1); j++) {
+		field->roots[j] = j ? residue_mul(field->roots[j - 1], zz) : 1;
+
+		// Both roots would do, but the one the Tonelli-Shanks loop lands on is what decides the
+		// confirmation ID, so replay the loop once for this b and keep the factor it applies to x.
+		QWORD b = field->roots[j], y = z, fix = 1;
+		int r = field->twoAdicity;
+
+		while (b != 1) {
+			int m = 0;
+			QWORD b2 = b;
+
+			do {
+				m++;
+				b2 = residue_mul(b2, b2);
+			} while (b2 != 1);
+
+			QWORD t = residue_pow(y, 1 << (r - m - 1));
+			y = residue_mul(t, t);
+			r = m;
+			fix = residue_mul(fix, t);
+			b = residue_mul(b, y);
+		}
+
+		field->fixes[j] = fix;
 	}
 
-	return x;
+	// residue_inv needs the finished table of whichever curve is current, Fermat doesn't
+	field->nonResidueInv = residue_pow(NON_RESIDUE, MOD - 2);
+}
+
+/* The constants for the curve of an activation mode, set up once by whoever asks first (MOD has to be set already). */
+const TResidueField* ConfirmationID::residue_field(int mode)
+{
+	switch (mode) {
+		case 0: {
+			static const TResidueField windows = [] { TResidueField field; residue_setup(&field); return field; }();
+			return &windows;
+		}
+		case 1:
+		case 2:
+		case 3: {
+			static const TResidueField office = [] { TResidueField field; residue_setup(&field); return field; }();
+			return &office;
+		}
+		default: {
+			static const TResidueField plus = [] { TResidueField field; residue_setup(&field); return field; }();
+			return &plus;
+		}
+	}
+}
+
+#define BAD 0xFFFFFFFFFFFFFFFFull
+
+/*
+ * Tonelli-Shanks with everything but the input precomputed.
+ *
+ * With t = what^((q - 1) / 2), x = what * t and b = x * t = what^q, x^2 = what * b.
+ * b lies in the subgroup of order 2^twoAdicity generated by z, for a square it is
+ * z^(2j) for some j, and x times a root of z^-(2j) is the root. Which of the two
+ * roots the loop would have picked only depends on j, so that is a table lookup.
+ */
+QWORD ConfirmationID::residue_sqrt(QWORD what)
+{
+	if (!what) {
+		return 0;
+	}
+
+	QWORD t = residue_pow_chain(what, &residueField->sqrtChain);
+	QWORD x = residue_mul(what, t);
+	QWORD b = residue_mul(x, t);
+
+	for (int j = 0; j < 1 << (residueField->twoAdicity - 1); j++) {
+		if (b == residueField->roots[j]) {
+			return residue_mul(x, residueField->fixes[j]);
+		}
+	}
+
+	return BAD;
 }
 
 int ConfirmationID::find_divisor_v(TDivisor* d)
@@ -748,6 +947,133 @@ void ConfirmationID::Mix(unsigned char* buffer, size_t bufSize, const unsigned c
 	}
 }
 
+#if defined(__GNUC__)
+// one SHA-1 state word per lane, GCC and Clang map these onto whatever SIMD the target has
+typedef unsigned sha1_lane_t __attribute__((vector_size(4 * CONFID_LANES)));
+
+static inline sha1_lane_t rol_lanes(sha1_lane_t x, int shift)
+{
+	return (x << shift) | (x >> (32 - shift));
+}
+#endif
+
+/* sha1_single_block on CONFID_LANES independent blocks at once. */
+void ConfirmationID::sha1_lanes(unsigned char input[CONFID_LANES][64], unsigned char output[CONFID_LANES][20])
+{
+#if defined(__GNUC__)
+	sha1_lane_t a, b, c, d, e, w[80];
+	size_t i;
+	int lane;
+	for (lane = 0; lane < CONFID_LANES; lane++) {
+		a[lane] = 0x67452301;
+		b[lane] = 0xEFCDAB89;
+		c[lane] = 0x98BADCFE;
+		d[lane] = 0x10325476;
+		e[lane] = 0xC3D2E1F0;
+		for (i = 0; i < 16; i++)
+			w[i][lane] = input[lane][4*i] << 24 | input[lane][4*i+1] << 16 | input[lane][4*i+2] << 8 | input[lane][4*i+3];
+	}
+	for (i = 16; i < 80; i++)
+		w[i] = rol_lanes(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+	for (i = 0; i < 20; i++) {
+		sha1_lane_t tmp = rol_lanes(a, 5) + ((b & c) | (~b & d)) + e + w[i] + 0x5A827999;
+		e = d;
+		d = c;
+		c = rol_lanes(b, 30);
+		b = a;
+		a = tmp;
+	}
+	for (i = 20; i < 40; i++) {
+		sha1_lane_t tmp = rol_lanes(a, 5) + (b ^ c ^ d) + e + w[i] + 0x6ED9EBA1;
+		e = d;
+		d = c;
+		c = rol_lanes(b, 30);
+		b = a;
+		a = tmp;
+	}
+	for (i = 40; i < 60; i++) {
+		sha1_lane_t tmp = rol_lanes(a, 5) + ((b & c) | (b & d) | (c & d)) + e + w[i] + 0x8F1BBCDC;
+		e = d;
+		d = c;
+		c = rol_lanes(b, 30);
+		b = a;
+		a = tmp;
+	}
+	for (i = 60; i < 80; i++) {
+		sha1_lane_t tmp = rol_lanes(a, 5) + (b ^ c ^ d) + e + w[i] + 0xCA62C1D6;
+		e = d;
+		d = c;
+		c = rol_lanes(b, 30);
+		b = a;
+		a = tmp;
+	}
+	a += 0x67452301;
+	b += 0xEFCDAB89;
+	c += 0x98BADCFE;
+	d += 0x10325476;
+	e += 0xC3D2E1F0;
+	for (lane = 0; lane < CONFID_LANES; lane++) {
+		unsigned h[5] = { a[lane], b[lane], c[lane], d[lane], e[lane] };
+		for (i = 0; i < 5; i++) {
+			output[lane][4*i] = h[i] >> 24;
+			output[lane][4*i+1] = h[i] >> 16;
+			output[lane][4*i+2] = h[i] >> 8;
+			output[lane][4*i+3] = h[i];
+		}
+	}
+#else
+	for (int lane = 0; lane < CONFID_LANES; lane++)
+		sha1_single_block(input[lane], output[lane]);
+#endif
+}
+
+/* Mix on CONFID_LANES buffers at once, for trying several attempts of Generate in one go. */
+void ConfirmationID::MixLanes(unsigned char* buffers[CONFID_LANES], size_t bufSize, const unsigned char* key, size_t keySize)
+{
+	unsigned char sha1_input[CONFID_LANES][64];
+	unsigned char sha1_result[CONFID_LANES][20];
+	size_t half = bufSize / 2;
+	int external_counter, lane;
+	for (external_counter = 0; external_counter < 4; external_counter++) {
+		memset(sha1_input, 0, sizeof(sha1_input));
+		for (lane = 0; lane < CONFID_LANES; lane++) {
+			unsigned char* buffer = buffers[lane];
+			switch (activationMode) {
+				case 0:
+				case 1:
+				case 4:
+					memcpy(sha1_input[lane], buffer + half, half);
+					memcpy(sha1_input[lane] + half, key, keySize);
+					sha1_input[lane][half + keySize] = 0x80;
+					sha1_input[lane][63] = (half + keySize) * 8;
+					sha1_input[lane][62] = (half + keySize) * 8 / 0x100;
+					break;
+				case 2:
+				case 3:
+				case 5:
+					sha1_input[lane][0] = 0x79;
+					memcpy(sha1_input[lane] + 1, buffer + half, half);
+					memcpy(sha1_input[lane] + 1 + half, key, keySize);
+					sha1_input[lane][1 + half + keySize] = 0x80;
+					sha1_input[lane][63] = (1 + half + keySize) * 8;
+					sha1_input[lane][62] = (1 + half + keySize) * 8 / 0x100;
+			}
+		}
+		sha1_lanes(sha1_input, sha1_result);
+		for (lane = 0; lane < CONFID_LANES; lane++) {
+			unsigned char* buffer = buffers[lane];
+			size_t i;
+			for (i = half & ~3; i < half; i++)
+				sha1_result[lane][i] = sha1_result[lane][i + 4 - (half & 3)];
+			for (i = 0; i < half; i++) {
+				unsigned char tmp = buffer[i + half];
+				buffer[i + half] = buffer[i] ^ sha1_result[lane][i];
+				buffer[i] = tmp;
+			}
+		}
+	}
+}
+
 void ConfirmationID::Unmix(unsigned char* buffer, size_t bufSize, const unsigned char* key, size_t keySize)
 {
 	unsigned char sha1_input[64];
@@ -789,10 +1115,161 @@ void ConfirmationID::Unmix(unsigned char* buffer, size_t bufSize, const unsigned
 	}
 }
 
-int ConfirmationID::Generate(const char* installation_id_str, char confirmation_id[49], int mode, std::string productid, bool overrideVersion)
+/* x = x * mult + add on a 192-bit little endian x. */
+void ConfirmationID::mul_add192(QWORD x[3], QWORD mult, QWORD add)
+{
+	for (int i = 0; i < 3; i++) {
+		QWORD hi;
+		QWORD lo = __umul128(x[i], mult, &hi);
+		x[i] = lo + add;
+		add = hi + (x[i] < lo);
+	}
+}
+
+/*
+ * Reads the digits of an installation ID into a little endian number, the five digit
+ * groups are checked against their check digits on the way. digits gets the number of
+ * digits without check digits, 41 or 45 for anything Generate accepts.
+ *
+ * Digits are collected into 64-bit chunks of up to 19 and only those are multiplied
+ * into the 192-bit accumulator, rather than every digit going through every byte.
+ */
+int ConfirmationID::ParseInstallationID(const char* installation_id_str, unsigned char installation_id[20], size_t* digits)
+{
+	static const QWORD chunkScale = 10000000000000000000ull; // 10**19
+	QWORD value[3] = { 0, 0, 0 };
+	QWORD chunk = 0, scale = 1;
+	const char* p = installation_id_str;
+	size_t count = 0, totalCount = 0;
+	unsigned check = 0;
+	size_t i;
+	for (; *p; p++) {
+		if (*p == ' ' || *p == '-')
+			continue;
+		int d = *p - '0';
+		if (d < 0 || d > 9)
+			return ERR_INVALID_CHARACTER;
+		if (count == 5 || p[1] == 0) {
+			if (!count)
+				return (totalCount == 45) ? ERR_TOO_LARGE : ERR_TOO_SHORT;
+			if (d != check % 7)
+				return (count < 5) ? ERR_TOO_SHORT : ERR_INVALID_CHECK_DIGIT;
+			check = 0;
+			count = 0;
+			continue;
+		}
+		check += (count % 2 ? d * 2 : d);
+		count++;
+		totalCount++;
+		if (totalCount > 50)
+			return ERR_TOO_LARGE;
+		chunk = chunk * 10 + d;
+		scale *= 10;
+		if (scale == chunkScale) {
+			mul_add192(value, scale, chunk);
+			chunk = 0;
+			scale = 1;
+		}
+	}
+	if (totalCount != 41 && totalCount < 45)
+		return ERR_TOO_SHORT;
+	mul_add192(value, scale, chunk);
+	// 10**48 < 2**160, the top of anything longer is cut off
+	for (i = 0; i < 20; i++)
+		installation_id[i] = (unsigned char)(value[i / 8] >> (i % 8 * 8));
+	*digits = totalCount;
+	return SUCCESS;
+}
+
+/*
+ * Reads the four fields modes 2 and 3 mix into the key out of a product ID of the form
+ * 12345-123-1234567-12345 or 12345-OEM-1234567-12345, without going through the heap.
+ * Returns 0 for anything else.
+ */
+int ConfirmationID::ParseProductID(const char* productid, int productID[4])
+{
+	static const char pattern[] = "#####-###-#######-#####";
+	size_t i;
+	for (i = 0; i < sizeof(pattern) - 1; i++) {
+		if (!productid[i])
+			return 0;
+	}
+	if (productid[i])
+		return 0;
+
+	bool oem = toupper((unsigned char)productid[6]) == 'O' && toupper((unsigned char)productid[7]) == 'E' && toupper((unsigned char)productid[8]) == 'M';
+	for (i = 0; i < sizeof(pattern) - 1; i++) {
+		if (oem && i >= 6 && i <= 8)
+			continue;
+		if (pattern[i] == '-' ? productid[i] != '-' : (productid[i] < '0' || productid[i] > '9'))
+			return 0;
+	}
+
+	auto field = [productid](size_t at, size_t length) {
+		int value = 0;
+		for (size_t j = at; j < at + length; j++)
+			value = value * 10 + (productid[j] - '0');
+		return value;
+	};
+
+	productID[0] = field(0, 5);
+	if (oem) {
+		productID[1] = field(12, 3);
+		productID[2] = calculateCheckDigit(field(15, 1) * 100000 + field(18, 5));
+		productID[3] = field(10, 2) * 1000;
+	} else {
+		productID[1] = field(6, 3);
+		productID[2] = field(10, 7);
+		productID[3] = field(18, 5);
+	}
+	return 1;
+}
+
+/*
+ * Writes the 35 digit number a confirmation ID spells out as 7 dashed groups of five
+ * digits and a check digit. Every group comes off hi:lo with one division by 10**5 per
+ * 32-bit word, which the compiler turns into a multiplication by the reciprocal.
+ */
+void ConfirmationID::FormatConfirmationID(QWORD lo, QWORD hi, char confirmation_id[49])
+{
+	uint32_t words[4] = { (uint32_t)lo, (uint32_t)(lo >> 32), (uint32_t)hi, (uint32_t)(hi >> 32) };
+	unsigned groups[7];
+	int i, j;
+	for (i = 6; i >= 0; i--) {
+		QWORD rest = 0;
+		for (j = 3; j >= 0; j--) {
+			QWORD cur = rest << 32 | words[j];
+			words[j] = (uint32_t)(cur / 100000);
+			rest = cur % 100000;
+		}
+		groups[i] = (unsigned)rest;
+	}
+	assert(words[0] == 0 && words[1] == 0 && words[2] == 0 && words[3] == 0);
+
+	char* q = confirmation_id;
+	for (i = 0; i < 7; i++) {
+		if (i)
+			*q++ = '-';
+		unsigned group = groups[i];
+		unsigned char p[5];
+		for (j = 4; j >= 0; j--) {
+			p[j] = group % 10;
+			group /= 10;
+		}
+		q[0] = p[0] + '0';
+		q[1] = p[1] + '0';
+		q[2] = p[2] + '0';
+		q[3] = p[3] + '0';
+		q[4] = p[4] + '0';
+		q[5] = ((p[0]+p[1]*2+p[2]+p[3]*2+p[4]) % 7) + '0';
+		q += 6;
+	}
+	*q = 0;
+}
+
+/* Switches the field and curve globals over to those of an activation mode. */
+void ConfirmationID::select_curve(int mode)
 {
-	int version;
-	unsigned char hardwareID[8];
 	activationMode = mode;
 	switch (activationMode) {
 		case 0:
@@ -828,47 +1305,19 @@ int ConfirmationID::Generate(const char* installation_id_str, char confirmation_
 			f[4] = 0x163694F26056DB;
 			f[5] = 0x1;
 	}
+	residueField = residue_field(activationMode);
+}
+
+/* Parses an installation ID and finds the divisor its confirmation ID is a multiple of. */
+int ConfirmationID::derive_divisor(const char* installation_id_str, const char* productid, bool overrideVersion, TDivisor* d, unsigned* attempts, GenerationStats::Clock& clock)
+{
+	int version;
+	unsigned char hardwareID[8];
 	unsigned char installation_id[20]; // 10**45 < 256**19
-	size_t installation_id_len = 0;
-	const char* p = installation_id_str;
-	size_t count = 0, totalCount = 0;
-	unsigned check = 0;
-	size_t i;
-	for (; *p; p++) {
-		if (*p == ' ' || *p == '-')
-			continue;
-		int d = *p - '0';
-		if (d < 0 || d > 9)
-			return ERR_INVALID_CHARACTER;
-		if (count == 5 || p[1] == 0) {
-			if (!count)
-				return (totalCount == 45) ? ERR_TOO_LARGE : ERR_TOO_SHORT;
-			if (d != check % 7)
-				return (count < 5) ? ERR_TOO_SHORT : ERR_INVALID_CHECK_DIGIT;
-			check = 0;
-			count = 0;
-			continue;
-		}
-		check += (count % 2 ? d * 2 : d);
-		count++;
-		totalCount++;
-		if (totalCount > 50)
-			return ERR_TOO_LARGE;
-		unsigned char carry = d;
-		for (i = 0; i < installation_id_len; i++) {
-			unsigned x = installation_id[i] * 10 + carry;
-			installation_id[i] = x & 0xFF;
-			carry = x >> 8;
-		}
-		if (carry) {
-			assert(installation_id_len < sizeof(installation_id));
-			installation_id[installation_id_len++] = carry;
-		}
-	}
-	if (totalCount != 41 && totalCount < 45)
-		return ERR_TOO_SHORT;
-	for (; installation_id_len < sizeof(installation_id); installation_id_len++)
-		installation_id[installation_id_len] = 0;
+	size_t totalCount;
+	int err = ParseInstallationID(installation_id_str, installation_id, &totalCount);
+	if (err != SUCCESS)
+		return err;
 	unsigned char iid_key[4] = { 0x0, 0x0, 0x0, 0x0 };
 	switch (activationMode) {
 		case 0:
@@ -951,110 +1400,118 @@ int ConfirmationID::Generate(const char* installation_id_str, char confirmation_
 			    }
 			}
 			memcpy(&parsed, hardwareID, 8);
-			productID[0] = stoi(productid.substr(0,5));
-			std::string channelid = productid.substr(6,3);
-			char *p = &channelid[0];
-			for (; *p; p++) {
-				*p = toupper((unsigned char)*p);
-			}
-			if (strcmp(&channelid[0], "OEM") == 0) {
-				productID[1] = stoi(productid.substr(12,3));
-				productID[2] = (stoi(productid.substr(15,1)) * 100000) + stoi(productid.substr(18,5));
-				productID[2] = calculateCheckDigit(productID[2]);
-				productID[3] = ((stoi(productid.substr(10,2))) * 1000) + productID[3];
-			} else {
-				productID[1] = stoi(productid.substr(6,3));
-				productID[2] = stoi(productid.substr(10,7));
-				productID[3] = stoi(productid.substr(18,5));
-			}
+			if (!ParseProductID(productid, productID))
+				return ERR_INVALID_PRODUCT_ID;
 	}
 	// fmt::print("ProductID: {}-{}-{}-{} \n", productID[0], productID[1], productID[2], productID[3]);
 	
+	clock.lap(PHASE_NONCE);
+
 	unsigned char keybuf[16];
 	memcpy(keybuf, &parsed.HardwareID, 8);
 	QWORD productIdMixed = (QWORD)productID[0] << 41 | (QWORD)productID[1] << 58 | (QWORD)productID[2] << 17 | productID[3];
 	memcpy(keybuf + 8, &productIdMixed, 8);
 
-	TDivisor d;
-	unsigned char attempt;
-	for (attempt = 0; attempt <= 0x80; attempt++) {
+	// Attempts are hashed CONFID_LANES at a time and then tried in order, so the first attempt that
+	// works still wins and the result doesn't change, the hashes past it are the only wasted work.
+	unsigned attempt;
+	int lane = 0;
+	bool found = false;
+	for (attempt = 0; attempt <= 0x80; attempt += CONFID_LANES) {
 		union {
 			unsigned char buffer[14];
 			struct {
 				QWORD lo;
 				QWORD hi;
 			};
-		} u;
-		u.lo = 0;
-		u.hi = 0;
-		switch (activationMode) {
-			case 0:
-			case 1:
-			case 4:
-			case 5:
-				u.buffer[7] = attempt;
+		} u[CONFID_LANES];
+		unsigned char* buffers[CONFID_LANES];
+		for (lane = 0; lane < CONFID_LANES; lane++) {
+			u[lane].lo = 0;
+			u[lane].hi = 0;
+			switch (activationMode) {
+				case 0:
+				case 1:
+				case 4:
+				case 5:
+					u[lane].buffer[7] = attempt + lane;
+					break;
+				case 2:
+				case 3:
+					u[lane].buffer[6] = attempt + lane;
+			}
+			buffers[lane] = u[lane].buffer;
+		}
+		MixLanes(buffers, 14, keybuf, 16);
+		clock.lap(PHASE_HASH);
+		for (lane = 0; lane < CONFID_LANES && attempt + lane <= 0x80; lane++) {
+			GenerationStats::attempt(OP_CONFID);
+			QWORD x2 = ui128_quotient_mod(u[lane].lo, u[lane].hi);
+			QWORD x1 = u[lane].lo - x2 * MOD;
+			x2++;
+			d->u[0] = residue_sub(residue_mul(x1, x1), residue_mul(NON_RESIDUE, residue_mul(x2, x2)));
+			d->u[1] = residue_add(x1, x1);
+			found = find_divisor_v(d);
+			clock.lap(PHASE_SQRT);
+			if (found)
 				break;
-			case 2:
-			case 3:
-				u.buffer[6] = attempt;
+			GenerationStats::reject(OP_CONFID, REJECT_NO_DIVISOR);
 		}
-		Mix(u.buffer, 14, keybuf, 16);
-		QWORD x2 = ui128_quotient_mod(u.lo, u.hi);
-		QWORD x1 = u.lo - x2 * MOD;
-		x2++;
-		d.u[0] = residue_sub(residue_mul(x1, x1), residue_mul(NON_RESIDUE, residue_mul(x2, x2)));
-		d.u[1] = residue_add(x1, x1);
-		if (find_divisor_v(&d))
+		if (found)
 			break;
 	}
-	if (attempt > 0x80)
+	if (!found)
 		return ERR_UNLUCKY;
+	*attempts = attempt + lane + 1;
+	return SUCCESS;
+}
+
+/* d = d * private key of the current curve. */
+void ConfirmationID::sign_divisor(TDivisor* d)
+{
 	switch (activationMode) {
 		case 0:
-			divisor_mul128(&d, 0x04E21B9D10F127C1, 0x40DA7C36D44C, &d);
+			divisor_mul128(d, 0x04E21B9D10F127C1, 0x40DA7C36D44C, d);
 			break;
 		case 1:
 		case 2:
 		case 3:
-			divisor_mul128(&d, 0xEFE0302A1F7A5341, 0x01FB8CF48A70DF, &d);
+			divisor_mul128(d, 0xEFE0302A1F7A5341, 0x01FB8CF48A70DF, d);
 			break;
 		case 4:
 		case 5:
-			divisor_mul128(&d, 0x7C4254C43A5D1181, 0x01C61212ECE610, &d);
-	}
-	union {
-		struct {
-			QWORD encoded_lo, encoded_hi;
-		};
-		struct {
-			uint32_t encoded[4];
-		};
-	} e;
-	if (d.u[0] == BAD) {
+			divisor_mul128(d, 0x7C4254C43A5D1181, 0x01C61212ECE610, d);
+	}
+}
+
+/* The 128-bit number a confirmation ID spells out in decimal. */
+void ConfirmationID::encode_divisor(const TDivisor* d, QWORD* lo, QWORD* hi)
+{
+	if (d->u[0] == BAD) {
 		// we can not get the zero divisor, actually...
-		e.encoded_lo = __umul128(MOD + 2, MOD, &e.encoded_hi);
-	} else if (d.u[1] == BAD) {
+		*lo = __umul128(MOD + 2, MOD, hi);
+	} else if (d->u[1] == BAD) {
 		// O(1/MOD) chance
 		//encoded = (unsigned __int128)(MOD + 1) * d.u[0] + MOD; // * MOD + d.u[0] is fine too
-		e.encoded_lo = __umul128(MOD + 1, d.u[0], &e.encoded_hi);
-		e.encoded_lo += MOD;
-		e.encoded_hi += (e.encoded_lo < MOD);
+		*lo = __umul128(MOD + 1, d->u[0], hi);
+		*lo += MOD;
+		*hi += (*lo < MOD);
 	} else {
-		QWORD x1 = (d.u[1] % 2 ? d.u[1] + MOD : d.u[1]) / 2;
-		QWORD x2sqr = residue_sub(residue_mul(x1, x1), d.u[0]);
+		QWORD x1 = (d->u[1] % 2 ? d->u[1] + MOD : d->u[1]) / 2;
+		QWORD x2sqr = residue_sub(residue_mul(x1, x1), d->u[0]);
 		QWORD x2 = residue_sqrt(x2sqr);
 		if (x2 == BAD) {
-			x2 = residue_sqrt(residue_mul(x2sqr, residue_inv(NON_RESIDUE)));
+			x2 = residue_sqrt(residue_mul(x2sqr, residueField->nonResidueInv));
 			assert(x2 != BAD);
-			e.encoded_lo = __umul128(MOD + 1, MOD + x2, &e.encoded_hi);
-			e.encoded_lo += x1;
-			e.encoded_hi += (e.encoded_lo < x1);
+			*lo = __umul128(MOD + 1, MOD + x2, hi);
+			*lo += x1;
+			*hi += (*lo < x1);
 		} else {
 			// points (-x1+x2, v(-x1+x2)) and (-x1-x2, v(-x1-x2))
 			QWORD x1a = residue_sub(x1, x2);
-			QWORD y1 = residue_sub(d.v[0], residue_mul(d.v[1], x1a));
+			QWORD y1 = residue_sub(d->v[0], residue_mul(d->v[1], x1a));
 			QWORD x2a = residue_add(x1, x2);
-			QWORD y2 = residue_sub(d.v[0], residue_mul(d.v[1], x2a));
+			QWORD y2 = residue_sub(d->v[0], residue_mul(d->v[1], x2a));
 			if (x1a > x2a) {
 				QWORD tmp = x1a;
 				x1a = x2a;
@@ -1065,38 +1522,171 @@ int ConfirmationID::Generate(const char* installation_id_str, char confirmation_
 				x1a = x2a;
 				x2a = tmp;
 			}
-			e.encoded_lo = __umul128(MOD + 1, x1a, &e.encoded_hi);
-			e.encoded_lo += x2a;
-			e.encoded_hi += (e.encoded_lo < x2a);
+			*lo = __umul128(MOD + 1, x1a, hi);
+			*lo += x2a;
+			*hi += (*lo < x2a);
 		}
 	}
-	unsigned char decimal[35];
-	for (i = 0; i < 35; i++) {
-		unsigned c = e.encoded[3] % 10;
-		e.encoded[3] /= 10;
-		unsigned c2 = ((QWORD)c << 32 | e.encoded[2]) % 10;
-		e.encoded[2] = ((QWORD)c << 32 | e.encoded[2]) / 10;
-		unsigned c3 = ((QWORD)c2 << 32 | e.encoded[1]) % 10;
-		e.encoded[1] = ((QWORD)c2 << 32 | e.encoded[1]) / 10;
-		unsigned c4 = ((QWORD)c3 << 32 | e.encoded[0]) % 10;
-		e.encoded[0] = ((QWORD)c3 << 32 | e.encoded[0]) / 10;
-		decimal[34 - i] = c4;
+}
+
+int ConfirmationID::Generate(const char* installation_id_str, char confirmation_id[49], int mode, const char* productid, bool overrideVersion)
+{
+	GenerationStats::Clock clock(OP_CONFID);
+	select_curve(mode);
+	TDivisor d;
+	unsigned attempts;
+	int err = derive_divisor(installation_id_str, productid, overrideVersion, &d, &attempts, clock);
+	if (err != SUCCESS)
+		return err;
+	sign_divisor(&d);
+	clock.lap(PHASE_SCALAR_MUL);
+	QWORD lo, hi;
+	encode_divisor(&d, &lo, &hi);
+	FormatConfirmationID(lo, hi, confirmation_id);
+
+	clock.lap(PHASE_ENCODE);
+	GenerationStats::complete(OP_CONFID, attempts);
+	return 0;
+}
+
+/* Reads the 35 digit number out of a confirmation ID, dashes and spaces are skipped. */
+int ConfirmationID::parse_cid(const char* confirmation_id, QWORD* lo, QWORD* hi)
+{
+	unsigned char group[6];
+	int count = 0, groups = 0;
+	*lo = 0;
+	*hi = 0;
+	for (const char* p = confirmation_id; *p; p++) {
+		if (*p == ' ' || *p == '-')
+			continue;
+		if (*p < '0' || *p > '9' || groups == 7)
+			return 0;
+		group[count++] = *p - '0';
+		if (count < 6)
+			continue;
+		if (group[5] != (group[0] + group[1]*2 + group[2] + group[3]*2 + group[4]) % 7)
+			return 0;
+		for (int i = 0; i < 5; i++) {
+			// hi:lo = hi:lo * 10 + digit, 10**35 < 2**117 so hi never overflows
+			QWORD carry;
+			QWORD low = __umul128(*lo, 10, &carry);
+			*hi = *hi * 10 + carry;
+			*lo = low + group[i];
+			*hi += (*lo < low);
+		}
+		count = 0;
+		groups++;
 	}
+	return groups == 7 && count == 0;
+}
 
-	assert(e.encoded[0] == 0 && e.encoded[1] == 0 && e.encoded[2] == 0 && e.encoded[3] == 0);
-	char* q = confirmation_id;
-	for (i = 0; i < 7; i++) {
-		if (i)
-			*q++ = '-';
-		unsigned char* p = decimal + i*5;
-		q[0] = p[0] + '0';
-		q[1] = p[1] + '0';
-		q[2] = p[2] + '0';
-		q[3] = p[3] + '0';
-		q[4] = p[4] + '0';
-		q[5] = ((p[0]+p[1]*2+p[2]+p[3]*2+p[4]) % 7) + '0';
-		q += 6;
+/*
+ * The reverse of the encoding at the end of Generate.
+ *
+ * u comes back exactly. The encoding only keeps one bit of v, so d->v is a valid v for
+ * that u rather than the one the confirmation ID was made from, and degree one or zero
+ * divisors (O(1/MOD) of them) come back with only u filled in, BAD marking the degree.
+ * Returns SUCCESS, ERR_INVALID_CID or ERR_CID_NOT_ON_CURVE.
+ */
+int ConfirmationID::Decode(const char* confirmation_id, int mode, TDivisor* d)
+{
+	QWORD lo, hi;
+	select_curve(mode);
+	if (!parse_cid(confirmation_id, &lo, &hi))
+		return ERR_INVALID_CID;
+	return decode_divisor(lo, hi, d);
+}
+
+/* Decode for the number parse_cid read, on the current curve. */
+int ConfirmationID::decode_divisor(QWORD lo, QWORD hi, TDivisor* d)
+{
+	// hi:lo = (MOD + 1) * a + b
+	QWORD a = 0, b = 0;
+	for (int bit = 127; bit >= 0; bit--) {
+		b = b << 1 | ((bit >= 64 ? hi >> (bit - 64) : lo >> bit) & 1);
+		a <<= 1;
+		if (b >= MOD + 1) {
+			b -= MOD + 1;
+			a |= 1;
+		}
 	}
-	*q++ = 0;
-	return 0;
+
+	d->v[0] = d->v[1] = 0;
+	if (b == MOD) {
+		if (a > MOD)
+			return ERR_CID_NOT_ON_CURVE;
+		// a == MOD is the zero divisor, otherwise u = x + a
+		d->u[0] = a == MOD ? BAD : a;
+		d->u[1] = BAD;
+		return SUCCESS;
+	}
+	if (a == MOD || a >= 2 * MOD)
+		return ERR_CID_NOT_ON_CURVE;
+	if (a > MOD) {
+		// u has no roots: x1 = u1 / 2 and NON_RESIDUE * x2^2 = x1^2 - u0
+		QWORD x2 = a - MOD;
+		d->u[0] = residue_sub(residue_mul(b, b), residue_mul(NON_RESIDUE, residue_mul(x2, x2)));
+		d->u[1] = residue_add(b, b);
+	} else {
+		// u = (x + a)(x + b)
+		d->u[0] = residue_mul(a, b);
+		d->u[1] = residue_add(a, b);
+	}
+	return find_divisor_v(d) ? SUCCESS : ERR_CID_NOT_ON_CURVE;
+}
+
+/*
+ * Checks that a confirmation ID belongs to an installation ID.
+ *
+ * The CID is decoded and checked for being a divisor on the curve first, which turns
+ * away typos and garbage without any scalar multiplication. A CID that passes still
+ * costs one divisor_mul128, after which the two are compared as numbers, so neither the
+ * decimal formatting of Generate nor any string handling is involved.
+ * Returns SUCCESS when they match, ERR_MISMATCH, or any error of Generate and Decode.
+ */
+int ConfirmationID::Verify(const char* installation_id_str, const char* confirmation_id, int mode, const char* productid, bool overrideVersion)
+{
+	GenerationStats::Clock clock(OP_CONFID);
+	QWORD claimed_lo, claimed_hi, lo, hi;
+	TDivisor d;
+	select_curve(mode);
+	if (!parse_cid(confirmation_id, &claimed_lo, &claimed_hi))
+		return ERR_INVALID_CID;
+	int err = decode_divisor(claimed_lo, claimed_hi, &d);
+	if (err != SUCCESS)
+		return err;
+	clock.lap(PHASE_ENCODE);
+
+	unsigned attempts;
+	err = derive_divisor(installation_id_str, productid, overrideVersion, &d, &attempts, clock);
+	if (err != SUCCESS)
+		return err;
+	sign_divisor(&d);
+	clock.lap(PHASE_SCALAR_MUL);
+
+	encode_divisor(&d, &lo, &hi);
+	clock.lap(PHASE_ENCODE);
+	GenerationStats::complete(OP_CONFID, attempts);
+	return lo == claimed_lo && hi == claimed_hi ? SUCCESS : ERR_MISMATCH;
+}
+
+/*
+ * Verify on count pairs that share a mode and product ID, results[i] gets the result of pair i.
+ *
+ * Every CID gets decoded before any pair pays for a scalar multiplication, so a log full
+ * of mistyped IDs costs next to nothing. Returns how many pairs matched.
+ */
+size_t ConfirmationID::VerifyBatch(const char* const installation_ids[], const char* const confirmation_ids[], size_t count, int mode, const char* productid, bool overrideVersion, int results[])
+{
+	size_t i, matched = 0;
+	TDivisor d;
+	for (i = 0; i < count; i++)
+		results[i] = Decode(confirmation_ids[i], mode, &d);
+	for (i = 0; i < count; i++) {
+		if (results[i] != SUCCESS)
+			continue;
+		results[i] = Verify(installation_ids[i], confirmation_ids[i], mode, productid, overrideVersion);
+		matched += results[i] == SUCCESS;
+	}
+	return matched;
 }
@@ -24,6 +24,7 @@
 #define UMSKT_CONFID_H
 
 #include "../libumskt.h"
+#include "../stats.h"
 
 // Confirmation ID generator constants
 #define SUCCESS 0
@@ -34,13 +35,48 @@
 #define ERR_UNKNOWN_VERSION 5
 #define ERR_UNLUCKY 6
 
+// Confirmation ID verification results
+#define ERR_INVALID_CID 7       // not 7 groups of 5 digits plus a check digit, or a check digit is off
+#define ERR_CID_NOT_ON_CURVE 8  // well formed, but no confirmation ID ever encodes that number
+#define ERR_MISMATCH 9          // a valid confirmation ID, just not the one of this installation ID
+#define ERR_INVALID_PRODUCT_ID 10
+
+// Fixed exponent schedules and the Tonelli-Shanks table, see residue_field()
+#define RESIDUE_CHAIN_WINDOW 3
+#define RESIDUE_CHAIN_STEPS 64
+#define RESIDUE_MAX_TWO_ADICITY 3
+#define RESIDUE_INV_SHIFTS 128
+
+// Generate hashes this many attempts at once
+#define CONFID_LANES 4
+
 
 typedef struct {
     QWORD u[2];
     QWORD v[2];
 } TDivisor;
 
+// x^e for a fixed e: x^digits[0], then for every further step square squarings[i] times and multiply by x^digits[i] (odd, 0 for none)
+typedef struct {
+    int length;
+    unsigned char squarings[RESIDUE_CHAIN_STEPS];
+    unsigned char digits[RESIDUE_CHAIN_STEPS];
+} TResidueChain;
+
+// MOD - 1 = 2^twoAdicity * q and z = NON_RESIDUE^q, everything residue_sqrt needs that doesn't depend on its input
+typedef struct {
+    int twoAdicity;
+    TResidueChain sqrtChain;                                // (q - 1) / 2
+    QWORD roots[1 << (RESIDUE_MAX_TWO_ADICITY - 1)];        // z^(2j)
+    QWORD fixes[1 << (RESIDUE_MAX_TWO_ADICITY - 1)];        // the root of z^-(2j) Tonelli-Shanks picks
+    QWORD nonResidueInv;
+    QWORD inversePowers[RESIDUE_INV_SHIFTS];                // 2^-k, residue_inv without division
+} TResidueField;
+
 EXPORT class ConfirmationID {
+    // umskt-bench measures the field and divisor arithmetic directly
+    friend class ConfirmationIDBench;
+
     static int calculateCheckDigit(int pid);
     static QWORD residue_add(QWORD x, QWORD y);
     static QWORD residue_sub(QWORD x, QWORD y);
@@ -48,8 +84,12 @@ EXPORT class ConfirmationID {
     static QWORD ui128_quotient_mod(QWORD lo, QWORD hi);
     static QWORD residue_mul(QWORD x, QWORD y);
     static QWORD residue_pow(QWORD x, QWORD y);
+    static void residue_chain(QWORD exponent, TResidueChain* chain);
+    static QWORD residue_pow_chain(QWORD x, const TResidueChain* chain);
     static QWORD inverse(QWORD u, QWORD v);
     static QWORD residue_inv(QWORD x);
+    static void residue_setup(TResidueField* field);
+    static const TResidueField* residue_field(int mode);
     static QWORD residue_sqrt(QWORD what);
     static int find_divisor_v(TDivisor* d);
     static int polynomial_mul(int adeg, const QWORD a[], int bdeg, const QWORD b[], int resultprevdeg, QWORD result[]);
@@ -61,12 +101,27 @@ EXPORT class ConfirmationID {
     static void divisor_mul128(const TDivisor* src, QWORD mult_lo, QWORD mult_hi, TDivisor* dst);
     static unsigned rol(unsigned x, int shift);
     static void sha1_single_block(unsigned char input[64], unsigned char output[20]);
+    static void sha1_lanes(unsigned char input[CONFID_LANES][64], unsigned char output[CONFID_LANES][20]);
     static void decode_iid_new_version(unsigned char* iid, unsigned char* hwid, int* version);
     static void Mix(unsigned char* buffer, size_t bufSize, const unsigned char* key, size_t keySize);
+    static void MixLanes(unsigned char* buffers[CONFID_LANES], size_t bufSize, const unsigned char* key, size_t keySize);
     static void Unmix(unsigned char* buffer, size_t bufSize, const unsigned char* key, size_t keySize);
+    static void select_curve(int mode);
+    static int derive_divisor(const char* installation_id_str, const char* productid, bool overrideVersion, TDivisor* d, unsigned* attempts, GenerationStats::Clock& clock);
+    static void sign_divisor(TDivisor* d);
+    static void encode_divisor(const TDivisor* d, QWORD* lo, QWORD* hi);
+    static void mul_add192(QWORD x[3], QWORD mult, QWORD add);
+    static int parse_cid(const char* confirmation_id, QWORD* lo, QWORD* hi);
+    static int decode_divisor(QWORD lo, QWORD hi, TDivisor* d);
 
 public:
-    static int Generate(const char* installation_id_str, char confirmation_id[49], int mode, std::string productid, bool overrideVersion);
+    static int Generate(const char* installation_id_str, char confirmation_id[49], int mode, const char* productid, bool overrideVersion);
+    static int ParseInstallationID(const char* installation_id_str, unsigned char installation_id[20], size_t* digits);
+    static int ParseProductID(const char* productid, int productID[4]);
+    static void FormatConfirmationID(QWORD lo, QWORD hi, char confirmation_id[49]);
+    static int Decode(const char* confirmation_id, int mode, TDivisor* d);
+    static int Verify(const char* installation_id_str, const char* confirmation_id, int mode, const char* productid, bool overrideVersion);
+    static size_t VerifyBatch(const char* const installation_ids[], const char* const confirmation_ids[], size_t count, int mode, const char* productid, bool overrideVersion, int results[]);
     //EXPORT static int CLIRun();
 };
 
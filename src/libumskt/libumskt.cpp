@@ -27,8 +27,9 @@
 #include "pidgen3/BINK2002.h"
 #include "pidgen2/PIDGEN2.h"
 
+// Kept for existing callers, these pass C++ types around, new code should use capi.h
 FNEXPORT int ConfirmationID_Generate(const char* installation_id_str, char confirmation_id[49], int mode, std::string productid, bool bypassVersion) {
-    return ConfirmationID::Generate(installation_id_str, confirmation_id, mode, productid, bypassVersion);
+    return ConfirmationID::Generate(installation_id_str, confirmation_id, mode, productid.c_str(), bypassVersion);
 }
 
 FNEXPORT EC_GROUP* PIDGEN3_initializeEllipticCurve(char* pSel, char* aSel, char* bSel, char* generatorXSel, char* generatorYSel, char* publicKeyXSel, char* publicKeyYSel, EC_POINT *&genPoint, EC_POINT *&pubPoint) {
@@ -59,8 +60,67 @@ FNEXPORT int PIDGEN2_GenerateOEM(char* year, char* day, char* oem, char* keyout)
     return PIDGEN2::GenerateOEM(year, day, oem, keyout);
 }
 
+/*
+ * Deterministic random streams.
+ *
+ * While a stream is selected, the RNG functions below return SHA-256(seed, stream,
+ * substream, counter) instead of system randomness. Every (seed, stream, substream)
+ * is an independent sequence that comes out the same on every run and every thread,
+ * which is what lets bulk runs checkpoint, resume and split into shards: key i of a
+ * job always draws from stream i, no matter which worker or which machine makes it.
+ */
+namespace {
+    struct RandomStream {
+        bool active;
+        QWORD words[4];     // seed, stream, substream, counter
+        BYTE block[SHA256_DIGEST_LENGTH];
+        int available;
+    };
+
+    thread_local RandomStream randomStream;
+
+    void streamBytes(unsigned char *buf, int num) {
+        RandomStream &rs = randomStream;
+
+        while (num > 0) {
+            if (rs.available == 0) {
+                BYTE message[sizeof(rs.words)];
+                for (int i = 0; i < 4; i++) {
+                    for (int j = 0; j < 8; j++) {
+                        message[i * 8 + j] = (BYTE)(rs.words[i] >> (j * 8));
+                    }
+                }
+
+                SHA256(message, sizeof(message), rs.block);
+                rs.words[3]++;
+                rs.available = SHA256_DIGEST_LENGTH;
+            }
+
+            int n = std::min(num, rs.available);
+            memcpy(buf, rs.block + SHA256_DIGEST_LENGTH - rs.available, n);
+
+            rs.available -= n;
+            buf += n;
+            num -= n;
+        }
+    }
+}
+
+void UMSKT::setRandomStream(QWORD seed, QWORD stream, QWORD substream) {
+    randomStream = RandomStream { true, { seed, stream, substream, 0 }, {}, 0 };
+}
+
+void UMSKT::clearRandomStream() {
+    randomStream.active = false;
+}
+
 // RNG utility functions
 int UMSKT::umskt_rand_bytes(unsigned char *buf, int num) {
+    if (randomStream.active) {
+        streamBytes(buf, num);
+        return 1;
+    }
+
 #if UMSKT_RNG_DJGPP
     // DOS-compatible RNG using DJGPP's random() function
     static bool initialized = false;
@@ -95,6 +155,33 @@ int UMSKT::umskt_rand_bytes(unsigned char *buf, int num) {
 }
 
 int UMSKT::umskt_bn_rand(BIGNUM *rnd, int bits, int top, int bottom) {
+    if (randomStream.active) {
+        unsigned char buf[128];
+        int bytes = (bits + 7) / 8;
+
+        if (bits <= 0 || bytes > (int)sizeof(buf)) {
+            return 0;
+        }
+
+        streamBytes(buf, bytes);
+        if (!BN_bin2bn(buf, bytes, rnd) || !BN_mask_bits(rnd, bits)) {
+            return 0;
+        }
+
+        // same top/bottom semantics as BN_rand
+        if (top >= BN_RAND_TOP_ONE) {
+            BN_set_bit(rnd, bits - 1);
+        }
+        if (top == BN_RAND_TOP_TWO && bits > 1) {
+            BN_set_bit(rnd, bits - 2);
+        }
+        if (bottom == BN_RAND_BOTTOM_ODD) {
+            BN_set_bit(rnd, 0);
+        }
+
+        return 1;
+    }
+
 #if UMSKT_RNG_DJGPP
     // DOS-compatible RNG implementation for BIGNUMs
     unsigned char *buf = (unsigned char *)malloc((bits + 7) / 8);
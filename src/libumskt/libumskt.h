@@ -74,6 +74,13 @@ extern "C" {
 #define UMSKT_RNG_DJGPP 0
 #endif
 
+// Threading support, DJGPP and single-threaded emscripten builds run everything inline
+#if defined(__DJGPP__) || (defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__))
+#define UMSKT_THREADS 0
+#else
+#define UMSKT_THREADS 1
+#endif
+
 class UMSKT {
 public:
     static std::FILE* debug;
@@ -86,6 +93,10 @@ public:
     // RNG utility functions
     static int umskt_rand_bytes(unsigned char *buf, int num);
     static int umskt_bn_rand(BIGNUM *rnd, int bits, int top, int bottom);
+
+    // Deterministic random streams for the calling thread, see libumskt.cpp
+    static void setRandomStream(QWORD seed, QWORD stream, QWORD substream);
+    static void clearRandomStream();
 };
 
 #endif //UMSKT_LIBUMSKT_H
@@ -22,12 +22,11 @@
 
 #include "PIDGEN2.h"
 
-const char* channelIDBlacklist [7]  = {"333", "444", "555", "666", "777", "888", "999"};
-const char* validYears[8] = { "95", "96", "97", "98", "99", "00", "01", "02"};
+#include <algorithm>
 
-bool PIDGEN2::isNumericString(char* input) {
-    for(int i = 0; i < strlen(input); i++) {
-        if (input[i] < '0' || input[i] > '9') {
+bool PIDGEN2::isNumericString(const char* input) {
+    for (; *input; input++) {
+        if (*input < '0' || *input > '9') {
             return false;
         }
     }
@@ -35,101 +34,382 @@ bool PIDGEN2::isNumericString(char* input) {
     return true;
 }
 
-int PIDGEN2::addDigits(char* input) {
+/* Sum of the digits of input, -1 if it isn't a number. */
+int PIDGEN2::addDigits(const char* input) {
     int output = 0;
 
-    if (!isNumericString(input)) {
-        return -1;
-    }
-
-    for(int i = 0; i < strlen(input); i++) {
-        output += input[i] - '0';
+    for (; *input; input++) {
+        if (*input < '0' || *input > '9') {
+            return -1;
+        }
+        output += *input - '0';
     }
 
     return output;
 }
 
-bool PIDGEN2::isValidChannelID(char* channelID) {
-    if (strlen(channelID) > 3) {
-        return false;
+bool PIDGEN2::isValidChannelID(const char* channelID) {
+    return strlen(channelID) == 3 && isNumericString(channelID) && isValidSite(parseDigits(channelID, 3));
+}
+
+/* The 7 digit block of an OEM key, which always starts with 0. */
+bool PIDGEN2::isValidOEMID(const char* OEMID) {
+    return strlen(OEMID) == 7 && OEMID[0] == '0' && isNumericString(OEMID) && isValidBlock(parseDigits(OEMID, 7));
+}
+
+bool PIDGEN2::isValidYear(const char* year) {
+    return strlen(year) == 2 && isNumericString(year) && isValidDate(1, parseDigits(year, 2));
+}
+
+bool PIDGEN2::isValidDay(const char* day) {
+    size_t length = strlen(day);
+    return length >= 1 && length <= 3 && isNumericString(day) && isValidDate(parseDigits(day, (int)length), 95);
+}
+
+bool PIDGEN2::isValidRetailProductID(const char* productID) {
+    return isValidKey(PIDGEN2_RETAIL, productID, strlen(productID));
+}
+
+/* Random key from a site, fails for an invalid one. */
+int PIDGEN2::GenerateRetail(char* channelID, char* &keyout) {
+    if (!isValidChannelID(channelID)) {
+        return 1;
     }
 
-    for (int i = 0; i <= 6; i++) {
-        if (strcmp(channelID, channelIDBlacklist[i]) != 0) {
-            return false;
+    DWORD site = parseDigits(channelID, 3);
+
+    QWORD random;
+    UMSKT::umskt_rand_bytes((BYTE *)&random, sizeof(random));
+
+    char *out = putDigits(keyout, site, 3);
+    *out++ = '-';
+    out = putDigits(out, blockAt((DWORD)(random % PIDGEN2_BLOCKS)), 7);
+    *out = 0;
+
+    return 0;
+}
+
+/* Random OEM key, any field that isn't valid is replaced by a random one. */
+int PIDGEN2::GenerateOEM(char* year, char* day, char* oem, char* &keyout) {
+    QWORD random[2];
+    UMSKT::umskt_rand_bytes((BYTE *)random, sizeof(random));
+
+    // 0 for anything that isn't a plain number, which no valid field is
+    auto number = [](const char *text) {
+        DWORD value = 0;
+        for (; *text; text++) {
+            if (*text < '0' || *text > '9' || value > 9999999) {
+                return (DWORD)0;
+            }
+            value = value * 10 + (*text - '0');
         }
+        return value;
+    };
+
+    DWORD iYear = number(year), iDay = number(day), block = number(oem);
+
+    if (!isValidDate(iDay, iYear)) {
+        DWORD date = (DWORD)(random[0] % (PIDGEN2_OEM_DAYS * PIDGEN2_OEM_YEARS));
+        iDay = date / PIDGEN2_OEM_YEARS + 1;
+        iYear = (date % PIDGEN2_OEM_YEARS + 95) % 100;
     }
 
-    return true;
+    if (block >= 1000000 || !isValidBlock(block)) {
+        block = blockAt((DWORD)((random[0] >> 32) % PIDGEN2_OEM_BLOCKS));
+    }
+
+    char *out = putDigits(keyout, iDay, 3);
+    out = putDigits(out, iYear, 2);
+    memcpy(out, "-OEM-", 5);
+    out = putDigits(out + 5, block, 7);
+    *out++ = '-';
+    out = putDigits(out, (DWORD)(random[1] % PIDGEN2_OEM_TAILS), 5);
+    *out = 0;
+
+    return 0;
+}
+
+/* Digit sum divisible by 7 and a last digit between 1 and 7. */
+bool PIDGEN2::isValidBlock(DWORD block) {
+    DWORD last = block % 10;
+    return block <= 9999999 && last >= 1 && last <= 7 && blockAt(block / 10) == block;
 }
 
-bool PIDGEN2::isValidOEMID(char* OEMID) {
-    if (!isNumericString(OEMID)) {
-        return false;
+bool PIDGEN2::isValidSite(DWORD site) {
+    return site < 1000 && !(site >= 333 && site % 111 == 0);
+}
+
+/* day of year 1 to 366, two digit year 95 to 03. */
+bool PIDGEN2::isValidDate(DWORD day, DWORD year) {
+    return day >= 1 && day <= PIDGEN2_OEM_DAYS && ((year >= 95 && year <= 99) || year <= 3);
+}
+
+/* The valid block starting with the 6 digits of index, exactly one of 1 to 7 completes the sum. */
+DWORD PIDGEN2::blockAt(DWORD index) {
+    DWORD sum = 0;
+    for (DWORD rest = index; rest; rest /= 10) {
+        sum += rest % 10;
     }
 
-    if (strlen(OEMID) > 5) {
-        if (OEMID[0] != '0' || OEMID[1] != '0') {
-            return false;
-        }
+    return index * 10 + 7 - sum % 7;
+}
+
+/* The index-th valid site, skipping over 333, 444, ..., 999. */
+DWORD PIDGEN2::siteAt(DWORD index) {
+    for (DWORD repeat = 333; repeat <= 999 && index >= repeat; repeat += 111) {
+        index++;
     }
 
-    int mod = addDigits(OEMID);
+    return index;
+}
+
+/* The number in the first width characters of in, which have to be digits. */
+DWORD PIDGEN2::parseDigits(const char *in, int width) {
+    DWORD value = 0;
+    for (int i = 0; i < width; i++) {
+        value = value * 10 + (in[i] - '0');
+    }
 
-    return (mod % 21 == 0);
+    return value;
 }
 
-bool PIDGEN2::isValidYear(char* year) {
-    for (int i = 0; i <= 7; i++) {
-        if (year == validYears[i]) {
-            return false;
-        }
+/* Writes value as exactly width digits, returns the end. */
+char *PIDGEN2::putDigits(char *out, DWORD value, int width) {
+    for (int i = width - 1; i >= 0; i--) {
+        out[i] = (char)('0' + value % 10);
+        value /= 10;
     }
-    return true;
+
+    return out + width;
+}
+
+int PIDGEN2::keyLength(PIDGEN2_KEY_TYPE type) {
+    return type == PIDGEN2_OEM ? PIDGEN2_OEM_LENGTH : PIDGEN2_RETAIL_LENGTH;
 }
 
-bool PIDGEN2::isValidDay(char* day) {
-    if (!isNumericString(day)) {
-        return false;
+QWORD PIDGEN2::Keyspace(PIDGEN2_KEY_TYPE type) {
+    if (type == PIDGEN2_OEM) {
+        return (QWORD)PIDGEN2_OEM_DAYS * PIDGEN2_OEM_YEARS * PIDGEN2_OEM_BLOCKS * PIDGEN2_OEM_TAILS;
     }
 
-    int iDay = std::stoi(day);
-    if (iDay == 0 || iDay >= 365) {
-        return false;
+    return (QWORD)PIDGEN2_SITES * PIDGEN2_BLOCKS;
+}
+
+/* Writes key number index of the keyspace into out, keyLength(type) characters, no terminator. */
+void PIDGEN2::FormatKey(PIDGEN2_KEY_TYPE type, QWORD index, char *out) {
+    if (type == PIDGEN2_RETAIL) {
+        out = putDigits(out, siteAt((DWORD)(index / PIDGEN2_BLOCKS)), 3);
+        *out++ = '-';
+        putDigits(out, blockAt((DWORD)(index % PIDGEN2_BLOCKS)), 7);
+        return;
     }
-    return true;
+
+    DWORD tail = (DWORD)(index % PIDGEN2_OEM_TAILS);
+    index /= PIDGEN2_OEM_TAILS;
+    DWORD block = (DWORD)(index % PIDGEN2_OEM_BLOCKS);
+    DWORD date = (DWORD)(index / PIDGEN2_OEM_BLOCKS);
+
+    out = putDigits(out, date / PIDGEN2_OEM_YEARS + 1, 3);
+    out = putDigits(out, (date % PIDGEN2_OEM_YEARS + 95) % 100, 2);
+    memcpy(out, "-OEM-", 5);
+    out = putDigits(out + 5, blockAt(block), 7);
+    *out++ = '-';
+    putDigits(out, tail, 5);
 }
 
-bool PIDGEN2::isValidRetailProductID(char* productID) {
-    return true;
+/* A uniformly random valid key, NUL terminated. */
+void PIDGEN2::Generate(PIDGEN2_KEY_TYPE type, char *out) {
+    QWORD random;
+    UMSKT::umskt_rand_bytes((BYTE *)&random, sizeof(random));
+
+    FormatKey(type, random % Keyspace(type), out);
+    out[keyLength(type)] = 0;
 }
 
-int PIDGEN2::GenerateRetail(char* channelID, char* &keyout) {
-    if (!isValidChannelID(channelID)) {
-        return 1;
+/* count random keys, each followed by terminator, returns the number of bytes written. */
+size_t PIDGEN2::Generate(PIDGEN2_KEY_TYPE type, size_t count, char *out, char terminator) {
+    const int length = keyLength(type);
+    const QWORD keyspace = Keyspace(type);
+    char *start = out;
+
+    // one trip to the RNG per 64 keys instead of per key
+    QWORD random[64];
+
+    for (size_t done = 0; done < count; done += 64) {
+        size_t batch = std::min(count - done, (size_t)64);
+        UMSKT::umskt_rand_bytes((BYTE *)random, (int)(batch * sizeof(QWORD)));
+
+        for (size_t i = 0; i < batch; i++) {
+            FormatKey(type, random[i] % keyspace, out);
+            out[length] = terminator;
+            out += length + 1;
+        }
     }
 
-    return 0;
+    return out - start;
 }
 
-int PIDGEN2::GenerateOEM(char* year, char* day, char* oem, char* &keyout) {
-    if (!isValidOEMID(oem)) {
-        int mod = addDigits(oem);
-        mod += mod % 21;
+/*
+ * Writes count consecutive keys starting at index first, each followed by terminator,
+ * and returns the number of bytes written. The caller keeps first + count within the keyspace.
+ *
+ * Only the first key is formatted from scratch, after that the fields are counted up
+ * like an odometer and only the ones that changed are rewritten.
+ */
+size_t PIDGEN2::Enumerate(PIDGEN2_KEY_TYPE type, QWORD first, size_t count, char *out, char terminator) {
+    const int length = keyLength(type);
+    char *start = out;
 
-        strcpy(oem, fmt::format("{:07d}", mod).c_str());
+    if (count == 0) {
+        return 0;
     }
 
-    if (!isValidYear(year)) {
-        strcpy(year, validYears[0]);
-    }
+    FormatKey(type, first, out);
+    out[length] = terminator;
+
+    if (type == PIDGEN2_RETAIL) {
+        DWORD block = (DWORD)(first % PIDGEN2_BLOCKS), site = (DWORD)(first / PIDGEN2_BLOCKS);
+
+        for (size_t i = 1; i < count; i++) {
+            memcpy(out + length + 1, out, length + 1);
+            out += length + 1;
+
+            if (++block == PIDGEN2_BLOCKS) {
+                block = 0;
+                putDigits(out, siteAt(++site), 3);
+            }
+            putDigits(out + 4, blockAt(block), 7);
+        }
+    } else {
+        DWORD tail = (DWORD)(first % PIDGEN2_OEM_TAILS);
+        QWORD rest = first / PIDGEN2_OEM_TAILS;
+        DWORD block = (DWORD)(rest % PIDGEN2_OEM_BLOCKS), date = (DWORD)(rest / PIDGEN2_OEM_BLOCKS);
+
+        for (size_t i = 1; i < count; i++) {
+            memcpy(out + length + 1, out, length + 1);
+            out += length + 1;
 
-    if (!isValidDay(day)) {
-        int iday = std::stoi(day);
-        iday = (iday + 1) % 365;
+            if (++tail == PIDGEN2_OEM_TAILS) {
+                tail = 0;
+                if (++block == PIDGEN2_OEM_BLOCKS) {
+                    block = 0;
+                    date++;
+                    putDigits(out, date / PIDGEN2_OEM_YEARS + 1, 3);
+                    putDigits(out + 3, (date % PIDGEN2_OEM_YEARS + 95) % 100, 2);
+                }
+                putDigits(out + 10, blockAt(block), 7);
+            }
+            putDigits(out + 18, tail, 5);
+        }
     }
 
-    strcpy(keyout, fmt::format("{}{}-OEM-{}-{}", year, day, oem, oem).c_str());
+    return out + length + 1 - start;
+}
 
-    return 0;
-}
\ No newline at end of file
+const PIDGEN2::Layout &PIDGEN2::layout(PIDGEN2_KEY_TYPE type) {
+    // D is any digit, B a digit of the block, everything else has to match as is
+    auto build = [](const char *pattern) {
+        Layout l{};
+        l.length = (int)strlen(pattern);
+        l.words = (l.length + 7) / 8;
+
+        for (int w = 0, covered = 0; w < l.words; w++) {
+            l.offsets[w] = std::min(w * 8, l.length - 8);
+
+            BYTE literal[8] = {}, literalMask[8] = {}, digitMask[8] = {}, blockMask[8] = {};
+            for (int i = 0; i < 8; i++) {
+                int at = l.offsets[w] + i;
+                char c = pattern[at];
+
+                if (at < covered) {
+                    continue;
+                }
+
+                if (c == 'D' || c == 'B') {
+                    digitMask[i] = 0xFF;
+                    blockMask[i] = c == 'B' ? 0x0F : 0;
+                    l.blockEnd = c == 'B' ? at : l.blockEnd;
+                } else {
+                    literal[i] = (BYTE)c;
+                    literalMask[i] = 0xFF;
+                }
+            }
+            covered = l.offsets[w] + 8;
+
+            // loaded the same way as the keys, so the byte order doesn't matter
+            memcpy(&l.literal[w], literal, 8);
+            memcpy(&l.literalMask[w], literalMask, 8);
+            memcpy(&l.digitMask[w], digitMask, 8);
+            memcpy(&l.blockMask[w], blockMask, 8);
+        }
+
+        return l;
+    };
+
+    static const Layout retail = build("DDD-BBBBBBB");
+    static const Layout oem = build("DDDDD-OEM-0BBBBBB-DDDDD");
+
+    return type == PIDGEN2_OEM ? oem : retail;
+}
+
+/* Whether the length characters at key are a valid key of this type. */
+bool PIDGEN2::isValidKey(PIDGEN2_KEY_TYPE type, const char *key, size_t length) {
+    QWORD bitmap;
+    return length == (size_t)keyLength(type) && ValidateBatch(type, key, length, 1, &bitmap) == 1;
+}
+
+/*
+ * Checks count keys of this type, the first at keys and each next one stride bytes
+ * further, stride being at least keyLength(type). Bit i % 64 of bitmap[i / 64] is set
+ * for a valid key i, returns the number of valid keys.
+ *
+ * Each key is a few 64-bit loads: every byte is checked against the Layout in parallel,
+ * the block digits are summed with a single multiplication and only the site or date
+ * is looked at one number at a time.
+ */
+size_t PIDGEN2::ValidateBatch(PIDGEN2_KEY_TYPE type, const char *keys, size_t stride, size_t count, QWORD *bitmap) {
+    const Layout &l = layout(type);
+    const QWORD ones = 0x0101010101010101ULL;
+    size_t valid = 0;
+
+    for (size_t base = 0; base < count; base += 64) {
+        size_t batch = std::min(count - base, (size_t)64);
+        QWORD bits = 0;
+
+        for (size_t i = 0; i < batch; i++) {
+            const char *key = keys + (base + i) * stride;
+            QWORD bad = 0, sum = 0;
+
+            for (int w = 0; w < l.words; w++) {
+                QWORD word;
+                memcpy(&word, key + l.offsets[w], 8);
+
+                QWORD digits = word & l.digitMask[w];
+                bad |= (word ^ l.literal[w]) & l.literalMask[w];
+
+                // a digit is 0x3? with a low nibble that doesn't carry when adding 6
+                bad |= (digits ^ (ones * '0' & l.digitMask[w])) & (ones * 0xF0 & l.digitMask[w]);
+                bad |= ((digits & ones * 0x0F) + (ones * 0x06 & l.digitMask[w])) & ones * 0xF0;
+
+                // the top byte of the product is the sum of all bytes, at most 7 * 9
+                sum += ((word & l.blockMask[w]) * ones) >> 56;
+            }
+
+            char last = key[l.blockEnd];
+            bool ok = !bad && sum % 7 == 0 && last >= '1' && last <= '7';
+
+            if (type == PIDGEN2_RETAIL) {
+                ok = ok && !(key[0] == key[1] && key[1] == key[2] && key[0] >= '3');
+            } else {
+                ok = ok && isValidDate(parseDigits(key, 3), parseDigits(key + 3, 2));
+            }
+
+            bits |= (QWORD)ok << i;
+            valid += ok;
+        }
+
+        bitmap[base / 64] = bits;
+    }
+
+    return valid;
+}
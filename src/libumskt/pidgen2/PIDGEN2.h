@@ -25,17 +25,79 @@
 
 #include "../libumskt.h"
 
+#define PIDGEN2_RETAIL_LENGTH   11      // SSS-NNNNNNN
+#define PIDGEN2_OEM_LENGTH      23      // DDDYY-OEM-0NNNNNN-NNNNN
+#define PIDGEN2_SITES           993     // 000 to 999 without 333, 444, ..., 999
+#define PIDGEN2_BLOCKS          1000000 // one valid 7 digit block per 6 digit prefix
+#define PIDGEN2_OEM_BLOCKS      100000  // the ones starting with 0
+#define PIDGEN2_OEM_DAYS        366
+#define PIDGEN2_OEM_YEARS       9       // 95 to 99, 00 to 03
+#define PIDGEN2_OEM_TAILS       100000
+
+enum PIDGEN2_KEY_TYPE {
+    PIDGEN2_RETAIL = 0,
+    PIDGEN2_OEM    = 1,
+};
+
+/*
+ * Windows 95 era 10-digit keys.
+ *
+ * Retail keys are SSS-NNNNNNN, OEM keys DDDYY-OEM-0NNNNNN-NNNNN. In both the 7 digit
+ * block needs a digit sum divisible by 7 and a last digit of 1 to 7, retail sites can't
+ * be 333, 444, ..., 999 and OEM dates run from day 001 to 366 of 1995 to 2003.
+ *
+ * The last digit of a block is fixed by the other six, so block n is simply n followed
+ * by that digit. Every valid key then has an index in [0, keyspace), counting through
+ * sites or dates, blocks and tails, a random key is a random index and enumerating the
+ * keyspace is counting. No tables, no strings, only integer arithmetic.
+ *
+ * ValidateBatch checks fixed width records 8 bytes at a time (see Layout), the string
+ * helpers above it are the same checks for single NUL terminated fields.
+ */
 EXPORT class PIDGEN2 {
+    /*
+     * Byte masks of a key format, split into the 8 byte words the key is loaded as.
+     * The last word is moved back to end with the key, bytes that an earlier word
+     * already covers are masked out of it.
+     */
+    struct Layout {
+        int length, words, blockEnd;
+        int offsets[3];
+        QWORD literal[3], literalMask[3];   // the dashes, "OEM" and the 0 in front of an OEM block
+        QWORD digitMask[3];                 // 0xFF for every byte that has to be a digit
+        QWORD blockMask[3];                 // 0x0F for every digit of the 7 digit block
+    };
+
+    static const Layout &layout(PIDGEN2_KEY_TYPE type);
+    static DWORD blockAt(DWORD index);
+    static DWORD siteAt(DWORD index);
+    static DWORD parseDigits(const char *in, int width);
+    static char *putDigits(char *out, DWORD value, int width);
+
 public:
-    static bool isNumericString(char* input);
-    static bool isValidChannelID(char* channelID);
-    static bool isValidOEMID(char* OEMID);
-    static bool isValidYear(char* year);
-    static bool isValidDay(char* day);
-    static bool isValidRetailProductID(char* productID);
-    static int addDigits(char* input);
+    static bool isNumericString(const char* input);
+    static bool isValidChannelID(const char* channelID);
+    static bool isValidOEMID(const char* OEMID);
+    static bool isValidYear(const char* year);
+    static bool isValidDay(const char* day);
+    static bool isValidRetailProductID(const char* productID);
+    static int addDigits(const char* input);
     static int GenerateRetail(char* channelID, char* &keyout);
     static int GenerateOEM(char* year, char* day, char* oem, char* &keyout);
+
+    static bool isValidBlock(DWORD block);
+    static bool isValidSite(DWORD site);
+    static bool isValidDate(DWORD day, DWORD year);
+
+    static int keyLength(PIDGEN2_KEY_TYPE type);
+    static QWORD Keyspace(PIDGEN2_KEY_TYPE type);
+    static void FormatKey(PIDGEN2_KEY_TYPE type, QWORD index, char *out);
+    static void Generate(PIDGEN2_KEY_TYPE type, char *out);
+    static size_t Generate(PIDGEN2_KEY_TYPE type, size_t count, char *out, char terminator);
+    static size_t Enumerate(PIDGEN2_KEY_TYPE type, QWORD first, size_t count, char *out, char terminator);
+
+    static bool isValidKey(PIDGEN2_KEY_TYPE type, const char *key, size_t length);
+    static size_t ValidateBatch(PIDGEN2_KEY_TYPE type, const char *keys, size_t stride, size_t count, QWORD *bitmap);
 };
 
 #endif //UMSKT_PIDGEN2_H
@@ -28,6 +28,7 @@
  */
 
 #include "BINK1998.h"
+#include "../stats.h"
 
 /* Unpacks a Windows XP-like Product Key. */
 void PIDGEN3::BINK1998::Unpack(
@@ -77,10 +78,35 @@ bool PIDGEN3::BINK1998::Verify(
         EC_POINT *publicKey,
             char (&pKey)[25]
 ) {
+    BINKCurve curve(eCurve, basePoint, publicKey, nullptr, nullptr);
+
+    return Verify(curve, pKey);
+}
+
+/* Verifies a Windows XP-like Product Key against an initialized curve. */
+bool PIDGEN3::BINK1998::Verify(
+        const BINKCurve &curve,
+            char (&pKey)[25]
+) {
+    QWORD pRaw[2]{};
+
+    // Convert Base24 CD-key to bytecode.
+    PIDGEN3::unbase24((BYTE *)pRaw, pKey);
+
+    return Verify(curve, pRaw);
+}
+
+/* Verifies an already unpacked Windows XP-like Product Key, skipping the Base24 conversion. */
+bool PIDGEN3::BINK1998::Verify(
+        const BINKCurve &curve,
+           QWORD (&pRaw)[2]
+) {
+    GenerationStats::Clock clock(OP_BINK1998);
+
+    EC_GROUP *eCurve = curve.eCurve;
     BN_CTX *numContext = BN_CTX_new();
 
-    QWORD pRaw[2]{},
-          pSignature;
+    QWORD pSignature;
 
     DWORD pData,
           pSerial,
@@ -88,9 +114,6 @@ bool PIDGEN3::BINK1998::Verify(
 
     BOOL  pUpgrade;
 
-    // Convert Base24 CD-key to bytecode.
-    PIDGEN3::unbase24((BYTE *)pRaw, pKey);
-
     // Extract RPK, hash and signature from bytecode.
     Unpack(pRaw, pUpgrade, pSerial, pHash, pSignature);
 
@@ -128,10 +151,10 @@ bool PIDGEN3::BINK1998::Verify(
     EC_POINT *p = EC_POINT_new(eCurve);
 
     // t = sG
-    EC_POINT_mul(eCurve, t, nullptr, basePoint, s, numContext);
+    curve.mulGenerator(t, s, numContext);
 
     // P = eK
-    EC_POINT_mul(eCurve, p, nullptr, publicKey, e, numContext);
+    curve.mulPublic(p, e, numContext);
 
     // P += t
     EC_POINT_add(eCurve, p, t, p, numContext);
@@ -170,8 +193,15 @@ bool PIDGEN3::BINK1998::Verify(
     EC_POINT_free(t);
     EC_POINT_free(p);
 
+    clock.lap(PHASE_VERIFY);
+
     // If the computed hash checks out, the key is valid.
-    return compHash == pHash;
+    if (compHash != pHash) {
+        GenerationStats::reject(OP_BINK1998, REJECT_VERIFY_FAILED);
+        return false;
+    }
+
+    return true;
 }
 
 /* Generates a Windows XP-like Product Key. */
@@ -184,6 +214,43 @@ void PIDGEN3::BINK1998::Generate(
             BOOL pUpgrade,
             char (&pKey)[25]
 ) {
+    // Callers of this variant hand us the already negated private key (n - k).
+    BIGNUM *k = BN_new();
+    BN_sub(k, genOrder, privateKey);
+
+    BINKCurve curve(eCurve, basePoint, nullptr, genOrder, k);
+    Generate(curve, pSerial, pUpgrade, pKey);
+
+    BN_free(k);
+}
+
+/* Generates a Windows XP-like Product Key using an initialized curve. */
+void PIDGEN3::BINK1998::Generate(
+        const BINKCurve &curve,
+           DWORD pSerial,
+            BOOL pUpgrade,
+            char (&pKey)[25]
+) {
+    QWORD pRaw[2]{};
+
+    Generate(curve, pSerial, pUpgrade, pRaw);
+
+    GenerationStats::Clock clock(OP_BINK1998);
+
+    // Convert bytecode to Base24 CD-key.
+    base24(pKey, (BYTE *)pRaw);
+
+    clock.lap(PHASE_ENCODE);
+}
+
+/* Generates the packed 114-bit payload of a Windows XP-like Product Key. */
+void PIDGEN3::BINK1998::Generate(
+        const BINKCurve &curve,
+           DWORD pSerial,
+            BOOL pUpgrade,
+           QWORD (&pRaw)[2]
+) {
+    EC_GROUP *eCurve = curve.eCurve;
     BN_CTX *numContext = BN_CTX_new();
 
     BIGNUM *c = BN_new(),
@@ -191,25 +258,34 @@ void PIDGEN3::BINK1998::Generate(
            *x = BN_new(),
            *y = BN_new();
 
-    QWORD pRaw[2]{},
-          pSignature = 0;
+    QWORD pSignature = 0;
 
     // Data segment of the RPK.
     DWORD pData = pSerial << 1 | pUpgrade;
 
+    EC_POINT *r = EC_POINT_new(eCurve);
+
+    GenerationStats::Clock clock(OP_BINK1998);
+    QWORD attempts = 0;
+
     do {
-        EC_POINT *r = EC_POINT_new(eCurve);
+        if (attempts++) {
+            GenerationStats::reject(OP_BINK1998, REJECT_SIGNATURE_LENGTH);
+        }
+        GenerationStats::attempt(OP_BINK1998);
 
         // Generate a random number c consisting of 384 bits without any constraints.
         UMSKT::umskt_bn_rand(c, FIELD_BITS, BN_RAND_TOP_ANY, BN_RAND_BOTTOM_ANY);
+        clock.lap(PHASE_NONCE);
 
         // Pick a random derivative of the base point on the elliptic curve.
         // R = cG;
-        EC_POINT_mul(eCurve, r, nullptr, basePoint, c, numContext);
+        curve.mulGenerator(r, c, numContext);
 
         // Acquire its coordinates.
         // x = R.x; y = R.y;
         EC_POINT_get_affine_coordinates(eCurve, r, x, y, numContext);
+        clock.lap(PHASE_SCALAR_MUL);
 
         BYTE    msgDigest[SHA_DIGEST_LENGTH]{},
                 msgBuffer[SHA_MSG_LENGTH_XP]{},
@@ -231,6 +307,7 @@ void PIDGEN3::BINK1998::Generate(
         // Translate the byte digest into a 32-bit integer - this is our computed pHash.
         // Truncate the pHash to 28 bits.
         DWORD pHash = BYDWORD(msgDigest) >> 4 & BITMASK(28);
+        clock.lap(PHASE_HASH);
 
         /*
          *
@@ -248,15 +325,15 @@ void PIDGEN3::BINK1998::Generate(
          *
          * We need to find the signature s that satisfies the equation with a given hash:
          *  P = sG + eK
-         *  s = ek + c (mod n) <- computation optimization
+         *  s = c - ek (mod n) <- computation optimization
          */
 
         // s = ek;
-        BN_copy(s, privateKey);
+        BN_copy(s, curve.privateKey);
         BN_mul_word(s, pHash);
 
-        // s += c (mod n)
-        BN_mod_add(s, s, c, genOrder, numContext);
+        // s = c - s (mod n)
+        BN_mod_sub(s, c, s, curve.genOrder, numContext);
 
         // Translate resulting scalar into a 64-bit integer (the byte order is little-endian).
         BN_bn2lebinpad(s, (BYTE *)&pSignature, BN_num_bytes(s));
@@ -270,15 +347,15 @@ void PIDGEN3::BINK1998::Generate(
         fmt::print(UMSKT::debug, "      Hash: 0x{:08x}\n", pHash);
         fmt::print(UMSKT::debug, " Signature: 0x{:08x}\n", pSignature);
         fmt::print(UMSKT::debug, "\n");
-
-        EC_POINT_free(r);
+        clock.lap(PHASE_SIGN);
     } while (pSignature > BITMASK(55));
     // ↑ ↑ ↑
     // The signature can't be longer than 55 bits, else it will
     // make the CD-key longer than 25 characters.
 
-    // Convert bytecode to Base24 CD-key.
-    base24(pKey, (BYTE *)pRaw);
+    GenerationStats::complete(OP_BINK1998, attempts);
+
+    EC_POINT_free(r);
 
     BN_free(c);
     BN_free(s);
@@ -24,6 +24,7 @@
 #define UMSKT_BINK1998_H
 
 #include "PIDGEN3.h"
+#include "CurveRegistry.h"
 
 EXPORT class PIDGEN3::BINK1998 {
 public:
@@ -50,6 +51,16 @@ public:
                 char (&pKey)[25]
     );
 
+    static bool Verify(
+            const BINKCurve &curve,
+                char (&pKey)[25]
+    );
+
+    static bool Verify(
+            const BINKCurve &curve,
+               QWORD (&pRaw)[2]
+    );
+
     static void Generate(
             EC_GROUP *eCurve,
             EC_POINT *basePoint,
@@ -59,6 +70,20 @@ public:
                 BOOL pUpgrade,
                 char (&pKey)[25]
     );
+
+    static void Generate(
+            const BINKCurve &curve,
+               DWORD pSerial,
+                BOOL pUpgrade,
+                char (&pKey)[25]
+    );
+
+    static void Generate(
+            const BINKCurve &curve,
+               DWORD pSerial,
+                BOOL pUpgrade,
+               QWORD (&pRaw)[2]
+    );
 };
 
 #endif //UMSKT_BINK1998_H
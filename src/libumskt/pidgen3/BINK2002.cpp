@@ -28,6 +28,7 @@
  */
 
 #include "BINK2002.h"
+#include "../stats.h"
 
 /* Unpacks a Windows Server 2003-like Product Key. */
 void PIDGEN3::BINK2002::Unpack(
@@ -81,10 +82,37 @@ bool PIDGEN3::BINK2002::Verify(
            DWORD *pSerial,
             char (&cdKey)[25]
 ) {
+    BINKCurve curve(eCurve, basePoint, publicKey, nullptr, nullptr);
+
+    return Verify(curve, pSerial, cdKey);
+}
+
+/* Verifies a Windows Server 2003-like Product Key against an initialized curve. */
+bool PIDGEN3::BINK2002::Verify(
+        const BINKCurve &curve,
+           DWORD *pSerial,
+            char (&cdKey)[25]
+) {
+    QWORD bKey[2]{};
+
+    // Convert Base24 CD-key to bytecode.
+    unbase24((BYTE *)bKey, cdKey);
+
+    return Verify(curve, pSerial, bKey);
+}
+
+/* Verifies an already unpacked Windows Server 2003-like Product Key, skipping the Base24 conversion. */
+bool PIDGEN3::BINK2002::Verify(
+        const BINKCurve &curve,
+           DWORD *pSerial,
+           QWORD (&bKey)[2]
+) {
+    GenerationStats::Clock clock(OP_BINK2002);
+
+    EC_GROUP *eCurve = curve.eCurve;
     BN_CTX *context = BN_CTX_new();
 
-    QWORD bKey[2]{},
-          pSignature = 0;
+    QWORD pSignature = 0;
 
     DWORD pData,
           pChannelID,
@@ -93,9 +121,6 @@ bool PIDGEN3::BINK2002::Verify(
 
     BOOL  pUpgrade;
 
-    // Convert Base24 CD-key to bytecode.
-    unbase24((BYTE *)bKey, cdKey);
-
     // Extract product key segments from bytecode.
     Unpack(bKey, pUpgrade, pChannelID, pHash, pSignature, pAuthInfo);
 
@@ -151,16 +176,16 @@ bool PIDGEN3::BINK2002::Verify(
     EC_POINT *t = EC_POINT_new(eCurve);
 
     // t = sG
-    EC_POINT_mul(eCurve, t, nullptr, basePoint, s, context);
+    curve.mulGenerator(t, s, context);
 
     // p = eK
-    EC_POINT_mul(eCurve, p, nullptr, publicKey, e, context);
+    curve.mulPublic(p, e, context);
 
     // p += t
     EC_POINT_add(eCurve, p, t, p, context);
 
-    // p *= s
-    EC_POINT_mul(eCurve, p, nullptr, p, s, context);
+    // p *= s, p = sG + eK is in the subgroup generated by G so the endomorphism applies
+    curve.mulEndomorphism(p, p, s, context);
 
     // x = p.x; y = p.y;
     EC_POINT_get_affine_coordinates(eCurve, p, x, y, context);
@@ -206,8 +231,15 @@ bool PIDGEN3::BINK2002::Verify(
     EC_POINT_free(p);
     EC_POINT_free(t);
 
+    clock.lap(PHASE_VERIFY);
+
     // If the computed hash checks out, the key is valid.
-    return compHash == pHash;
+    if (compHash != pHash) {
+        GenerationStats::reject(OP_BINK2002, REJECT_VERIFY_FAILED);
+        return false;
+    }
+
+    return true;
 }
 
 /* Generates a Windows Server 2003-like Product Key. */
@@ -223,6 +255,50 @@ void PIDGEN3::BINK2002::Generate(
            DWORD serMax,
             char (&pKey)[25]
 ) {
+    BINKCurve curve(eCurve, basePoint, nullptr, genOrder, privateKey);
+
+    Generate(curve, pChannelID, pAuthInfo, pUpgrade, serMin, serMax, pKey);
+}
+
+/* Generates a Windows Server 2003-like Product Key using an initialized curve. */
+void PIDGEN3::BINK2002::Generate(
+        const BINKCurve &curve,
+           DWORD pChannelID,
+           DWORD pAuthInfo,
+            BOOL pUpgrade,
+           DWORD serMin,
+           DWORD serMax,
+            char (&pKey)[25]
+) {
+    QWORD pRaw[2]{};
+
+    Generate(curve, pChannelID, pAuthInfo, pUpgrade, serMin, serMax, nullptr, pRaw);
+
+    GenerationStats::Clock clock(OP_BINK2002);
+
+    // Convert bytecode to Base24 CD-key.
+    base24(pKey, (BYTE *)pRaw);
+
+    clock.lap(PHASE_ENCODE);
+}
+
+/*
+ * Generates the packed 114-bit payload of a Windows Server 2003-like Product Key, optionally returning its serial.
+ * The cancel flag is checked before every attempt, so other threads can call off a search that somebody else already won.
+ */
+bool PIDGEN3::BINK2002::Generate(
+        const BINKCurve &curve,
+           DWORD pChannelID,
+           DWORD pAuthInfo,
+            BOOL pUpgrade,
+           DWORD serMin,
+           DWORD serMax,
+           DWORD *pSerial,
+           QWORD (&pRaw)[2],
+        const std::atomic<bool> *cancel
+) {
+    EC_GROUP *eCurve = curve.eCurve;
+    BIGNUM *genOrder = curve.genOrder;
     BN_CTX *numContext = BN_CTX_new();
 
     BIGNUM *c = BN_new(),
@@ -231,8 +307,7 @@ void PIDGEN3::BINK2002::Generate(
            *x = BN_new(),
            *y = BN_new();
 
-    QWORD pRaw[2]{},
-          pSignature = 0;
+    QWORD pSignature = 0;
 
     // Data segment of the RPK.
     DWORD pData = pChannelID << 1 | pUpgrade;
@@ -240,18 +315,32 @@ void PIDGEN3::BINK2002::Generate(
     BOOL noSquare;
     BOOL serialInRange;
 
+    EC_POINT *r = EC_POINT_new(eCurve);
+
+    GenerationStats::Clock clock(OP_BINK2002);
+    QWORD attempts = 0;
+    bool cancelled = false;
+
     do {
-        EC_POINT *r = EC_POINT_new(eCurve);
+        if (cancel != nullptr && cancel->load(std::memory_order_relaxed)) {
+            cancelled = true;
+            break;
+        }
+
+        attempts++;
+        GenerationStats::attempt(OP_BINK2002);
 
         // Generate a random number c consisting of 512 bits without any constraints.
         UMSKT::umskt_bn_rand(c, FIELD_BITS_2003, BN_RAND_TOP_ANY, BN_RAND_BOTTOM_ANY);
+        clock.lap(PHASE_NONCE);
 
         // R = cG
-        EC_POINT_mul(eCurve, r, nullptr, basePoint, c, numContext);
+        curve.mulGenerator(r, c, numContext);
 
         // Acquire its coordinates.
         // x = R.x; y = R.y;
         EC_POINT_get_affine_coordinates(eCurve, r, x, y, numContext);
+        clock.lap(PHASE_SCALAR_MUL);
 
         BYTE    msgDigest[SHA_DIGEST_LENGTH]{},
                 msgBuffer[SHA_MSG_LENGTH_2003]{},
@@ -278,7 +367,14 @@ void PIDGEN3::BINK2002::Generate(
 
         DWORD serial = (((BYDWORD(msgDigest + 4) >> 13) << 1) | (BYDWORD(msgDigest) >> 31)) & BITMASK(20);
         serialInRange = (serial >= serMin) && (serial <= serMax);
-        if (!serialInRange) continue;
+        clock.lap(PHASE_HASH);
+
+        if (!serialInRange) {
+            GenerationStats::reject(OP_BINK2002, REJECT_SERIAL_RANGE);
+            continue;
+        }
+
+        if (pSerial != nullptr) *pSerial = serial;
 
         // Translate the byte digest into a 32-bit integer - this is our computed hash.
         // Truncate the hash to 31 bits.
@@ -306,6 +402,7 @@ void PIDGEN3::BINK2002::Generate(
         QWORD iSignature = NEXTSNBITS(BYDWORD(&msgDigest[4]), 30, 2) << 32 | BYDWORD(msgDigest);
 
         BN_lebin2bn((BYTE *)&iSignature, sizeof(iSignature), e);
+        clock.lap(PHASE_HASH);
 
         /*
          *
@@ -337,7 +434,7 @@ void PIDGEN3::BINK2002::Generate(
          */
 
         // e = ek (mod n)
-        BN_mod_mul(e, e, privateKey, genOrder, numContext);
+        BN_mod_mul(e, e, curve.privateKey, genOrder, numContext);
 
         // s = e
         BN_copy(s, e);
@@ -350,11 +447,13 @@ void PIDGEN3::BINK2002::Generate(
 
         // s += c
         BN_add(s, s, c);
+        clock.lap(PHASE_SIGN);
 
         // Around half of numbers modulo a prime are not squares -> BN_sqrt_mod fails about half of the times,
         // hence if BN_sqrt_mod returns NULL, we need to restart with a different seed.
         // s = √((ek)² + 4c (mod n))
         noSquare = BN_mod_sqrt(s, s, genOrder, numContext) == nullptr;
+        clock.lap(PHASE_SQRT);
 
         // s = -ek + √((ek)² + 4c) (mod n)
         BN_mod_sub(s, s, e, genOrder, numContext);
@@ -375,6 +474,12 @@ void PIDGEN3::BINK2002::Generate(
         // Pack product key.
         Pack(pRaw, pUpgrade, pChannelID, pHash, pSignature, pAuthInfo);
 
+        if (noSquare) {
+            GenerationStats::reject(OP_BINK2002, REJECT_NO_SQUARE);
+        } else if (pSignature > BITMASK(62)) {
+            GenerationStats::reject(OP_BINK2002, REJECT_SIGNATURE_LENGTH);
+        }
+
         fmt::print(UMSKT::debug, "Generation results:\n");
         fmt::print(UMSKT::debug, "   Upgrade: 0x{:08x}\n", pUpgrade);
         fmt::print(UMSKT::debug, "Channel ID: 0x{:08x}\n", pChannelID);
@@ -383,15 +488,17 @@ void PIDGEN3::BINK2002::Generate(
         fmt::print(UMSKT::debug, "  AuthInfo: 0x{:08x}\n", pAuthInfo);
         fmt::print(UMSKT::debug, "    Serial: {:06d}\n", serial);
         fmt::print(UMSKT::debug, "\n");
-
-        EC_POINT_free(r);
+        clock.lap(PHASE_SIGN);
     } while (pSignature > BITMASK(62) || noSquare || !serialInRange);
     // ↑ ↑ ↑
     // The signature can't be longer than 62 bits, else it will
     // overlap with the AuthInfo segment next to it.
 
-    // Convert bytecode to Base24 CD-key.
-    base24(pKey, (BYTE *)pRaw);
+    if (!cancelled) {
+        GenerationStats::complete(OP_BINK2002, attempts);
+    }
+
+    EC_POINT_free(r);
 
     BN_free(c);
     BN_free(s);
@@ -400,4 +507,6 @@ void PIDGEN3::BINK2002::Generate(
     BN_free(e);
 
     BN_CTX_free(numContext);
+
+    return !cancelled;
 }
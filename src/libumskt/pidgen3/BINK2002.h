@@ -24,6 +24,9 @@
 #define UMSKT_BINK2002_H
 
 #include "PIDGEN3.h"
+#include "CurveRegistry.h"
+
+#include <atomic>
 
 EXPORT class PIDGEN3::BINK2002 {
 public:
@@ -53,6 +56,18 @@ public:
                 char (&cdKey)[25]
     );
 
+    static bool Verify(
+            const BINKCurve &curve,
+               DWORD *pSerial,
+                char (&cdKey)[25]
+    );
+
+    static bool Verify(
+            const BINKCurve &curve,
+               DWORD *pSerial,
+               QWORD (&pRaw)[2]
+    );
+
     static void Generate(
             EC_GROUP *eCurve,
             EC_POINT *basePoint,
@@ -65,6 +80,29 @@ public:
                DWORD serMax,
                 char (&pKey)[25]
     );
+
+    static void Generate(
+            const BINKCurve &curve,
+               DWORD pChannelID,
+               DWORD pAuthInfo,
+                BOOL pUpgrade,
+               DWORD serMin,
+               DWORD serMax,
+                char (&pKey)[25]
+    );
+
+    // returns false without a key once cancel gets set, see KeyPipeline::searchKey
+    static bool Generate(
+            const BINKCurve &curve,
+               DWORD pChannelID,
+               DWORD pAuthInfo,
+                BOOL pUpgrade,
+               DWORD serMin,
+               DWORD serMax,
+               DWORD *pSerial,
+               QWORD (&pRaw)[2],
+            const std::atomic<bool> *cancel = nullptr
+    );
 };
 
 #endif //UMSKT_BINK2002_H
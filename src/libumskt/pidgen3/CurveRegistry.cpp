@@ -0,0 +1,561 @@
+/**
+ * This file is a part of the UMSKT Project
+ *
+ * Copyleft (C) 2019-2023 UMSKT Contributors (et.al.)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @FileCreated by Neo on 10/18/2026
+ * @Maintainer Neo
+ */
+
+#include "CurveRegistry.h"
+
+#include <algorithm>
+#include <map>
+#include <memory>
+
+#if UMSKT_THREADS
+#include <mutex>
+#include <thread>
+#endif
+
+/* Wraps already initialized curve objects, the caller keeps ownership. */
+PIDGEN3::BINKCurve::BINKCurve(
+        EC_GROUP *eCurve,
+        EC_POINT *genPoint,
+        EC_POINT *pubPoint,
+          BIGNUM *genOrder,
+          BIGNUM *privateKey
+) : owner(false), fieldPrime(nullptr), endoBeta(nullptr), endoLambda(nullptr), endoA(nullptr), endoB(nullptr),
+    eCurve(eCurve), genPoint(genPoint), pubPoint(pubPoint), genOrder(genOrder), privateKey(privateKey) {
+}
+
+/* Initializes a BINK curve from its parameters and precomputes the generator table and the endomorphism. */
+PIDGEN3::BINKCurve::BINKCurve(const BINKParams &params) :
+    owner(true), fieldPrime(nullptr), endoBeta(nullptr), endoLambda(nullptr), endoA(nullptr), endoB(nullptr) {
+    eCurve = initializeEllipticCurve(
+            params.p,
+            params.a,
+            params.b,
+            params.generatorX,
+            params.generatorY,
+            params.publicKeyX,
+            params.publicKeyY,
+            genPoint,
+            pubPoint
+    );
+
+    genOrder = BN_new();
+    privateKey = BN_new();
+
+    BN_dec2bn(&genOrder, params.genOrder.c_str());
+    BN_dec2bn(&privateKey, params.privateKey.c_str());
+
+    // Every scalar we multiply G by is reduced modulo its order first, so the table
+    // only has to cover as many bits as the order has (56 for BINK1998, 63 for BINK2002).
+    int windows = (BN_num_bits(genOrder) + BINK_COMB_WIDTH - 1) / BINK_COMB_WIDTH;
+
+    BN_CTX *context = BN_CTX_new();
+    BIGNUM *x = BN_new(),
+           *y = BN_new();
+
+    EC_POINT *base = EC_POINT_dup(genPoint, eCurve);
+
+    genTable.reserve(windows * BINK_COMB_POINTS);
+
+    for (int i = 0; i < windows; i++) {
+        // row i = { 1, 2, ..., 15 } * 16^i * G
+        for (int j = 1; j <= BINK_COMB_POINTS; j++) {
+            EC_POINT *cur = EC_POINT_dup(j == 1 ? base : genTable.back(), eCurve);
+
+            if (j > 1) {
+                EC_POINT_add(eCurve, cur, cur, base, context);
+            }
+
+            // Normalize to Z = 1 so the lookups below take the cheaper mixed addition path.
+            EC_POINT_get_affine_coordinates(eCurve, cur, x, y, context);
+            EC_POINT_set_affine_coordinates(eCurve, cur, x, y, context);
+
+            genTable.push_back(cur);
+        }
+
+        // base = 16^(i + 1) * G
+        EC_POINT_add(eCurve, base, genTable.back(), base, context);
+    }
+
+    EC_POINT_free(base);
+    BN_free(x);
+    BN_free(y);
+
+    initEndomorphism(context);
+
+    BN_CTX_free(context);
+}
+
+PIDGEN3::BINKCurve::~BINKCurve() {
+    for (EC_POINT *point : genTable) {
+        EC_POINT_free(point);
+    }
+
+    for (EC_POINT *point : pubTable) {
+        EC_POINT_free(point);
+    }
+
+    BN_free(fieldPrime);
+    BN_free(endoBeta);
+    BN_free(endoLambda);
+    BN_free(endoA);
+    BN_free(endoB);
+
+    if (!owner) {
+        return;
+    }
+
+    EC_POINT_free(genPoint);
+    EC_POINT_free(pubPoint);
+    EC_GROUP_free(eCurve);
+    BN_free(genOrder);
+    BN_free(privateKey);
+}
+
+/* r = kG, using the precomputed table when we have one. */
+int PIDGEN3::BINKCurve::mulGenerator(EC_POINT *r, const BIGNUM *k, BN_CTX *ctx) const {
+    if (genOrder == nullptr) {
+        return EC_POINT_mul(eCurve, r, nullptr, genPoint, k, ctx);
+    }
+
+    BN_CTX_start(ctx);
+    BIGNUM *kReduced = BN_CTX_get(ctx);
+
+    // G has order n, so kG = (k mod n)G - this turns a 384/512-bit multiplication into a 56/63-bit one.
+    if (kReduced == nullptr || !BN_nnmod(kReduced, k, genOrder, ctx)) {
+        BN_CTX_end(ctx);
+        return 0;
+    }
+
+    if (genTable.empty()) {
+        int result = EC_POINT_mul(eCurve, r, nullptr, genPoint, kReduced, ctx);
+        BN_CTX_end(ctx);
+        return result;
+    }
+
+    EC_POINT_set_to_infinity(eCurve, r);
+
+    int windows = (int)genTable.size() / BINK_COMB_POINTS;
+
+    for (int i = 0; i < windows; i++) {
+        int digit = 0;
+
+        for (int bit = BINK_COMB_WIDTH - 1; bit >= 0; bit--) {
+            digit = digit << 1 | BN_is_bit_set(kReduced, i * BINK_COMB_WIDTH + bit);
+        }
+
+        if (digit) {
+            EC_POINT_add(eCurve, r, r, genTable[i * BINK_COMB_POINTS + digit - 1], ctx);
+        }
+    }
+
+    BN_CTX_end(ctx);
+    return 1;
+}
+
+/*
+ * Finds beta, lambda and the lattice basis described in the header, then checks the whole
+ * thing against plain EC_POINT_mul. Leaves everything unset if any of it doesn't hold.
+ */
+bool PIDGEN3::BINKCurve::initEndomorphism(BN_CTX *ctx) {
+    BN_CTX_start(ctx);
+    BIGNUM *a  = BN_CTX_get(ctx),
+           *b  = BN_CTX_get(ctx),
+           *x  = BN_CTX_get(ctx),
+           *y  = BN_CTX_get(ctx),
+           *q  = BN_CTX_get(ctx),
+           *r0 = BN_CTX_get(ctx),
+           *r1 = BN_CTX_get(ctx),
+           *t0 = BN_CTX_get(ctx),
+           *t1 = BN_CTX_get(ctx);
+
+    fieldPrime = BN_new();
+    endoBeta = BN_new();
+    endoLambda = BN_new();
+    endoA = BN_new();
+    endoB = BN_new();
+
+    EC_POINT *phi = EC_POINT_new(eCurve),
+             *mul = EC_POINT_new(eCurve);
+
+    bool ok = t1 != nullptr && phi != nullptr && mul != nullptr
+           && EC_GROUP_get_curve(eCurve, fieldPrime, a, b, ctx)
+           && BN_is_one(a) && BN_is_zero(b)
+           && BN_mod_word(fieldPrime, 4) == 1 && BN_mod_word(genOrder, 4) == 1;
+
+    // beta = sqrt(-1) mod p, lambda = sqrt(-1) mod n
+    ok = ok && BN_sub(q, fieldPrime, BN_value_one()) && BN_mod_sqrt(endoBeta, q, fieldPrime, ctx) != nullptr
+            && BN_sub(q, genOrder, BN_value_one()) && BN_mod_sqrt(endoLambda, q, genOrder, ctx) != nullptr;
+
+    // Of the two square roots of -1 mod n only one matches our beta, phi(G) = lambda G tells which.
+    ok = ok && EC_POINT_get_affine_coordinates(eCurve, genPoint, x, y, ctx)
+            && applyEndomorphism(phi, x, y, false, ctx)
+            && EC_POINT_mul(eCurve, mul, nullptr, genPoint, endoLambda, ctx);
+
+    if (ok && EC_POINT_cmp(eCurve, phi, mul, ctx) != 0) {
+        ok = BN_sub(endoLambda, genOrder, endoLambda)
+          && EC_POINT_mul(eCurve, mul, nullptr, genPoint, endoLambda, ctx)
+          && EC_POINT_cmp(eCurve, phi, mul, ctx) == 0;
+    }
+
+    // Extended Euclid on (n, lambda) up to the first remainder below sqrt(n). Every step keeps
+    // r = t * lambda (mod n), so (r, -t) is a short lattice vector, and as lambda^2 = -1 the
+    // lattice is square: (a, b) and (-b, a) form a basis exactly when a^2 + b^2 = n.
+    ok = ok && BN_copy(r0, genOrder) && BN_copy(r1, endoLambda) && BN_one(t1);
+    BN_zero(t0);
+
+    while (ok && BN_sqr(q, r1, ctx) && BN_cmp(q, genOrder) >= 0) {
+        ok = BN_div(q, r0, r0, r1, ctx)
+          && BN_mul(a, q, t1, ctx) && BN_sub(t0, t0, a);
+
+        std::swap(r0, r1);
+        std::swap(t0, t1);
+    }
+
+    ok = ok && BN_copy(endoA, r1) && BN_copy(endoB, t1);
+    BN_set_negative(endoB, !BN_is_negative(endoB));
+
+    ok = ok && BN_sqr(a, endoA, ctx) && BN_sqr(b, endoB, ctx) && BN_add(a, a, b) && BN_cmp(a, genOrder) == 0;
+
+    // The public key table is only usable if K is in the subgroup generated by G.
+    ok = ok && EC_POINT_mul(eCurve, mul, nullptr, pubPoint, genOrder, ctx) && EC_POINT_is_at_infinity(eCurve, mul)
+            && EC_POINT_get_affine_coordinates(eCurve, pubPoint, x, y, ctx);
+
+    for (int i = 0; ok && i < 2 * BINK_ENDO_POINTS; i++) {
+        EC_POINT *point = EC_POINT_new(eCurve);
+        pubTable.push_back(point);
+
+        switch (i % BINK_ENDO_POINTS) {
+            case 0:
+                ok = point != nullptr && EC_POINT_set_affine_coordinates(eCurve, point, x, y, ctx);
+                break;
+            case 1:
+                ok = point != nullptr && applyEndomorphism(point, x, y, i >= BINK_ENDO_POINTS, ctx);
+                break;
+            default:
+                ok = point != nullptr && EC_POINT_add(eCurve, point, pubTable[i - 2], pubTable[i - 1], ctx)
+                  && EC_POINT_get_affine_coordinates(eCurve, point, a, b, ctx)
+                  && EC_POINT_set_affine_coordinates(eCurve, point, a, b, ctx);
+                break;
+        }
+    }
+
+    // Last line of defense, both paths have to agree with OpenSSL on an actual full length scalar.
+    ok = ok && BN_sub(q, genOrder, BN_value_one()) && BN_sub(q, q, privateKey)
+            && mulPublic(phi, q, ctx) && EC_POINT_mul(eCurve, mul, nullptr, pubPoint, q, ctx)
+            && EC_POINT_cmp(eCurve, phi, mul, ctx) == 0
+            && mulEndomorphism(phi, genPoint, q, ctx) && EC_POINT_mul(eCurve, mul, nullptr, genPoint, q, ctx)
+            && EC_POINT_cmp(eCurve, phi, mul, ctx) == 0;
+
+    if (!ok) {
+        for (EC_POINT *point : pubTable) {
+            EC_POINT_free(point);
+        }
+        pubTable.clear();
+
+        BN_free(fieldPrime);
+        BN_free(endoBeta);
+        BN_free(endoLambda);
+        BN_free(endoA);
+        BN_free(endoB);
+
+        fieldPrime = endoBeta = endoLambda = endoA = endoB = nullptr;
+    }
+
+    EC_POINT_free(phi);
+    EC_POINT_free(mul);
+    BN_CTX_end(ctx);
+
+    return ok;
+}
+
+/* r = phi(x, y) = (-x, beta * y), or -phi(x, y) when negate is set. */
+int PIDGEN3::BINKCurve::applyEndomorphism(EC_POINT *r, const BIGNUM *x, const BIGNUM *y, bool negate, BN_CTX *ctx) const {
+    BN_CTX_start(ctx);
+    BIGNUM *px = BN_CTX_get(ctx),
+           *py = BN_CTX_get(ctx);
+
+    int result = py != nullptr
+            && BN_mod_sub(px, fieldPrime, x, fieldPrime, ctx)
+            && BN_mod_mul(py, y, endoBeta, fieldPrime, ctx)
+            && (!negate || BN_mod_sub(py, fieldPrime, py, fieldPrime, ctx))
+            && EC_POINT_set_affine_coordinates(eCurve, r, px, py, ctx);
+
+    BN_CTX_end(ctx);
+    return result;
+}
+
+namespace {
+    /* r = round(k * m / n) for k, n >= 0, negated when negate is set. */
+    int mulRound(BIGNUM *r, const BIGNUM *k, const BIGNUM *m, bool negate, const BIGNUM *n, const BIGNUM *half, BN_CTX *ctx) {
+        if (!BN_mul(r, k, m, ctx)) {
+            return 0;
+        }
+
+        bool negative = BN_is_negative(r) != negate;
+        BN_set_negative(r, 0);
+
+        if (!BN_add(r, r, half) || !BN_div(r, nullptr, r, n, ctx)) {
+            return 0;
+        }
+
+        BN_set_negative(r, negative);
+        return 1;
+    }
+}
+
+/*
+ * Splits k into k1 + k2 * lambda (mod n) with |k1|, |k2| around sqrt(n), by subtracting
+ * the lattice vector closest to (k, 0). Both halves come out signed.
+ */
+int PIDGEN3::BINKCurve::splitScalar(BIGNUM *k1, BIGNUM *k2, const BIGNUM *k, BN_CTX *ctx) const {
+    BN_CTX_start(ctx);
+    BIGNUM *kReduced = BN_CTX_get(ctx),
+           *half = BN_CTX_get(ctx),
+           *c1 = BN_CTX_get(ctx),
+           *c2 = BN_CTX_get(ctx),
+           *t = BN_CTX_get(ctx);
+
+    // (c1, c2) = round((k, 0) * basis^-1), the basis has determinant n
+    int result = t != nullptr
+            && BN_nnmod(kReduced, k, genOrder, ctx)
+            && BN_rshift1(half, genOrder)
+            && mulRound(c1, kReduced, endoA, false, genOrder, half, ctx)
+            && mulRound(c2, kReduced, endoB, true, genOrder, half, ctx);
+
+    // k1 = k - c1 * a + c2 * b, k2 = -(c1 * b + c2 * a)
+    result = result
+            && BN_mul(t, c1, endoA, ctx) && BN_sub(k1, kReduced, t)
+            && BN_mul(t, c2, endoB, ctx) && BN_add(k1, k1, t)
+            && BN_mul(k2, c1, endoB, ctx) && BN_mul(t, c2, endoA, ctx) && BN_add(k2, k2, t);
+
+    if (result) {
+        BN_set_negative(k2, !BN_is_negative(k2));
+    }
+
+    BN_CTX_end(ctx);
+    return result;
+}
+
+/* r = k1 table[0] + k2 table[1] for k1, k2 >= 0, table[2] has to be table[0] + table[1]. */
+int PIDGEN3::BINKCurve::mulJoint(EC_POINT *r, EC_POINT *const *table, const BIGNUM *k1, const BIGNUM *k2, BN_CTX *ctx) const {
+    EC_POINT_set_to_infinity(eCurve, r);
+
+    // Shamir's trick, one shared doubling per bit of the longer half.
+    for (int i = std::max(BN_num_bits(k1), BN_num_bits(k2)) - 1; i >= 0; i--) {
+        if (!EC_POINT_dbl(eCurve, r, r, ctx)) {
+            return 0;
+        }
+
+        int digit = BN_is_bit_set(k1, i) | BN_is_bit_set(k2, i) << 1;
+
+        if (digit && !EC_POINT_add(eCurve, r, r, table[digit - 1], ctx)) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/* r = kK, using the endomorphism and the precomputed public key table when we have them. */
+int PIDGEN3::BINKCurve::mulPublic(EC_POINT *r, const BIGNUM *k, BN_CTX *ctx) const {
+    if (pubTable.empty()) {
+        return EC_POINT_mul(eCurve, r, nullptr, pubPoint, k, ctx);
+    }
+
+    BN_CTX_start(ctx);
+    BIGNUM *k1 = BN_CTX_get(ctx),
+           *k2 = BN_CTX_get(ctx);
+
+    int result = k2 != nullptr && splitScalar(k1, k2, k, ctx);
+
+    // k1 K + k2 phi(K) = +-(|k1| K +- |k2| phi(K)), the second half of the table carries -phi(K).
+    bool negate = BN_is_negative(k1),
+         mixed = BN_is_negative(k1) != BN_is_negative(k2);
+
+    BN_set_negative(k1, 0);
+    BN_set_negative(k2, 0);
+
+    result = result
+            && mulJoint(r, &pubTable[mixed ? BINK_ENDO_POINTS : 0], k1, k2, ctx)
+            && (!negate || EC_POINT_invert(eCurve, r, ctx));
+
+    BN_CTX_end(ctx);
+    return result;
+}
+
+/* r = kP for any P in the subgroup generated by G, via the endomorphism when we have it. */
+int PIDGEN3::BINKCurve::mulEndomorphism(EC_POINT *r, const EC_POINT *point, const BIGNUM *k, BN_CTX *ctx) const {
+    if (!hasEndomorphism()) {
+        return EC_POINT_mul(eCurve, r, nullptr, point, k, ctx);
+    }
+
+    if (EC_POINT_is_at_infinity(eCurve, point)) {
+        return EC_POINT_set_to_infinity(eCurve, r);
+    }
+
+    BN_CTX_start(ctx);
+    BIGNUM *k1 = BN_CTX_get(ctx),
+           *k2 = BN_CTX_get(ctx),
+           *x = BN_CTX_get(ctx),
+           *y = BN_CTX_get(ctx);
+
+    EC_POINT *table[BINK_ENDO_POINTS] = {
+            EC_POINT_new(eCurve),
+            EC_POINT_new(eCurve),
+            EC_POINT_new(eCurve),
+    };
+
+    int result = y != nullptr && table[0] != nullptr && table[1] != nullptr && table[2] != nullptr
+            && splitScalar(k1, k2, k, ctx);
+
+    // Same sign juggling as in mulPublic, except the table is built on the spot.
+    bool negate = BN_is_negative(k1),
+         mixed = BN_is_negative(k1) != BN_is_negative(k2);
+
+    BN_set_negative(k1, 0);
+    BN_set_negative(k2, 0);
+
+    // phi needs affine coordinates, one inversion here buys back half of the doublings
+    result = result
+            && EC_POINT_get_affine_coordinates(eCurve, point, x, y, ctx)
+            && EC_POINT_set_affine_coordinates(eCurve, table[0], x, y, ctx)
+            && applyEndomorphism(table[1], x, y, mixed, ctx)
+            && EC_POINT_add(eCurve, table[2], table[0], table[1], ctx)
+            && mulJoint(r, table, k1, k2, ctx)
+            && (!negate || EC_POINT_invert(eCurve, r, ctx));
+
+    for (EC_POINT *entry : table) {
+        EC_POINT_free(entry);
+    }
+
+    BN_CTX_end(ctx);
+    return result;
+}
+
+namespace {
+    struct RegistryEntry {
+        PIDGEN3::BINKParams params;
+        std::unique_ptr<PIDGEN3::BINKCurve> curve;
+#if UMSKT_THREADS
+        std::once_flag once;
+#else
+        bool initialized = false;
+#endif
+    };
+
+    struct Registry {
+        std::map<std::string, std::unique_ptr<RegistryEntry>> entries;
+#if UMSKT_THREADS
+        std::mutex lock;
+#endif
+    };
+
+    // Intentionally leaked, prefetch threads may still be using it while static destructors run.
+    Registry &registry() {
+        static Registry *instance = new Registry;
+        return *instance;
+    }
+
+    RegistryEntry *findEntry(const std::string &binkid) {
+        Registry &reg = registry();
+#if UMSKT_THREADS
+        std::lock_guard<std::mutex> guard(reg.lock);
+#endif
+        auto it = reg.entries.find(binkid);
+        return it == reg.entries.end() ? nullptr : it->second.get();
+    }
+}
+
+/* Registers the parameters of a BINK, the first registration of a given ID wins. */
+void PIDGEN3::CurveRegistry::add(const std::string &binkid, const BINKParams &params) {
+    Registry &reg = registry();
+#if UMSKT_THREADS
+    std::lock_guard<std::mutex> guard(reg.lock);
+#endif
+    if (reg.entries.count(binkid)) {
+        return;
+    }
+
+    auto entry = std::make_unique<RegistryEntry>();
+    entry->params = params;
+    reg.entries.emplace(binkid, std::move(entry));
+}
+
+bool PIDGEN3::CurveRegistry::contains(const std::string &binkid) {
+    return findEntry(binkid) != nullptr;
+}
+
+std::vector<std::string> PIDGEN3::CurveRegistry::list() {
+    Registry &reg = registry();
+#if UMSKT_THREADS
+    std::lock_guard<std::mutex> guard(reg.lock);
+#endif
+    std::vector<std::string> ids;
+    for (auto &entry : reg.entries) {
+        ids.push_back(entry.first);
+    }
+    return ids;
+}
+
+/* Returns the initialized curve for a BINK, or nullptr if it was never registered. */
+const PIDGEN3::BINKCurve *PIDGEN3::CurveRegistry::get(const std::string &binkid) {
+    RegistryEntry *entry = findEntry(binkid);
+
+    if (entry == nullptr) {
+        return nullptr;
+    }
+
+#if UMSKT_THREADS
+    std::call_once(entry->once, [entry] {
+        entry->curve = std::make_unique<BINKCurve>(entry->params);
+    });
+#else
+    if (!entry->initialized) {
+        entry->curve = std::make_unique<BINKCurve>(entry->params);
+        entry->initialized = true;
+    }
+#endif
+
+    return entry->curve.get();
+}
+
+/* Initializes every registered curve right now. */
+void PIDGEN3::CurveRegistry::warmUp() {
+    for (const std::string &binkid : list()) {
+        get(binkid);
+    }
+}
+
+/* Starts initializing the given curves in the background and returns immediately. */
+void PIDGEN3::CurveRegistry::prefetch(const std::vector<std::string> &binkids) {
+#if UMSKT_THREADS
+    std::thread([binkids] {
+        for (const std::string &binkid : binkids) {
+            get(binkid);
+        }
+    }).detach();
+#else
+    for (const std::string &binkid : binkids) {
+        get(binkid);
+    }
+#endif
+}
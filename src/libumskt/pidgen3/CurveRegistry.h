@@ -0,0 +1,117 @@
+/**
+ * This file is a part of the UMSKT Project
+ *
+ * Copyleft (C) 2019-2023 UMSKT Contributors (et.al.)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @FileCreated by Neo on 10/18/2026
+ * @Maintainer Neo
+ */
+
+#ifndef UMSKT_CURVEREGISTRY_H
+#define UMSKT_CURVEREGISTRY_H
+
+#include "PIDGEN3.h"
+
+#include <vector>
+
+// Width (in bits) of each window of the fixed-base generator table
+#define BINK_COMB_WIDTH         4
+#define BINK_COMB_POINTS        ((1 << BINK_COMB_WIDTH) - 1)
+
+// Slots of the joint tables used by the endomorphism multiplication, see mulJoint()
+#define BINK_ENDO_POINTS        3
+
+/* Decimal curve parameters of a single BINK, as found in keys.json. */
+struct PIDGEN3::BINKParams {
+    std::string p, a, b;
+    std::string generatorX, generatorY;
+    std::string publicKeyX, publicKeyY;
+    std::string genOrder, privateKey;
+};
+
+/*
+ * A fully initialized BINK curve.
+ *
+ * Everything in here is immutable once constructed, so a single instance can be
+ * shared between any number of threads as long as each one brings its own BN_CTX.
+ */
+class PIDGEN3::BINKCurve {
+    bool owner;
+
+    // genTable[i * BINK_COMB_POINTS + (j - 1)] = j * 2^(BINK_COMB_WIDTH * i) * G, stored in affine form
+    std::vector<EC_POINT *> genTable;
+
+    /*
+     * Every BINK curve is y^2 = x^3 + x over p = 1 (mod 4), which has the cheap endomorphism
+     * phi(x, y) = (-x, beta * y) with beta^2 = -1 (mod p). On the subgroup generated by G it acts
+     * as multiplication by lambda, lambda^2 = -1 (mod n), so kP = k1 P + k2 phi(P) with k1 and k2
+     * half as long as k, which halves the doublings of a variable base multiplication.
+     *
+     * (endoA, endoB) and (-endoB, endoA) are the reduced basis of the lattice of (x, y) with
+     * x + y * lambda = 0 (mod n). All of these stay nullptr when the curve doesn't check out,
+     * which includes K lying outside of the subgroup generated by G.
+     */
+    BIGNUM *fieldPrime, *endoBeta, *endoLambda, *endoA, *endoB;
+
+    // K (the public key) in affine form: { K, phi(K), K + phi(K) } followed by { K, -phi(K), K - phi(K) }
+    std::vector<EC_POINT *> pubTable;
+
+    bool initEndomorphism(BN_CTX *ctx);
+    int applyEndomorphism(EC_POINT *r, const BIGNUM *x, const BIGNUM *y, bool negate, BN_CTX *ctx) const;
+    int splitScalar(BIGNUM *k1, BIGNUM *k2, const BIGNUM *k, BN_CTX *ctx) const;
+    int mulJoint(EC_POINT *r, EC_POINT *const *table, const BIGNUM *k1, const BIGNUM *k2, BN_CTX *ctx) const;
+
+public:
+    EC_GROUP *eCurve;
+    EC_POINT *genPoint, *pubPoint;
+    BIGNUM *genOrder, *privateKey;
+
+    // wraps existing objects without taking ownership and without any precomputation
+    BINKCurve(EC_GROUP *eCurve, EC_POINT *genPoint, EC_POINT *pubPoint, BIGNUM *genOrder, BIGNUM *privateKey);
+    explicit BINKCurve(const BINKParams &params);
+    ~BINKCurve();
+
+    BINKCurve(const BINKCurve &) = delete;
+    BINKCurve &operator=(const BINKCurve &) = delete;
+
+    bool hasEndomorphism() const { return endoLambda != nullptr; }
+
+    int mulGenerator(EC_POINT *r, const BIGNUM *k, BN_CTX *ctx) const;
+    int mulPublic(EC_POINT *r, const BIGNUM *k, BN_CTX *ctx) const;
+
+    // point has to lie in the subgroup generated by G, r and point may be the same object
+    int mulEndomorphism(EC_POINT *r, const EC_POINT *point, const BIGNUM *k, BN_CTX *ctx) const;
+};
+
+/*
+ * Process-wide registry of BINK curves.
+ *
+ * Parameters are registered up front (cheap string copies), the expensive setup
+ * is done at most once per BINK, the first time somebody asks for it.
+ */
+class PIDGEN3::CurveRegistry {
+public:
+    static void add(const std::string &binkid, const BINKParams &params);
+    static bool contains(const std::string &binkid);
+    static std::vector<std::string> list();
+
+    static const BINKCurve *get(const std::string &binkid);
+
+    static void warmUp();
+    static void prefetch(const std::vector<std::string> &binkids);
+};
+
+#endif //UMSKT_CURVEREGISTRY_H
@@ -29,6 +29,9 @@ class PIDGEN3 {
 public:
     class BINK1998;
     class BINK2002;
+    class BINKCurve;
+    class CurveRegistry;
+    struct BINKParams;
 
     // util.cpp
     static int BN_bn2lebin(const BIGNUM *a, unsigned char *to, int tolen); // Hello OpenSSL developers, please tell me, where is this function at?
@@ -0,0 +1,140 @@
+/**
+ * This file is a part of the UMSKT Project
+ *
+ * Copyleft (C) 2019-2023 UMSKT Contributors (et.al.)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @FileCreated by Neo on 10/18/2026
+ * @Maintainer Neo
+ */
+
+
+#include "stats.h"
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#if UMSKT_THREADS
+#include <mutex>
+#endif
+
+std::atomic<bool> GenerationStats::enabled(false);
+
+namespace {
+    struct StatsRegistry {
+        std::vector<std::unique_ptr<StatsCounters>> threads;
+#if UMSKT_THREADS
+        std::mutex lock;
+#endif
+    };
+
+    // Intentionally leaked, worker threads may still record while static destructors run.
+    StatsRegistry &registry() {
+        static StatsRegistry *instance = new StatsRegistry;
+        return *instance;
+    }
+}
+
+void StatsBlock::merge(const StatsBlock &other) {
+    completed += other.completed;
+    attempts += other.attempts;
+
+    for (int i = 0; i < REJECT_COUNT; i++) {
+        rejects[i] += other.rejects[i];
+    }
+
+    for (int i = 0; i < PHASE_COUNT; i++) {
+        nanos[i] += other.nanos[i];
+        calls[i] += other.calls[i];
+    }
+
+    for (int i = 0; i < STATS_HISTOGRAM_BUCKETS; i++) {
+        histogram[i] += other.histogram[i];
+    }
+}
+
+void StatsCounters::merge(const StatsCounters &other) {
+    for (int i = 0; i < OP_COUNT; i++) {
+        ops[i].merge(other.ops[i]);
+    }
+}
+
+/* Counters stay owned by the registry, so they outlive the thread that filled them. */
+StatsCounters *GenerationStats::registerThread() {
+    StatsRegistry &reg = registry();
+#if UMSKT_THREADS
+    std::lock_guard<std::mutex> guard(reg.lock);
+#endif
+    reg.threads.emplace_back(new StatsCounters{});
+    return reg.threads.back().get();
+}
+
+StatsCounters &GenerationStats::local() {
+#if UMSKT_THREADS
+    thread_local StatsCounters *counters = registerThread();
+#else
+    static StatsCounters *counters = registerThread();
+#endif
+    return *counters;
+}
+
+void GenerationStats::complete(STATS_OPERATION op, QWORD attempts) {
+    if (!isEnabled()) {
+        return;
+    }
+
+    StatsBlock &block = local().ops[op];
+    block.completed++;
+    block.histogram[attempts == 0 ? 0 : std::min<QWORD>(attempts, STATS_HISTOGRAM_BUCKETS) - 1]++;
+}
+
+/* Adds up the counters of every thread that ever recorded anything. */
+StatsCounters GenerationStats::collect() {
+    StatsRegistry &reg = registry();
+#if UMSKT_THREADS
+    std::lock_guard<std::mutex> guard(reg.lock);
+#endif
+    StatsCounters total{};
+    for (auto &counters : reg.threads) {
+        total.merge(*counters);
+    }
+    return total;
+}
+
+void GenerationStats::reset() {
+    StatsRegistry &reg = registry();
+#if UMSKT_THREADS
+    std::lock_guard<std::mutex> guard(reg.lock);
+#endif
+    for (auto &counters : reg.threads) {
+        *counters = StatsCounters{};
+    }
+}
+
+const char *GenerationStats::operationName(STATS_OPERATION op) {
+    static const char *names[OP_COUNT] = { "bink1998", "bink2002", "confid" };
+    return names[op];
+}
+
+const char *GenerationStats::phaseName(STATS_PHASE phase) {
+    static const char *names[PHASE_COUNT] = { "nonce", "scalar_mul", "hash", "sign", "sqrt", "encode", "verify" };
+    return names[phase];
+}
+
+const char *GenerationStats::rejectName(STATS_REJECT reason) {
+    static const char *names[REJECT_COUNT] = { "signature_length", "no_square", "serial_range", "no_divisor", "verify_failed", "duplicate" };
+    return names[reason];
+}
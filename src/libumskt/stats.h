@@ -0,0 +1,144 @@
+/**
+ * This file is a part of the UMSKT Project
+ *
+ * Copyleft (C) 2019-2023 UMSKT Contributors (et.al.)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @FileCreated by Neo on 10/18/2026
+ * @Maintainer Neo
+ */
+
+
+#ifndef UMSKT_STATS_H
+#define UMSKT_STATS_H
+
+#include "libumskt.h"
+
+#include <atomic>
+#include <chrono>
+
+#define STATS_HISTOGRAM_BUCKETS 32
+
+enum STATS_OPERATION {
+    OP_BINK1998 = 0,
+    OP_BINK2002 = 1,
+    OP_CONFID   = 2,
+    OP_COUNT
+};
+
+enum STATS_PHASE {
+    PHASE_NONCE      = 0,   // random c / IID mixing
+    PHASE_SCALAR_MUL = 1,   // R = cG, divisor multiplication
+    PHASE_HASH       = 2,   // SHA message assembly and digest
+    PHASE_SIGN       = 3,   // scalar arithmetic around the signature
+    PHASE_SQRT       = 4,   // modular square roots
+    PHASE_ENCODE     = 5,   // Base24 / decimal encoding
+    PHASE_VERIFY     = 6,   // BINK*::Verify
+    PHASE_COUNT
+};
+
+enum STATS_REJECT {
+    REJECT_SIGNATURE_LENGTH = 0,    // signature too long to fit into the key
+    REJECT_NO_SQUARE        = 1,    // BN_mod_sqrt found no root
+    REJECT_SERIAL_RANGE     = 2,    // BINK2002 serial outside of the requested range
+    REJECT_NO_DIVISOR       = 3,    // confid attempt did not yield a valid divisor
+    REJECT_VERIFY_FAILED    = 4,    // Verify returned false
+    REJECT_DUPLICATE        = 5,    // key was already issued in this run (--unique)
+    REJECT_COUNT
+};
+
+/* Counters of a single operation. */
+struct StatsBlock {
+    QWORD completed;
+    QWORD attempts;
+    QWORD rejects[REJECT_COUNT];
+    QWORD nanos[PHASE_COUNT];
+    QWORD calls[PHASE_COUNT];
+
+    // histogram[i] = number of results that took i + 1 attempts, the last bucket takes everything above
+    QWORD histogram[STATS_HISTOGRAM_BUCKETS];
+
+    void merge(const StatsBlock &other);
+};
+
+struct StatsCounters {
+    StatsBlock ops[OP_COUNT];
+
+    void merge(const StatsCounters &other);
+};
+
+/*
+ * Generation statistics.
+ *
+ * Every thread counts into its own StatsCounters, so recording is a plain increment;
+ * collect() adds them all up once the work is done. When disabled, which is the
+ * default, each hook costs a single relaxed load.
+ */
+class GenerationStats {
+    static std::atomic<bool> enabled;
+
+    static StatsCounters *registerThread();
+
+public:
+    /* Attributes the time between laps to phases of one operation. */
+    class Clock {
+        STATS_OPERATION op;
+        bool active;
+        std::chrono::steady_clock::time_point last;
+
+    public:
+        explicit Clock(STATS_OPERATION op) : op(op), active(isEnabled()) {
+            if (active) {
+                last = std::chrono::steady_clock::now();
+            }
+        }
+
+        void lap(STATS_PHASE phase) {
+            if (!active) {
+                return;
+            }
+
+            auto now = std::chrono::steady_clock::now();
+            StatsBlock &block = local().ops[op];
+            block.nanos[phase] += std::chrono::duration_cast<std::chrono::nanoseconds>(now - last).count();
+            block.calls[phase]++;
+            last = now;
+        }
+    };
+
+    static void enable(bool on) { enabled.store(on, std::memory_order_relaxed); }
+    static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+
+    static StatsCounters &local();
+
+    static void attempt(STATS_OPERATION op) {
+        if (isEnabled()) local().ops[op].attempts++;
+    }
+
+    static void reject(STATS_OPERATION op, STATS_REJECT reason) {
+        if (isEnabled()) local().ops[op].rejects[reason]++;
+    }
+
+    static void complete(STATS_OPERATION op, QWORD attempts);
+
+    static StatsCounters collect();
+    static void reset();
+
+    static const char *operationName(STATS_OPERATION op);
+    static const char *phaseName(STATS_PHASE phase);
+    static const char *rejectName(STATS_REJECT reason);
+};
+
+#endif //UMSKT_STATS_H
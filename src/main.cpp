@@ -23,6 +23,8 @@
 #include "header.h"
 #include "cli.h"
 
+#include <chrono>
+
 Options options;
 
 int main(int argc, char *argv[]) {
@@ -41,23 +43,64 @@ int main(int argc, char *argv[]) {
 
     CLI run(options, keys);
 
+    auto start = std::chrono::steady_clock::now();
+
     switch(options.applicationMode) {
         case MODE_BINK1998_GENERATE:
-            return run.BINK1998Generate();
+            status = run.BINK1998Generate();
+            break;
 
         case MODE_BINK2002_GENERATE:
-            return run.BINK2002Generate();
+            status = run.BINK2002Generate();
+            break;
 
         case MODE_BINK1998_VALIDATE:
-            return run.BINK1998Validate();
+            status = run.BINK1998Validate();
+            break;
 
         case MODE_BINK2002_VALIDATE:
-            return run.BINK2002Validate();
+            status = run.BINK2002Validate();
+            break;
 
         case MODE_CONFIRMATION_ID:
-            return run.ConfirmationID();
+            status = run.ConfirmationID();
+            break;
+
+        case MODE_DECODE_KEYS:
+            status = run.DecodeKeys();
+            break;
+
+        case MODE_AUDIT_KEYS:
+            status = run.AuditKeys();
+            break;
+
+        case MODE_SERVE:
+            status = run.Serve();
+            break;
+
+        case MODE_MERGE:
+            status = run.Merge();
+            break;
+
+        case MODE_BATCH:
+            status = run.Batch();
+            break;
+
+        case MODE_CONFID_STREAM:
+            status = run.ConfirmationIDStream();
+            break;
+
+        case MODE_PIDGEN2:
+            status = options.keyToCheck.empty() && options.inputFile.empty() ? run.PIDGEN2Generate() : run.PIDGEN2Validate();
+            break;
 
         default:
             return 1;
     }
+
+    if (options.stats) {
+        CLI::printStats(options.statsJSON, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    return status;
 }
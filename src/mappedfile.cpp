@@ -0,0 +1,139 @@
+/**
+ * This file is a part of the UMSKT Project
+ *
+ * Copyleft (C) 2019-2023 UMSKT Contributors (et.al.)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @FileCreated by Neo on 10/18/2026
+ * @Maintainer Neo
+ */
+
+
+#include "mappedfile.h"
+
+#if UMSKT_HAVE_MMAP
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+MappedFile::MappedFile() : data(nullptr), length(0), fd(-1) {
+}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+#if UMSKT_HAVE_MMAP
+/* Maps the whole file, creating it or growing it to at least minLength bytes first. */
+bool MappedFile::open(const std::string &filename, size_t minLength, bool readOnly) {
+    close();
+
+    fd = ::open(filename.c_str(), readOnly ? O_RDONLY : O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) < 0) {
+        close();
+        return false;
+    }
+
+    length = (size_t)info.st_size;
+
+    if (length < minLength) {
+        if (readOnly || ftruncate(fd, (off_t)minLength) < 0) {
+            close();
+            return false;
+        }
+        length = minLength;
+    }
+
+    if (length == 0) {
+        close();
+        return false;
+    }
+
+    void *mapping = mmap(nullptr, length, readOnly ? PROT_READ : PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED) {
+        close();
+        return false;
+    }
+
+    data = (BYTE *)mapping;
+    return true;
+}
+
+/* Grows (or shrinks) the file and remaps it, pointers into the old mapping are invalid afterwards. */
+bool MappedFile::resize(size_t newLength) {
+    if (fd < 0 || newLength == 0) {
+        return false;
+    }
+
+    munmap(data, length);
+    data = nullptr;
+
+    // on failure the old mapping is restored, so the caller can carry on at the old size
+    bool resized = ftruncate(fd, (off_t)newLength) == 0;
+    if (resized) {
+        length = newLength;
+    }
+
+    void *mapping = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED) {
+        close();
+        return false;
+    }
+
+    data = (BYTE *)mapping;
+    return resized;
+}
+
+void MappedFile::sync() {
+    if (data != nullptr) {
+        msync(data, length, MS_SYNC);
+    }
+}
+
+void MappedFile::close() {
+    if (data != nullptr) {
+        munmap(data, length);
+    }
+
+    if (fd >= 0) {
+        ::close(fd);
+    }
+
+    data = nullptr;
+    length = 0;
+    fd = -1;
+}
+#else
+bool MappedFile::open(const std::string &filename, size_t minLength, bool readOnly) {
+    return false;
+}
+
+bool MappedFile::resize(size_t newLength) {
+    return false;
+}
+
+void MappedFile::sync() {
+}
+
+void MappedFile::close() {
+}
+#endif
@@ -0,0 +1,66 @@
+/**
+ * This file is a part of the UMSKT Project
+ *
+ * Copyleft (C) 2019-2023 UMSKT Contributors (et.al.)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @FileCreated by Neo on 10/18/2026
+ * @Maintainer Neo
+ */
+
+
+#ifndef UMSKT_MAPPEDFILE_H
+#define UMSKT_MAPPEDFILE_H
+
+#include "header.h"
+
+#include <utility>
+
+#if (defined(__unix__) || defined(__APPLE__)) && !defined(__DJGPP__)
+#define UMSKT_HAVE_MMAP 1
+#else
+#define UMSKT_HAVE_MMAP 0
+#endif
+
+/*
+ * A file mapped read/write into memory.
+ *
+ * Platforms without mmap can't open one, callers are expected to fall back to
+ * keeping their data in memory only.
+ */
+class MappedFile {
+    BYTE *data;
+    size_t length;
+    int fd;
+
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    bool open(const std::string &filename, size_t minLength, bool readOnly = false);
+    bool resize(size_t newLength);
+    void sync();
+    void close();
+    void swap(MappedFile &other) { std::swap(data, other.data); std::swap(length, other.length); std::swap(fd, other.fd); }
+
+    bool isOpen() const { return data != nullptr; }
+    BYTE *get() const { return data; }
+    size_t size() const { return length; }
+};
+
+#endif //UMSKT_MAPPEDFILE_H
@@ -0,0 +1,414 @@
+/**
+ * This file is a part of the UMSKT Project
+ *
+ * Copyleft (C) 2019-2023 UMSKT Contributors (et.al.)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @FileCreated by Neo on 10/18/2026
+ * @Maintainer Neo
+ */
+
+#include "output.h"
+
+#include <iterator>
+
+#if UMSKT_HAVE_WRITEV
+#include <climits>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/uio.h>
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+#endif
+
+OutputWriter::OutputWriter(std::FILE *file, OUTPUT_FORMAT format, bool finalTerminator) :
+    file(file), ownsFile(false), format(format), finalTerminator(finalTerminator), heldTerminator(false), pendingBytes(0), position(0), failed(false) {
+}
+
+OutputWriter::~OutputWriter() {
+    close();
+}
+
+bool OutputWriter::parseFormat(const std::string &name, OUTPUT_FORMAT *format) {
+    static const std::pair<const char *, OUTPUT_FORMAT> formats[] = {
+            { "PLAIN",  FORMAT_PLAIN },
+            { "NODASH", FORMAT_NODASH },
+            { "CSV",    FORMAT_CSV },
+            { "JSONL",  FORMAT_JSONL },
+            { "NUL",    FORMAT_NUL },
+            { "BINARY", FORMAT_BINARY },
+    };
+
+    std::string upper = name;
+    for (char &c : upper) {
+        c = toupper((unsigned char)c);
+    }
+
+    for (auto &entry : formats) {
+        if (upper == entry.first) {
+            *format = entry.second;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+const char *OutputWriter::formatName(OUTPUT_FORMAT format) {
+    switch (format) {
+        case FORMAT_PLAIN:  return "plain";
+        case FORMAT_NODASH: return "nodash";
+        case FORMAT_CSV:    return "csv";
+        case FORMAT_JSONL:  return "jsonl";
+        case FORMAT_NUL:    return "nul";
+        case FORMAT_BINARY: return "binary";
+    }
+
+    return "plain";
+}
+
+/* Opens a writer on the given file, an empty name or "-" means stdout. */
+OutputWriter *OutputWriter::open(const std::string &filename, OUTPUT_FORMAT format, bool finalTerminator) {
+    if (filename.empty() || filename == "-") {
+        return new OutputWriter(stdout, format, finalTerminator);
+    }
+
+    std::FILE *file = std::fopen(filename.c_str(), "wb");
+    if (file == nullptr) {
+        return nullptr;
+    }
+
+    OutputWriter *writer = new OutputWriter(file, format, finalTerminator);
+    writer->ownsFile = true;
+    return writer;
+}
+
+/*
+ * Continues a file an earlier writer left behind, see checkpoint.h.
+ *
+ * Everything past offset is a partial write from after the last checkpoint and gets
+ * cut off, heldTerminator restores the state of the held back terminator at that point.
+ */
+OutputWriter *OutputWriter::reopen(const std::string &filename, OUTPUT_FORMAT format, bool finalTerminator, QWORD offset, bool heldTerminator) {
+    std::error_code error;
+
+    if (fs::file_size(filename, error) < offset || error) {
+        return nullptr;
+    }
+
+    fs::resize_file(filename, offset, error);
+    if (error) {
+        return nullptr;
+    }
+
+    std::FILE *file = std::fopen(filename.c_str(), "r+b");
+    if (file == nullptr) {
+        return nullptr;
+    }
+
+    if (std::fseek(file, 0, SEEK_END) != 0) {
+        std::fclose(file);
+        return nullptr;
+    }
+
+    OutputWriter *writer = new OutputWriter(file, format, finalTerminator);
+    writer->ownsFile = true;
+    writer->heldTerminator = heldTerminator;
+    writer->position = offset;
+    return writer;
+}
+
+/* Writes a 25 character product key into out, optionally split into dashed groups of five. */
+void OutputWriter::formatKey(char *out, const char *pk, bool dashes) {
+    for (int i = 0; i < 5; i++) {
+        if (dashes && i) {
+            *out++ = '-';
+        }
+        memcpy(out, pk + i * 5, 5);
+        out += 5;
+    }
+    *out = 0;
+}
+
+void OutputWriter::submit(std::string &chunk) {
+    if (chunk.empty()) {
+        return;
+    }
+
+    {
+#if UMSKT_THREADS
+        std::lock_guard<std::mutex> guard(lock);
+#endif
+        pendingBytes += chunk.size();
+        pending.push_back(std::move(chunk));
+
+        if (pendingBytes >= OUTPUT_FLUSH_SIZE) {
+            writeChunks();
+        }
+    }
+
+    chunk = std::string();
+}
+
+/* Writes everything pending, must be called with the lock held. */
+void OutputWriter::writeChunks() {
+    if (pending.empty() || file == nullptr) {
+        return;
+    }
+
+    // nothing gets written past a failed write, there would be a hole in the output
+    if (hasFailed()) {
+        pending.clear();
+        pendingBytes = 0;
+        return;
+    }
+
+    const char term = terminator();
+
+    // Hold back the terminator of the very last record, see the class comment.
+    bool holdLast = !isBinary() && pending.back().back() == term;
+    if (holdLast) {
+        pending.back().pop_back();
+    }
+
+#if UMSKT_HAVE_WRITEV
+    if (std::fflush(file) != 0) {
+        fail();
+    }
+
+    std::vector<struct iovec> iov;
+    iov.reserve(pending.size() + 1);
+
+    if (heldTerminator) {
+        iov.push_back({ (void *)&term, 1 });
+    }
+
+    for (std::string &chunk : pending) {
+        if (!chunk.empty()) {
+            iov.push_back({ (void *)chunk.data(), chunk.size() });
+        }
+    }
+
+    int fd = fileno(file);
+    size_t first = 0;
+
+    while (first < iov.size() && !hasFailed()) {
+        int count = (int)std::min(iov.size() - first, (size_t)IOV_MAX);
+        ssize_t written = writev(fd, &iov[first], count);
+
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (written <= 0) {
+            fail();
+            break;
+        }
+
+        position += written;
+
+        // Skip over everything that made it out, then retry with the remainder.
+        while (first < iov.size() && (size_t)written >= iov[first].iov_len) {
+            written -= (ssize_t)iov[first].iov_len;
+            first++;
+        }
+
+        if (first < iov.size() && written > 0) {
+            iov[first].iov_base = (char *)iov[first].iov_base + written;
+            iov[first].iov_len -= written;
+        }
+    }
+#else
+    if (heldTerminator && std::fwrite(&term, 1, 1, file) == 1) {
+        position++;
+    }
+
+    for (std::string &chunk : pending) {
+        position += std::fwrite(chunk.data(), 1, chunk.size(), file);
+    }
+
+    if (std::ferror(file) || std::fflush(file) != 0) {
+        fail();
+    }
+#endif
+
+    heldTerminator = holdLast;
+    pending.clear();
+    pendingBytes = 0;
+}
+
+/* Writes out everything pending, returns false if anything written so far got lost. */
+bool OutputWriter::flush() {
+#if UMSKT_THREADS
+    std::lock_guard<std::mutex> guard(lock);
+#endif
+    writeChunks();
+    return !hasFailed();
+}
+
+/* Writes out everything pending and asks the OS to put it on disk, used before recording a checkpoint. */
+bool OutputWriter::sync() {
+#if UMSKT_THREADS
+    std::lock_guard<std::mutex> guard(lock);
+#endif
+    if (file == nullptr) {
+        return false;
+    }
+
+    writeChunks();
+
+    if (hasFailed() || std::fflush(file) != 0) {
+        return false;
+    }
+
+#if UMSKT_HAVE_WRITEV
+    return fsync(fileno(file)) == 0;
+#else
+    return true;
+#endif
+}
+
+/*
+ * Writes out everything that's left and releases the file, safe to call more than once.
+ * Returns false if any of the output didn't make it.
+ */
+bool OutputWriter::close() {
+#if UMSKT_THREADS
+    std::lock_guard<std::mutex> guard(lock);
+#endif
+    if (file == nullptr) {
+        return !hasFailed();
+    }
+
+    writeChunks();
+
+    if (heldTerminator && finalTerminator && !hasFailed()) {
+        const char term = terminator();
+        if (std::fwrite(&term, 1, 1, file) == 1) {
+            position++;
+        } else {
+            fail();
+        }
+    }
+    heldTerminator = false;
+
+    if (std::fflush(file) != 0) {
+        fail();
+    }
+
+    if (ownsFile && std::fclose(file) != 0) {
+        fail();
+    }
+    file = nullptr;
+
+    return !hasFailed();
+}
+
+OutputWriter::Buffer::Buffer(OutputWriter *writer) : writer(writer) {
+    data.reserve(OUTPUT_BUFFER_SIZE);
+}
+
+OutputWriter::Buffer::~Buffer() {
+    flush();
+}
+
+/* Writes what goes in front of the first record, the CSV column names or the key file header. */
+void OutputWriter::writeHeader(const std::string &binkid, KEYFILE_ALGORITHM algorithm) {
+    if (format == FORMAT_CSV) {
+        std::string header = OUTPUT_CSV_HEADER;
+        submit(header);
+    }
+
+    if (format == FORMAT_BINARY) {
+        KeyFileHeader header{};
+        header.algorithm = algorithm;
+        KeyFile::parseBINK(binkid, &header.binkid);
+
+        std::string chunk(KEYFILE_HEADER_SIZE, '\0');
+        KeyFile::encodeHeader((BYTE *)&chunk[0], header);
+        submit(chunk);
+    }
+}
+
+/* Appends a single record to data in the format of this writer. */
+void OutputWriter::formatRecord(std::string &data, const KeyRecord &record) const {
+    char key[PK_LENGTH + 4 + NULL_TERMINATOR];
+    auto out = std::back_inserter(data);
+
+    switch (format) {
+        case FORMAT_PLAIN:
+        case FORMAT_NODASH:
+        case FORMAT_NUL:
+            formatKey(key, record.key, format != FORMAT_NODASH);
+            data.append(key);
+            data.push_back(terminator());
+            break;
+
+        case FORMAT_CSV:
+            formatKey(key, record.key, true);
+            fmt::format_to(out, "{},{},{:06d},{:03d},{:d}", key, record.binkid, record.serial, record.channelID, (int)record.upgrade);
+            if (record.hasAuthInfo) {
+                fmt::format_to(out, ",{}\n", record.authInfo);
+            } else {
+                data.append(",\n");
+            }
+            break;
+
+        case FORMAT_JSONL:
+            formatKey(key, record.key, true);
+            fmt::format_to(out, "{{\"key\":\"{}\",\"bink\":\"{}\",\"serial\":{},\"channel\":{},\"upgrade\":{}", key, record.binkid, record.serial, record.channelID, record.upgrade ? "true" : "false");
+            if (record.hasAuthInfo) {
+                fmt::format_to(out, ",\"authinfo\":{}", record.authInfo);
+            }
+            data.append("}\n");
+            break;
+
+        case FORMAT_BINARY:
+            data.resize(data.size() + KEYFILE_RECORD_SIZE);
+            KeyFile::encodeRecord((BYTE *)&data[data.size() - KEYFILE_RECORD_SIZE], record.raw);
+            break;
+    }
+}
+
+void OutputWriter::Buffer::append(const KeyRecord &record) {
+    writer->formatRecord(data, record);
+
+    if (data.size() >= OUTPUT_BUFFER_SIZE) {
+        flush();
+    }
+}
+
+void OutputWriter::Buffer::appendRaw(const std::string &text) {
+    data.append(text);
+
+    if (data.size() >= OUTPUT_BUFFER_SIZE) {
+        flush();
+    }
+}
+
+void OutputWriter::Buffer::appendRaw(const char *text, size_t length) {
+    data.append(text, length);
+
+    if (data.size() >= OUTPUT_BUFFER_SIZE) {
+        flush();
+    }
+}
+
+void OutputWriter::Buffer::flush() {
+    writer->submit(data);
+    data.reserve(OUTPUT_BUFFER_SIZE);
+}
@@ -0,0 +1,140 @@
+/**
+ * This file is a part of the UMSKT Project
+ *
+ * Copyleft (C) 2019-2023 UMSKT Contributors (et.al.)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @FileCreated by Neo on 10/18/2026
+ * @Maintainer Neo
+ */
+
+#ifndef UMSKT_OUTPUT_H
+#define UMSKT_OUTPUT_H
+
+#include "header.h"
+#include "keyfile.h"
+
+#include "libumskt/libumskt.h"
+
+#include <atomic>
+
+#if UMSKT_THREADS
+#include <mutex>
+#endif
+
+#if (defined(__unix__) || defined(__APPLE__)) && !defined(__DJGPP__)
+#define UMSKT_HAVE_WRITEV 1
+#else
+#define UMSKT_HAVE_WRITEV 0
+#endif
+
+#define OUTPUT_BUFFER_SIZE      (64 * 1024)
+#define OUTPUT_FLUSH_SIZE       (1024 * 1024)
+#define OUTPUT_CSV_HEADER       "key,bink,serial,channel,upgrade,authinfo\n"
+
+enum OUTPUT_FORMAT {
+    FORMAT_PLAIN  = 0,
+    FORMAT_NODASH = 1,
+    FORMAT_CSV    = 2,
+    FORMAT_JSONL  = 3,
+    FORMAT_NUL    = 4,
+    FORMAT_BINARY = 5,
+};
+
+/* Everything we know about a generated key, the selected format decides what gets written. */
+struct KeyRecord {
+    char key[PK_LENGTH + NULL_TERMINATOR];
+    QWORD raw[2];
+    const char *binkid;
+    DWORD serial;
+    DWORD channelID;
+    DWORD authInfo;
+    BOOL upgrade;
+    BOOL hasAuthInfo;
+};
+
+/*
+ * Batched key output.
+ *
+ * Each producer thread formats into its own Buffer, full buffers are handed to the
+ * writer which collects them and pushes them out with as few syscalls as possible.
+ *
+ * The terminator of the last record is held back until something else is written,
+ * that way --nonewlines can drop it without knowing in advance which record is last.
+ * Binary output (see keyfile.h) has no terminators and is written as is.
+ *
+ * A failed write is sticky: whatever is pending or comes later is dropped, and flush(),
+ * sync() and close() report false from then on so the run can be failed.
+ */
+class OutputWriter {
+    std::FILE *file;
+    bool ownsFile;
+    OUTPUT_FORMAT format;
+    bool finalTerminator;
+    bool heldTerminator;
+    std::vector<std::string> pending;
+    size_t pendingBytes;
+    QWORD position;
+    std::atomic<bool> failed;
+#if UMSKT_THREADS
+    std::mutex lock;
+#endif
+
+    void writeChunks();
+    void fail() { failed.store(true, std::memory_order_relaxed); }
+
+public:
+    class Buffer {
+        OutputWriter *writer;
+        std::string data;
+
+    public:
+        explicit Buffer(OutputWriter *writer);
+        ~Buffer();
+
+        void append(const KeyRecord &record);
+        void appendRaw(const std::string &text);
+        void appendRaw(const char *text, size_t length);
+        void flush();
+    };
+
+    OutputWriter(std::FILE *file, OUTPUT_FORMAT format, bool finalTerminator);
+    ~OutputWriter();
+
+    static bool parseFormat(const std::string &name, OUTPUT_FORMAT *format);
+    static const char *formatName(OUTPUT_FORMAT format);
+    static OutputWriter *open(const std::string &filename, OUTPUT_FORMAT format, bool finalTerminator);
+    static OutputWriter *reopen(const std::string &filename, OUTPUT_FORMAT format, bool finalTerminator, QWORD offset, bool heldTerminator);
+    static void formatKey(char *out, const char *pk, bool dashes);
+
+    OUTPUT_FORMAT getFormat() const { return format; }
+    bool isText() const { return format == FORMAT_PLAIN || format == FORMAT_NODASH; }
+    bool isBinary() const { return format == FORMAT_BINARY; }
+    char terminator() const { return format == FORMAT_NUL ? '\0' : '\n'; }
+
+    // bytes written to the file so far, and whether a terminator is being held back
+    QWORD tell() const { return position; }
+    bool holdsTerminator() const { return heldTerminator; }
+    bool hasFailed() const { return failed.load(std::memory_order_relaxed); }
+
+    void writeHeader(const std::string &binkid, KEYFILE_ALGORITHM algorithm);
+    void formatRecord(std::string &data, const KeyRecord &record) const;
+    void submit(std::string &chunk);
+    bool flush();
+    bool sync();
+    bool close();
+};
+
+#endif //UMSKT_OUTPUT_H
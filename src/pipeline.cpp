@@ -0,0 +1,436 @@
+/**
+ * This file is a part of the UMSKT Project
+ *
+ * Copyleft (C) 2019-2023 UMSKT Contributors (et.al.)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @FileCreated by Neo on 10/18/2026
+ * @Maintainer Neo
+ */
+
+
+#include "pipeline.h"
+
+#include "libumskt/pidgen3/BINK1998.h"
+#include "libumskt/pidgen3/BINK2002.h"
+#include "libumskt/stats.h"
+
+#include <algorithm>
+
+#if UMSKT_THREADS
+#include "ringbuffer.h"
+
+#include <set>
+#include <thread>
+#endif
+
+namespace {
+    struct Candidate {
+        QWORD raw[2];
+        DWORD serial;
+        DWORD authInfo;
+        QWORD index;
+        QWORD attempt;
+    };
+
+    /* A run of formatted records on its way to the write stage, with the stream index of each. */
+    struct Chunk {
+        std::string data;
+        std::vector<QWORD> indices;
+
+        Chunk() { data.reserve(OUTPUT_BUFFER_SIZE); }
+    };
+
+    /* Generates a single key, returning the serial for BINK2002 where it falls out of the hash. */
+    void generateOne(const PipelineJob &job, Candidate &key) {
+        // every attempt at a key gets its own substream, so retries don't depend on who makes them
+        if (job.seeded) {
+            UMSKT::setRandomStream(job.seed, KeyShards::streamIndex(key.index, job.shardIndex, job.shardCount), key.attempt++);
+        }
+
+        if (!job.bink2002) {
+            PIDGEN3::BINK1998::Generate(*job.curve, job.pSerial, job.pUpgrade, key.raw);
+            key.serial = job.pSerial % 1'000'000;
+            return;
+        }
+
+        UMSKT::umskt_rand_bytes((BYTE *)&key.authInfo, 4);
+        key.authInfo &= BITMASK(10);
+
+        PIDGEN3::BINK2002::Generate(*job.curve, job.pChannelID, key.authInfo, job.pUpgrade, job.serMin, job.serMax, &key.serial, key.raw);
+    }
+
+    bool verifyOne(const PipelineJob &job, Candidate &key) {
+        if (!job.bink2002) {
+            return PIDGEN3::BINK1998::Verify(*job.curve, key.raw);
+        }
+
+        return PIDGEN3::BINK2002::Verify(*job.curve, nullptr, key.raw);
+    }
+
+    // a full dedupe set turns every key into a duplicate, the run has to stop instead of retrying forever
+    bool exhausted(const PipelineJob &job) {
+        return job.dedupe != nullptr && job.dedupe->isFull();
+    }
+
+    bool isUnique(const PipelineJob &job, Candidate &key) {
+        if (job.dedupe != nullptr && !job.dedupe->insert(key.raw)) {
+            return false;
+        }
+
+        if (job.ledger == nullptr) {
+            return true;
+        }
+
+        BYTE binkid = 0;
+        KeyFile::parseBINK(job.binkid, &binkid);
+
+        if (job.ledger->append(binkid, key.raw, key.serial, job.bink2002 ? job.pChannelID : job.pSerial / 1'000'000, job.pUpgrade)) {
+            return true;
+        }
+
+        GenerationStats::reject(job.bink2002 ? OP_BINK2002 : OP_BINK1998, REJECT_DUPLICATE);
+        return false;
+    }
+}
+
+/*
+ * Makes a single finished key without going through the stages, for callers that
+ * parallelize on their own. Index picks the random stream of a seeded job.
+ * Returns false if the dedupe set filled up before a unique key turned up.
+ */
+bool KeyPipeline::generateKey(const PipelineJob &job, QWORD index, bool verify, KeyRecord &record) {
+    Candidate key{};
+    key.index = index;
+
+    generateOne(job, key);
+
+    bool found;
+    while (!(found = (!verify || verifyOne(job, key)) && isUnique(job, key)) && !exhausted(job)) {
+        generateOne(job, key);
+    }
+
+    if (job.seeded) {
+        UMSKT::clearRandomStream();
+    }
+
+    memcpy(record.raw, key.raw, sizeof(record.raw));
+    record.serial = key.serial;
+    record.authInfo = key.authInfo;
+    return found;
+}
+
+/*
+ * Whether a single key is better off with searchKey than with generateKey.
+ *
+ * The serial falls out of a 20 bit hash, so a narrow range throws away most attempts
+ * and a lone key takes long enough that spreading its attempts over the cores pays off.
+ * Seeded jobs stay on generateKey, whichever thread wins a race isn't reproducible.
+ */
+bool KeyPipeline::worthSearching(const PipelineJob &job) {
+#if UMSKT_THREADS
+    if (!job.bink2002 || job.seeded || std::thread::hardware_concurrency() < 2) {
+        return false;
+    }
+
+    return (QWORD)(job.serMax - job.serMin + 1) * PIPELINE_SEARCH_MIN_ATTEMPTS <= BITMASK(20) + 1;
+#else
+    return false;
+#endif
+}
+
+/*
+ * Finds a single BINK2002 key with every worker trying its own candidates at once.
+ *
+ * Each worker draws its own nonces and AuthInfo, so no two of them ever try the same
+ * candidate. The first key that verifies wins, the others see the flag on their next
+ * attempt and give up. Returns false if there are no threads to search with.
+ */
+bool KeyPipeline::searchKey(const PipelineJob &job, int threads, bool verify, KeyRecord &record) {
+#if UMSKT_THREADS
+    if (threads <= 0) {
+        threads = std::max(1, (int)std::thread::hardware_concurrency());
+    }
+
+    Candidate winner{};
+
+    do {
+        std::atomic<bool> found(false);
+        std::vector<std::thread> workers;
+
+        for (int i = 0; i < threads; i++) {
+            workers.emplace_back([&] {
+                Candidate key{};
+
+                while (!found.load(std::memory_order_relaxed)) {
+                    UMSKT::umskt_rand_bytes((BYTE *)&key.authInfo, 4);
+                    key.authInfo &= BITMASK(10);
+
+                    if (!PIDGEN3::BINK2002::Generate(*job.curve, job.pChannelID, key.authInfo, job.pUpgrade, job.serMin, job.serMax, &key.serial, key.raw, &found)) {
+                        break;
+                    }
+
+                    if (verify && !verifyOne(job, key)) {
+                        continue;
+                    }
+
+                    if (!found.exchange(true)) {
+                        winner = key;
+                    }
+                    break;
+                }
+            });
+        }
+
+        for (std::thread &worker : workers) {
+            worker.join();
+        }
+
+        // only the winner touches the dedupe set and the ledger, a duplicate starts the race over
+    } while (!isUnique(job, winner) && !exhausted(job));
+
+    if (exhausted(job)) {
+        return false;
+    }
+
+    memcpy(record.raw, winner.raw, sizeof(record.raw));
+    record.serial = winner.serial;
+    record.authInfo = winner.authInfo;
+    return true;
+#else
+    return false;
+#endif
+}
+
+#if UMSKT_THREADS
+/* Fills in stage sizes that were left at 0. */
+void KeyPipeline::resolveConfig(PipelineConfig &config) {
+    int cores = std::max(1, (int)std::thread::hardware_concurrency());
+
+    if (config.formatters <= 0) {
+        config.formatters = 1;
+    }
+
+    if (!config.verify) {
+        config.verifiers = 0;
+
+        if (config.generators <= 0) {
+            config.generators = std::max(1, cores - 1);
+        }
+        return;
+    }
+
+    // Verifying costs a few times more than generating now that G comes out of a table,
+    // so most of the cores go to the verify stage.
+    if (config.generators <= 0) {
+        config.generators = std::max(1, cores / 4);
+    }
+
+    if (config.verifiers <= 0) {
+        config.verifiers = std::max(1, cores - config.generators);
+    }
+}
+
+/* Generates job.total keys and writes them out, returns the number of keys written. */
+QWORD KeyPipeline::run(const PipelineJob &job, PipelineConfig config, OutputWriter *writer) {
+    resolveConfig(config);
+
+    RingBuffer<Candidate> generated(PIPELINE_RING_SIZE);
+    RingBuffer<Candidate> verified(PIPELINE_RING_SIZE);
+    RingBuffer<Chunk *> chunks(PIPELINE_CHUNK_RING);
+
+    // without a verify stage, generators feed the formatters directly
+    RingBuffer<Candidate> &formatInput = config.verify ? verified : generated;
+
+    // streams a resumed run had already written past its checkpoint's nextIndex are not redone,
+    // every other stream from firstIndex on is, until job.total keys are out
+    std::vector<QWORD> skip;
+    if (job.checkpoint != nullptr) {
+        skip = job.checkpoint->state.ahead;
+    }
+    const QWORD streams = job.total + skip.size();
+
+    std::atomic<QWORD> tickets(0);
+    std::atomic<int> generatorsLeft(config.generators);
+    std::atomic<int> verifiersLeft(config.verifiers);
+    std::atomic<int> formattersLeft(config.formatters);
+
+    std::atomic<int> &formatProducers = config.verify ? verifiersLeft : generatorsLeft;
+
+    // once the output fails or the dedupe set is full no key can make it anymore
+    auto halted = [&job, writer] { return exhausted(job) || writer->hasFailed(); };
+
+    std::vector<std::thread> workers;
+
+    for (int i = 0; i < config.generators; i++) {
+        workers.emplace_back([&] {
+            Candidate key{};
+            QWORD ticket;
+
+            while (!halted() && (ticket = tickets.fetch_add(1, std::memory_order_relaxed)) < streams) {
+                key.index = job.firstIndex + ticket;
+                if (std::binary_search(skip.begin(), skip.end(), key.index)) {
+                    continue;
+                }
+
+                key.attempt = 0;
+                generateOne(job, key);
+
+                // with nothing to verify, this is the last stage that can still replace a key
+                while (!config.verify && !isUnique(job, key) && !halted()) {
+                    generateOne(job, key);
+                }
+
+                if (halted()) {
+                    break;
+                }
+
+                ringPush(generated, key);
+            }
+
+            UMSKT::clearRandomStream();
+            generatorsLeft.fetch_sub(1, std::memory_order_release);
+        });
+    }
+
+    for (int i = 0; i < config.verifiers; i++) {
+        workers.emplace_back([&] {
+            Candidate key{};
+
+            while (ringPop(generated, key, generatorsLeft)) {
+                // a bad or duplicate key gets replaced right here so the total stays exact
+                while ((!verifyOne(job, key) || !isUnique(job, key)) && !halted()) {
+                    generateOne(job, key);
+                }
+
+                // keep draining so the generators never block on a full ring
+                if (halted()) {
+                    continue;
+                }
+
+                ringPush(verified, key);
+            }
+
+            UMSKT::clearRandomStream();
+            verifiersLeft.fetch_sub(1, std::memory_order_release);
+        });
+    }
+
+    for (int i = 0; i < config.formatters; i++) {
+        workers.emplace_back([&] {
+            Candidate key{};
+
+            KeyRecord record{};
+            record.binkid = job.binkid;
+            record.upgrade = job.pUpgrade;
+            record.hasAuthInfo = job.bink2002;
+            record.channelID = job.bink2002 ? job.pChannelID : job.pSerial / 1'000'000;
+
+            Chunk *chunk = new Chunk;
+
+            while (ringPop(formatInput, key, formatProducers)) {
+                memcpy(record.raw, key.raw, sizeof(record.raw));
+                record.serial = key.serial;
+                record.authInfo = key.authInfo;
+
+                if (!writer->isBinary()) {
+                    GenerationStats::Clock clock(job.bink2002 ? OP_BINK2002 : OP_BINK1998);
+                    PIDGEN3::base24(record.key, (BYTE *)record.raw);
+                    clock.lap(PHASE_ENCODE);
+                }
+
+                writer->formatRecord(chunk->data, record);
+                chunk->indices.push_back(key.index);
+
+                if (chunk->data.size() >= OUTPUT_BUFFER_SIZE) {
+                    ringPush(chunks, chunk);
+                    chunk = new Chunk;
+                }
+            }
+
+            if (chunk->indices.empty()) {
+                delete chunk;
+            } else {
+                ringPush(chunks, chunk);
+            }
+
+            formattersLeft.fetch_sub(1, std::memory_order_release);
+        });
+    }
+
+    // write stage, chunks come in out of order so it tracks the lowest stream not written yet
+    // and the written ones past it, which is all a checkpoint needs to redo exactly the rest
+    QWORD written = 0;
+    QWORD watermark = job.firstIndex;
+    std::set<QWORD> ahead(skip.begin(), skip.end());
+
+    auto settle = [&] {
+        while (!ahead.empty() && *ahead.begin() == watermark) {
+            ahead.erase(ahead.begin());
+            watermark++;
+        }
+    };
+    auto record = [&] {
+        job.checkpoint->record(writer, watermark, std::vector<QWORD>(ahead.begin(), ahead.end()));
+    };
+
+    settle();
+
+    Chunk *chunk;
+    while (ringPop(chunks, chunk, formattersLeft)) {
+        QWORD records = chunk->indices.size();
+        written += records;
+
+        writer->submit(chunk->data);
+
+        if (job.checkpoint != nullptr) {
+            job.checkpoint->advance(records);
+
+            for (QWORD index : chunk->indices) {
+                ahead.insert(index);
+            }
+            settle();
+        }
+
+        delete chunk;
+
+        if (job.checkpoint != nullptr && job.checkpoint->due()) {
+            record();
+        }
+    }
+
+    // a run that stops short leaves a checkpoint of exactly what made it out
+    if (job.checkpoint != nullptr && written < job.total) {
+        record();
+    }
+
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+
+    return written;
+}
+#else
+void KeyPipeline::resolveConfig(PipelineConfig &config) {
+    config.generators = 1;
+    config.verifiers = config.verify ? 1 : 0;
+    config.formatters = 1;
+}
+
+/* Without threads there is nothing to overlap, the CLI falls back to its sequential loops. */
+QWORD KeyPipeline::run(const PipelineJob &job, PipelineConfig config, OutputWriter *writer) {
+    return 0;
+}
+#endif
@@ -0,0 +1,93 @@
+/**
+ * This file is a part of the UMSKT Project
+ *
+ * Copyleft (C) 2019-2023 UMSKT Contributors (et.al.)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @FileCreated by Neo on 10/18/2026
+ * @Maintainer Neo
+ */
+
+
+#ifndef UMSKT_PIPELINE_H
+#define UMSKT_PIPELINE_H
+
+#include "header.h"
+#include "checkpoint.h"
+#include "dedupe.h"
+#include "ledger.h"
+#include "output.h"
+#include "shard.h"
+
+#include "libumskt/libumskt.h"
+#include "libumskt/pidgen3/CurveRegistry.h"
+
+#define PIPELINE_RING_SIZE      1024
+#define PIPELINE_CHUNK_RING     (2 * OUTPUT_FLUSH_SIZE / OUTPUT_BUFFER_SIZE)
+
+// a single BINK2002 key is worth searching for on every core once its serial range
+// rejects more than this many attempts for each one that lands inside it
+#define PIPELINE_SEARCH_MIN_ATTEMPTS    8
+
+/* What to generate, mirrors the arguments of BINK1998/BINK2002::Generate. */
+struct PipelineJob {
+    const PIDGEN3::BINKCurve *curve;
+    const char *binkid;
+    bool bink2002;
+    DWORD pSerial;      // BINK1998: channel * 1'000'000 + serial
+    DWORD pChannelID;   // BINK2002
+    DWORD serMin, serMax;
+    BOOL pUpgrade;
+    QWORD total;
+    KeyDedupe *dedupe;  // optional, duplicates are replaced like keys that fail to verify
+    KeyLedger *ledger;  // optional, so are keys it already holds
+
+    // with seeded set, key i draws from random stream (seed, firstIndex + i) instead of the system RNG
+    bool seeded;
+    QWORD seed;
+    QWORD firstIndex;
+    DWORD shardIndex, shardCount;   // see KeyShards::streamIndex
+    Checkpoint *checkpoint;         // optional, updated from the write stage
+};
+
+/* Number of workers per stage, 0 picks a default based on the number of cores. */
+struct PipelineConfig {
+    int generators;
+    int verifiers;
+    int formatters;
+    bool verify;
+};
+
+/*
+ * Bulk key generation split into stages:
+ *
+ *   generate -> [ring] -> verify -> [ring] -> format -> [ring] -> write
+ *
+ * Each stage runs on its own workers and only talks to its neighbours through bounded
+ * lock-free rings, so a slow writer fills the rings and stalls generation instead of
+ * piling up memory, and no stage waits on a different kind of work to finish.
+ * The write stage runs on the calling thread.
+ */
+class KeyPipeline {
+public:
+    static void resolveConfig(PipelineConfig &config);
+    static QWORD run(const PipelineJob &job, PipelineConfig config, OutputWriter *writer);
+    static bool generateKey(const PipelineJob &job, QWORD index, bool verify, KeyRecord &record);
+
+    static bool worthSearching(const PipelineJob &job);
+    static bool searchKey(const PipelineJob &job, int threads, bool verify, KeyRecord &record);
+};
+
+#endif //UMSKT_PIPELINE_H
@@ -0,0 +1,523 @@
+/**
+ * This file is a part of the UMSKT Project
+ *
+ * Copyleft (C) 2019-2023 UMSKT Contributors (et.al.)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @FileCreated by Neo on 10/18/2026
+ * @Maintainer Neo
+ */
+
+
+/*
+ * The umskt Python module, a thin layer over the C interface in capi.h.
+ *
+ * Every batch call packs its input while holding the GIL, then releases it and splits
+ * the work into ranges on a ThreadPool shared by the whole module, each range writing
+ * straight into its part of the result buffer. Other Python threads keep running
+ * in the meantime.
+ *
+ *   import umskt
+ *   keys = umskt.Bink("2E").generate(1000)          # 1000 * 25 bytes
+ *   flags = umskt.Bink("2E").verify(keys)           # one 0/1 byte per key
+ *   cids, statuses = umskt.confid(["...", ...])
+ */
+
+#include "../header.h"
+#include "../threadpool.h"
+#include "../libumskt/capi.h"
+
+#include <cmrc/cmrc.hpp>
+
+#include <memory>
+
+// after our own headers, Python.h brings back the assert typedefs.h turns off
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+CMRC_DECLARE(umskt);
+
+// smallest range worth handing to another thread, per kind of work
+#define PYTHON_GENERATE_CHUNK   16
+#define PYTHON_VERIFY_CHUNK     64
+#define PYTHON_CONFID_CHUNK     8
+
+// record sizes lists of strings are packed into
+#define PYTHON_KEY_STRIDE       32
+#define PYTHON_IID_STRIDE       (UMSKT_IID_MAX + 1)
+
+static PyObject *UMSKTError;
+static std::shared_ptr<ThreadPool> pool;
+static int poolThreads = 0;
+
+/* Raises umskt.Error for a failed status, returns nullptr for the caller to pass on. */
+static PyObject *raiseStatus(int status) {
+    PyErr_SetString(UMSKTError, umskt_strerror(status));
+    return nullptr;
+}
+
+/*
+ * Runs work over [0, count) in ranges of at least minChunk on the module pool and
+ * returns the first failed status. Has to be called without the GIL.
+ */
+static int runParallel(std::shared_ptr<ThreadPool> workers, size_t count, size_t minChunk, const std::function<int(size_t, size_t)> &work) {
+    size_t ranges = std::min((count + minChunk - 1) / minChunk, (size_t)workers->size() * 4);
+
+    if (ranges <= 1) {
+        return count ? work(0, count) : UMSKT_OK;
+    }
+
+    std::mutex lock;
+    std::condition_variable done;
+    size_t remaining = ranges;
+    int status = UMSKT_OK;
+
+    for (size_t r = 0; r < ranges; r++) {
+        size_t first = count * r / ranges, last = count * (r + 1) / ranges;
+
+        workers->submit([&, first, last] {
+            int result = work(first, last - first);
+
+            std::lock_guard<std::mutex> guard(lock);
+            if (status == UMSKT_OK) {
+                status = result;
+            }
+            if (--remaining == 0) {
+                done.notify_one();
+            }
+        });
+    }
+
+    std::unique_lock<std::mutex> guard(lock);
+    done.wait(guard, [&remaining] { return remaining == 0; });
+    return status;
+}
+
+static std::shared_ptr<ThreadPool> getPool() {
+    if (!pool) {
+        pool = std::make_shared<ThreadPool>(poolThreads);
+    }
+
+    return pool;
+}
+
+/*
+ * Packs a list of str, or takes a bytes-like object as is, into fixed size records.
+ * A bytes-like object keeps the stride it was given, strings are cut off at stride.
+ */
+class Records {
+    Py_buffer view;
+    bool hasView;
+    std::string packed;
+
+public:
+    const char *data;
+    size_t stride, count;
+
+    Records() : hasView(false), data(nullptr), stride(0), count(0) {}
+    ~Records() {
+        if (hasView) {
+            PyBuffer_Release(&view);
+        }
+    }
+
+    bool load(PyObject *input, size_t bufferStride, size_t listStride) {
+        if (PyList_Check(input) || PyTuple_Check(input)) {
+            PyObject *sequence = PySequence_Fast(input, "expected a list of strings");
+            if (sequence == nullptr) {
+                return false;
+            }
+
+            count = PySequence_Fast_GET_SIZE(sequence);
+            stride = listStride;
+            packed.assign(count * stride, '\0');
+
+            for (size_t i = 0; i < count; i++) {
+                Py_ssize_t length;
+                const char *text = PyUnicode_AsUTF8AndSize(PySequence_Fast_GET_ITEM(sequence, i), &length);
+
+                if (text == nullptr) {
+                    Py_DECREF(sequence);
+                    return false;
+                }
+                memcpy(&packed[i * stride], text, std::min((size_t)length, stride));
+            }
+
+            Py_DECREF(sequence);
+            data = packed.data();
+            return true;
+        }
+
+        if (bufferStride == 0) {
+            PyErr_SetString(PyExc_ValueError, "stride has to be positive");
+            return false;
+        }
+
+        if (PyObject_GetBuffer(input, &view, PyBUF_SIMPLE) != 0) {
+            return false;
+        }
+        hasView = true;
+
+        if (view.len % bufferStride != 0) {
+            PyErr_SetString(PyExc_ValueError, "buffer length is not a multiple of stride");
+            return false;
+        }
+
+        data = (const char *)view.buf;
+        stride = bufferStride;
+        count = view.len / bufferStride;
+        return true;
+    }
+};
+
+struct BinkObject {
+    PyObject_HEAD
+    umskt_bink_handle *handle;
+};
+
+static int Bink_init(BinkObject *self, PyObject *args, PyObject *kwargs) {
+    static const char *keywords[] = { "binkid", nullptr };
+    const char *binkid;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s", (char **)keywords, &binkid)) {
+        return -1;
+    }
+
+    umskt_bink_close(self->handle);
+    self->handle = nullptr;
+
+    int status = umskt_bink_open(binkid, &self->handle);
+    if (status != UMSKT_OK) {
+        raiseStatus(status);
+        return -1;
+    }
+
+    return 0;
+}
+
+static void Bink_dealloc(BinkObject *self) {
+    PyTypeObject *type = Py_TYPE(self);
+
+    umskt_bink_close(self->handle);
+    type->tp_free((PyObject *)self);
+    Py_DECREF(type);
+}
+
+/* Bink.generate(count, channel_id=640, serial_min=0, serial_max=999999, upgrade=False) -> bytes */
+static PyObject *Bink_generate(BinkObject *self, PyObject *args, PyObject *kwargs) {
+    static const char *keywords[] = { "count", "channel_id", "serial_min", "serial_max", "upgrade", nullptr };
+    Py_ssize_t count;
+    umskt_generate_params params = { 640, 0, 999999, 0 };
+    int upgrade = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "n|IIIp", (char **)keywords, &count, &params.channel_id, &params.serial_min, &params.serial_max, &upgrade)) {
+        return nullptr;
+    }
+
+    if (count < 0) {
+        PyErr_SetString(PyExc_ValueError, "count can't be negative");
+        return nullptr;
+    }
+    params.upgrade = upgrade;
+
+    PyObject *result = PyBytes_FromStringAndSize(nullptr, count * UMSKT_KEY_LENGTH);
+    if (result == nullptr) {
+        return nullptr;
+    }
+
+    char *keys = PyBytes_AS_STRING(result);
+    const umskt_bink_handle *bink = self->handle;
+    std::shared_ptr<ThreadPool> workers = getPool();
+    int status;
+
+    Py_BEGIN_ALLOW_THREADS
+    status = runParallel(workers, count, PYTHON_GENERATE_CHUNK, [&](size_t first, size_t n) {
+        return umskt_generate_n(bink, &params, n, keys + first * UMSKT_KEY_LENGTH);
+    });
+    Py_END_ALLOW_THREADS
+
+    if (status != UMSKT_OK) {
+        Py_DECREF(result);
+        return raiseStatus(status);
+    }
+
+    return result;
+}
+
+/* Bink.verify(keys, stride=25) -> bytes, keys is a list of str or a bytes-like object of stride byte records */
+static PyObject *Bink_verify(BinkObject *self, PyObject *args, PyObject *kwargs) {
+    static const char *keywords[] = { "keys", "stride", nullptr };
+    PyObject *input;
+    Py_ssize_t stride = UMSKT_KEY_LENGTH;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|n", (char **)keywords, &input, &stride)) {
+        return nullptr;
+    }
+
+    Records keys;
+    if (!keys.load(input, stride > 0 ? stride : 0, PYTHON_KEY_STRIDE)) {
+        return nullptr;
+    }
+
+    PyObject *result = PyBytes_FromStringAndSize(nullptr, keys.count);
+    if (result == nullptr) {
+        return nullptr;
+    }
+
+    uint8_t *valid = (uint8_t *)PyBytes_AS_STRING(result);
+    const umskt_bink_handle *bink = self->handle;
+    std::shared_ptr<ThreadPool> workers = getPool();
+    int status;
+
+    Py_BEGIN_ALLOW_THREADS
+    status = runParallel(workers, keys.count, PYTHON_VERIFY_CHUNK, [&](size_t first, size_t n) {
+        return umskt_verify_n(bink, keys.data + first * keys.stride, keys.stride, n, valid + first, nullptr);
+    });
+    Py_END_ALLOW_THREADS
+
+    if (status != UMSKT_OK) {
+        Py_DECREF(result);
+        return raiseStatus(status);
+    }
+
+    return result;
+}
+
+static PyMethodDef Bink_methods[] = {
+    { "generate", (PyCFunction)(void (*)(void))Bink_generate, METH_VARARGS | METH_KEYWORDS, "generate(count, channel_id=640, serial_min=0, serial_max=999999, upgrade=False) -> bytes of count 25 character keys" },
+    { "verify",   (PyCFunction)(void (*)(void))Bink_verify,   METH_VARARGS | METH_KEYWORDS, "verify(keys, stride=25) -> bytes with 1 for every valid key and 0 for every other" },
+    { nullptr, nullptr, 0, nullptr }
+};
+
+static PyType_Slot Bink_slots[] = {
+    { Py_tp_doc,     (void *)"Bink(binkid) - a BINK, set up once and safe to share between threads" },
+    { Py_tp_init,    (void *)Bink_init },
+    { Py_tp_dealloc, (void *)Bink_dealloc },
+    { Py_tp_methods, (void *)Bink_methods },
+    { Py_tp_new,     (void *)PyType_GenericNew },
+    { 0, nullptr }
+};
+
+static PyType_Spec Bink_spec = {
+    "umskt.Bink",
+    sizeof(BinkObject),
+    0,
+    Py_TPFLAGS_DEFAULT,
+    Bink_slots
+};
+
+/* confid(iids, mode=0, product_id=None, override=False, stride=128) -> ([cid or None], [status]) */
+static PyObject *umskt_confid(PyObject *, PyObject *args, PyObject *kwargs) {
+    static const char *keywords[] = { "iids", "mode", "product_id", "override", "stride", nullptr };
+    PyObject *input;
+    int mode = UMSKT_MODE_WINDOWS, overrideVersion = 0;
+    const char *productID = nullptr;
+    Py_ssize_t stride = PYTHON_IID_STRIDE;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|izpn", (char **)keywords, &input, &mode, &productID, &overrideVersion, &stride)) {
+        return nullptr;
+    }
+
+    Records iids;
+    if (!iids.load(input, stride > 0 ? stride : 0, PYTHON_IID_STRIDE)) {
+        return nullptr;
+    }
+
+    std::string productid = productID ? productID : "";
+    std::vector<char> cids(iids.count * UMSKT_CID_SIZE);
+    std::vector<int> statuses(iids.count);
+    std::shared_ptr<ThreadPool> workers = getPool();
+    int status;
+
+    Py_BEGIN_ALLOW_THREADS
+    status = runParallel(workers, iids.count, PYTHON_CONFID_CHUNK, [&](size_t first, size_t n) {
+        return umskt_confid_n(iids.data + first * iids.stride, iids.stride, n, mode, productid.c_str(), overrideVersion, &cids[first * UMSKT_CID_SIZE], &statuses[first]);
+    });
+    Py_END_ALLOW_THREADS
+
+    if (status != UMSKT_OK) {
+        return raiseStatus(status);
+    }
+
+    PyObject *cidList = PyList_New(iids.count), *statusList = PyList_New(iids.count);
+    if (cidList == nullptr || statusList == nullptr) {
+        Py_XDECREF(cidList);
+        Py_XDECREF(statusList);
+        return nullptr;
+    }
+
+    for (size_t i = 0; i < iids.count; i++) {
+        PyObject *cid = Py_None;
+        if (statuses[i] == UMSKT_OK) {
+            cid = PyUnicode_FromString(&cids[i * UMSKT_CID_SIZE]);
+        } else {
+            Py_INCREF(cid);
+        }
+        PyList_SET_ITEM(cidList, i, cid);
+        PyList_SET_ITEM(statusList, i, PyLong_FromLong(statuses[i]));
+    }
+
+    return Py_BuildValue("(NN)", cidList, statusList);
+}
+
+/* register_bink(binkid, params), params being a BINK entry of keys.json */
+static PyObject *umskt_register_bink(PyObject *, PyObject *args) {
+    const char *binkid;
+    PyObject *params;
+
+    if (!PyArg_ParseTuple(args, "sO!", &binkid, &PyDict_Type, &params)) {
+        return nullptr;
+    }
+
+    // "g.x" is params["g"]["x"]
+    auto field = [params](const char *outer, const char *inner) -> const char * {
+        PyObject *value = PyDict_GetItemString(params, outer);
+        if (value != nullptr && inner != nullptr) {
+            value = PyDict_Check(value) ? PyDict_GetItemString(value, inner) : nullptr;
+        }
+
+        if (value == nullptr || !PyUnicode_Check(value)) {
+            PyErr_Format(PyExc_ValueError, "BINK parameter %s%s%s is missing or not a string", outer, inner ? "." : "", inner ? inner : "");
+            return nullptr;
+        }
+        return PyUnicode_AsUTF8(value);
+    };
+
+    umskt_bink_params bink = {
+            field("p", nullptr), field("a", nullptr), field("b", nullptr),
+            field("g", "x"), field("g", "y"),
+            field("pub", "x"), field("pub", "y"),
+            field("n", nullptr), field("priv", nullptr)
+    };
+
+    if (PyErr_Occurred()) {
+        return nullptr;
+    }
+
+    int status = umskt_bink_register(binkid, &bink);
+    if (status != UMSKT_OK) {
+        return raiseStatus(status);
+    }
+
+    Py_RETURN_NONE;
+}
+
+/* set_threads(n), 0 means one per core, takes effect with the next batch call */
+static PyObject *umskt_set_threads(PyObject *, PyObject *args) {
+    int threads;
+
+    if (!PyArg_ParseTuple(args, "i", &threads)) {
+        return nullptr;
+    }
+
+    // calls still running keep the old pool alive until they finish
+    poolThreads = std::max(threads, 0);
+    pool.reset();
+
+    Py_RETURN_NONE;
+}
+
+static PyObject *umskt_strerror_py(PyObject *, PyObject *args) {
+    int status;
+
+    if (!PyArg_ParseTuple(args, "i", &status)) {
+        return nullptr;
+    }
+
+    return PyUnicode_FromString(umskt_strerror(status));
+}
+
+static PyMethodDef umskt_methods[] = {
+    { "confid",        (PyCFunction)(void (*)(void))umskt_confid, METH_VARARGS | METH_KEYWORDS, "confid(iids, mode=0, product_id=None, override=False, stride=128) -> (confirmation IDs, statuses)" },
+    { "register_bink", umskt_register_bink, METH_VARARGS, "register_bink(binkid, params) - make a BINK from a keys.json style dict known to Bink()" },
+    { "set_threads",   umskt_set_threads,   METH_VARARGS, "set_threads(n) - size of the pool batch calls run on, 0 for one thread per core" },
+    { "strerror",      umskt_strerror_py,   METH_VARARGS, "strerror(status) -> description of a status code" },
+    { nullptr, nullptr, 0, nullptr }
+};
+
+static struct PyModuleDef umskt_module = {
+    PyModuleDef_HEAD_INIT,
+    "umskt",
+    "Batch product key generation, verification and confirmation IDs",
+    -1,
+    umskt_methods
+};
+
+/* Makes every BINK of the built in keys.json available, later register_bink calls can add more. */
+static bool registerBuiltinBINKs() {
+    cmrc::embedded_filesystem fs = cmrc::umskt::get_filesystem();
+    cmrc::file file = fs.open("keys.json");
+    json keys = json::parse(file.begin(), file.end(), nullptr, false, false);
+
+    if (keys.is_discarded()) {
+        return false;
+    }
+
+    for (auto &el : keys["BINK"].items()) {
+        json &bink = el.value();
+
+        std::string fields[] = {
+                bink["p"].get<std::string>(), bink["a"].get<std::string>(), bink["b"].get<std::string>(),
+                bink["g"]["x"].get<std::string>(), bink["g"]["y"].get<std::string>(),
+                bink["pub"]["x"].get<std::string>(), bink["pub"]["y"].get<std::string>(),
+                bink["n"].get<std::string>(), bink["priv"].get<std::string>()
+        };
+
+        umskt_bink_params params = {
+                fields[0].c_str(), fields[1].c_str(), fields[2].c_str(),
+                fields[3].c_str(), fields[4].c_str(),
+                fields[5].c_str(), fields[6].c_str(),
+                fields[7].c_str(), fields[8].c_str()
+        };
+        umskt_bink_register(el.key().c_str(), &params);
+    }
+
+    return true;
+}
+
+PyMODINIT_FUNC PyInit_umskt(void) {
+    if (!registerBuiltinBINKs()) {
+        PyErr_SetString(PyExc_ImportError, "unable to parse the built in keys file");
+        return nullptr;
+    }
+
+    PyObject *module = PyModule_Create(&umskt_module);
+    if (module == nullptr) {
+        return nullptr;
+    }
+
+    UMSKTError = PyErr_NewException("umskt.Error", PyExc_RuntimeError, nullptr);
+    PyObject *binkType = PyType_FromSpec(&Bink_spec);
+
+    Py_XINCREF(UMSKTError);
+    if (UMSKTError == nullptr || binkType == nullptr
+        || PyModule_AddObject(module, "Error", UMSKTError) != 0
+        || PyModule_AddObject(module, "Bink", binkType) != 0) {
+        Py_XDECREF(binkType);
+        Py_DECREF(module);
+        return nullptr;
+    }
+
+    PyModule_AddIntConstant(module, "ABI_VERSION", umskt_abi_version());
+    PyModule_AddIntConstant(module, "KEY_LENGTH", UMSKT_KEY_LENGTH);
+    PyModule_AddIntConstant(module, "MODE_WINDOWS", UMSKT_MODE_WINDOWS);
+    PyModule_AddIntConstant(module, "MODE_OFFICE_XP", UMSKT_MODE_OFFICE_XP);
+    PyModule_AddIntConstant(module, "MODE_OFFICE_2K3", UMSKT_MODE_OFFICE_2K3);
+    PyModule_AddIntConstant(module, "MODE_OFFICE_2K7", UMSKT_MODE_OFFICE_2K7);
+    PyModule_AddIntConstant(module, "MODE_PLUS_DME", UMSKT_MODE_PLUS_DME);
+    PyModule_AddIntConstant(module, "MODE_OFFICE_ACC", UMSKT_MODE_OFFICE_ACC);
+
+    return module;
+}
@@ -0,0 +1,174 @@
+/**
+ * This file is a part of the UMSKT Project
+ *
+ * Copyleft (C) 2019-2023 UMSKT Contributors (et.al.)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @FileCreated by Neo on 10/18/2026
+ * @Maintainer Neo
+ */
+
+
+
+#include "request.h"
+#include "cli.h"
+
+bool RequestFields::readString(const json &request, const char *name, std::string &out) {
+    auto it = request.find(name);
+    if (it == request.end()) {
+        return true;
+    }
+    if (!it->is_string()) {
+        return false;
+    }
+    out = it->get<std::string>();
+    return true;
+}
+
+bool RequestFields::readInt(const json &request, const char *name, int &out) {
+    auto it = request.find(name);
+    if (it == request.end()) {
+        return true;
+    }
+    if (!it->is_number_integer()) {
+        return false;
+    }
+    out = it->get<int>();
+    return true;
+}
+
+bool RequestFields::readQWORD(const json &request, const char *name, QWORD &out) {
+    auto it = request.find(name);
+    if (it == request.end()) {
+        return true;
+    }
+    if (!it->is_number_unsigned()) {
+        return false;
+    }
+    out = it->get<QWORD>();
+    return true;
+}
+
+bool RequestFields::readBool(const json &request, const char *name, bool &out) {
+    auto it = request.find(name);
+    if (it == request.end()) {
+        return true;
+    }
+    if (!it->is_boolean()) {
+        return false;
+    }
+    out = it->get<bool>();
+    return true;
+}
+
+/* A serial is either a single number or a [min, max] pair. */
+bool RequestFields::readSerial(const json &request, const char *name, int &serMin, int &serMax) {
+    auto serial = request.find(name);
+    if (serial == request.end()) {
+        return true;
+    }
+
+    if (serial->is_number_integer()) {
+        serMin = serMax = serial->get<int>();
+    } else if (serial->is_array() && serial->size() == 2 && (*serial)[0].is_number_integer() && (*serial)[1].is_number_integer()) {
+        serMin = (*serial)[0].get<int>();
+        serMax = (*serial)[1].get<int>();
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+/* Looks up a BINK by its hex ID, returning its curve and whether it uses the 2002 scheme. */
+const PIDGEN3::BINKCurve *RequestFields::findBINK(const std::string &binkid, bool &bink2002, std::string &error) {
+    int intBinkID;
+    if (sscanf(binkid.c_str(), "%x", &intBinkID) != 1) {
+        error = "invalid BINK ID";
+        return nullptr;
+    }
+
+    // same restriction as the command line, see CLI::validateCommandLine
+    if (intBinkID >= 0xFE) {
+        error = "Terminal Services BINKs (FE and FF) are unsupported";
+        return nullptr;
+    }
+
+    const PIDGEN3::BINKCurve *curve = PIDGEN3::CurveRegistry::get(binkid);
+    if (curve == nullptr) {
+        error = fmt::format("BINK {} was not found in the keys file", binkid);
+        return nullptr;
+    }
+
+    bink2002 = intBinkID >= 0x40;
+    return curve;
+}
+
+bool RequestFields::parseActivationMode(std::string name, int &mode) {
+    static const std::pair<const char *, ACTIVATION_ALGORITHM> modes[] = {
+            { "WINDOWS",   WINDOWS },
+            { "OFFICEXP",  OFFICE_XP },
+            { "OFFICE2K3", OFFICE_2K3 },
+            { "OFFICE2K7", OFFICE_2K7 },
+            { "PLUSDME",   PLUS_DME },
+            { "OFFICEACC", OFFICE_ACC },
+    };
+
+    for (char &c : name) {
+        c = toupper((unsigned char)c);
+    }
+
+    for (auto &entry : modes) {
+        if (name == entry.first) {
+            mode = entry.second;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/* Whether a product ID has one of the forms ConfirmationID::ParseProductID reads. */
+bool RequestFields::isProductID(const std::string &pid) {
+    int fields[4];
+    return ConfirmationID::ParseProductID(pid.c_str(), fields);
+}
+
+const char *RequestFields::confidError(int err) {
+    switch (err) {
+        case ERR_TOO_SHORT:
+            return "Installation ID is too short.";
+        case ERR_TOO_LARGE:
+            return "Installation ID is too long.";
+        case ERR_INVALID_CHARACTER:
+            return "Invalid character in installation ID.";
+        case ERR_INVALID_CHECK_DIGIT:
+            return "Installation ID checksum failed. Please check that it is typed correctly.";
+        case ERR_UNKNOWN_VERSION:
+            return "Unknown installation ID version.";
+        case ERR_UNLUCKY:
+            return "Unable to generate valid confirmation ID.";
+        case ERR_INVALID_CID:
+            return "Confirmation ID is malformed or a check digit is wrong.";
+        case ERR_CID_NOT_ON_CURVE:
+            return "Confirmation ID does not decode to a valid confirmation ID.";
+        case ERR_MISMATCH:
+            return "Confirmation ID does not belong to this installation ID.";
+        case ERR_INVALID_PRODUCT_ID:
+            return "Product ID is not of the form 12345-123-1234567-12345.";
+        default:
+            return "Unknown error occurred during Confirmation ID generation.";
+    }
+}
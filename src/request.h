@@ -0,0 +1,54 @@
+/**
+ * This file is a part of the UMSKT Project
+ *
+ * Copyleft (C) 2019-2023 UMSKT Contributors (et.al.)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @FileCreated by Neo on 10/18/2026
+ * @Maintainer Neo
+ */
+
+
+
+#ifndef UMSKT_REQUEST_H
+#define UMSKT_REQUEST_H
+
+#include "header.h"
+
+#include "libumskt/libumskt.h"
+#include "libumskt/pidgen3/CurveRegistry.h"
+
+/*
+ * Field parsing shared by everything that takes requests as JSON objects,
+ * the serve mode and batch manifests.
+ *
+ * The readers leave out untouched when the field is missing and fail on a wrong type,
+ * get<>() on a mismatched type would abort the whole process since we build without exceptions.
+ */
+class RequestFields {
+public:
+    static bool readString(const json &request, const char *name, std::string &out);
+    static bool readInt(const json &request, const char *name, int &out);
+    static bool readQWORD(const json &request, const char *name, QWORD &out);
+    static bool readBool(const json &request, const char *name, bool &out);
+    static bool readSerial(const json &request, const char *name, int &serMin, int &serMax);
+
+    static const PIDGEN3::BINKCurve *findBINK(const std::string &binkid, bool &bink2002, std::string &error);
+    static bool parseActivationMode(std::string name, int &mode);
+    static bool isProductID(const std::string &pid);
+    static const char *confidError(int err);
+};
+
+#endif //UMSKT_REQUEST_H
@@ -0,0 +1,210 @@
+/**
+ * This file is a part of the UMSKT Project
+ *
+ * Copyleft (C) 2019-2023 UMSKT Contributors (et.al.)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @FileCreated by Neo on 10/18/2026
+ * @Maintainer Neo
+ */
+
+
+#include "resultcache.h"
+#include "checkpoint.h"
+
+#include <functional>
+
+/* capacity is spread evenly over the shards, rounded up. */
+ResultCache::ResultCache(size_t capacity) :
+    shardCapacity(std::max<size_t>(1, (capacity + RESULTCACHE_SHARDS - 1) / RESULTCACHE_SHARDS)),
+    shards(new Shard[RESULTCACHE_SHARDS]), hits(0), misses(0), evictions(0) {
+    for (int i = 0; i < RESULTCACHE_SHARDS; i++) {
+        shards[i].hand = 0;
+    }
+}
+
+ResultCache::Shard &ResultCache::shardFor(const std::string &key) {
+    // the top bits, the map inside the shard buckets by the bottom ones
+    size_t h = std::hash<std::string>()(key);
+    return shards[(h >> (sizeof(size_t) * 8 - 8)) % RESULTCACHE_SHARDS];
+}
+
+bool ResultCache::lookup(const std::string &key, std::string &value) {
+    Shard &shard = shardFor(key);
+#if UMSKT_THREADS
+    std::lock_guard<std::mutex> guard(shard.lock);
+#endif
+    auto it = shard.index.find(key);
+
+    if (it == shard.index.end()) {
+        misses.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    Entry &entry = shard.entries[it->second];
+    entry.referenced = true;
+    value = entry.value;
+
+    hits.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void ResultCache::insert(const std::string &key, const std::string &value) {
+    Shard &shard = shardFor(key);
+#if UMSKT_THREADS
+    std::lock_guard<std::mutex> guard(shard.lock);
+#endif
+    auto it = shard.index.find(key);
+
+    if (it != shard.index.end()) {
+        shard.entries[it->second].value = value;
+        return;
+    }
+
+    if (shard.entries.size() < shardCapacity) {
+        shard.index.emplace(key, shard.entries.size());
+        shard.entries.push_back(Entry { key, value, false });
+        return;
+    }
+
+    // CLOCK: give every referenced entry a second chance, take the first one that has none left
+    while (shard.entries[shard.hand].referenced) {
+        shard.entries[shard.hand].referenced = false;
+        shard.hand = (shard.hand + 1) % shard.entries.size();
+    }
+
+    Entry &victim = shard.entries[shard.hand];
+    shard.index.erase(victim.key);
+    shard.index.emplace(key, shard.hand);
+
+    victim.key = key;
+    victim.value = value;
+    victim.referenced = false;
+
+    shard.hand = (shard.hand + 1) % shard.entries.size();
+    evictions.fetch_add(1, std::memory_order_relaxed);
+}
+
+/* Installation IDs are compared without their dashes and spaces, the parser ignores those too. */
+std::string ResultCache::confidKey(int mode, const std::string &instid, const std::string &productid, bool overrideVersion) {
+    std::string key = fmt::format("C{}{}", mode, overrideVersion ? 'o' : '-');
+
+    for (char c : instid) {
+        if (c != ' ' && c != '-') {
+            key.push_back(c);
+        }
+    }
+
+    key.push_back('/');
+    key.append(productid);
+    return key;
+}
+
+std::string ResultCache::validateKey(const std::string &binkid, const QWORD (&pRaw)[2]) {
+    std::string key = "V" + binkid + "/";
+    key.append((const char *)pRaw, sizeof(pRaw));
+    return key;
+}
+
+size_t ResultCache::size() {
+    size_t total = 0;
+
+    for (int i = 0; i < RESULTCACHE_SHARDS; i++) {
+#if UMSKT_THREADS
+        std::lock_guard<std::mutex> guard(shards[i].lock);
+#endif
+        total += shards[i].entries.size();
+    }
+
+    return total;
+}
+
+double ResultCache::hitRate() const {
+    QWORD found = hits.load(), lookups = found + misses.load();
+    return lookups ? (double)found / lookups : 0.0;
+}
+
+json ResultCache::status() {
+    return json {
+            { "entries", size() },
+            { "capacity", capacity() },
+            { "hits", hits.load() },
+            { "misses", misses.load() },
+            { "evictions", evictions.load() },
+            { "hit_rate", hitRate() },
+    };
+}
+
+/* Writes every entry to filename, replacing it atomically. */
+bool ResultCache::save(const std::string &filename) {
+    std::string data(RESULTCACHE_MAGIC, RESULTCACHE_MAGIC_LENGTH);
+    DWORD version = RESULTCACHE_VERSION;
+    data.append((const char *)&version, sizeof(version));
+
+    for (int i = 0; i < RESULTCACHE_SHARDS; i++) {
+#if UMSKT_THREADS
+        std::lock_guard<std::mutex> guard(shards[i].lock);
+#endif
+        for (const Entry &entry : shards[i].entries) {
+            DWORD lengths[2] = { (DWORD)entry.key.size(), (DWORD)entry.value.size() };
+            data.append((const char *)lengths, sizeof(lengths));
+            data.append(entry.key);
+            data.append(entry.value);
+        }
+    }
+
+    return Checkpoint::replaceFile(filename, data);
+}
+
+/* Fills the cache from a snapshot, a missing file is an empty cache and not an error. */
+bool ResultCache::load(const std::string &filename) {
+    std::error_code error;
+    if (!fs::exists(filename, error)) {
+        return true;
+    }
+
+    std::ifstream file(filename, std::ios::binary);
+    std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    DWORD version = 0;
+    if (data.size() < RESULTCACHE_MAGIC_LENGTH + sizeof(version) || data.compare(0, RESULTCACHE_MAGIC_LENGTH, RESULTCACHE_MAGIC) != 0) {
+        return false;
+    }
+
+    memcpy(&version, &data[RESULTCACHE_MAGIC_LENGTH], sizeof(version));
+    if (version != RESULTCACHE_VERSION) {
+        return false;
+    }
+
+    size_t at = RESULTCACHE_MAGIC_LENGTH + sizeof(version);
+    while (at < data.size()) {
+        DWORD lengths[2];
+        if (data.size() - at < sizeof(lengths)) {
+            return false;
+        }
+
+        memcpy(lengths, &data[at], sizeof(lengths));
+        at += sizeof(lengths);
+
+        if (data.size() - at < (size_t)lengths[0] + lengths[1]) {
+            return false;
+        }
+
+        insert(data.substr(at, lengths[0]), data.substr(at + lengths[0], lengths[1]));
+        at += (size_t)lengths[0] + lengths[1];
+    }
+
+    return true;
+}
@@ -0,0 +1,98 @@
+/**
+ * This file is a part of the UMSKT Project
+ *
+ * Copyleft (C) 2019-2023 UMSKT Contributors (et.al.)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @FileCreated by Neo on 10/18/2026
+ * @Maintainer Neo
+ */
+
+
+#ifndef UMSKT_RESULTCACHE_H
+#define UMSKT_RESULTCACHE_H
+
+#include "header.h"
+
+#include "libumskt/libumskt.h"
+
+#include <atomic>
+#include <memory>
+#include <unordered_map>
+
+#if UMSKT_THREADS
+#include <mutex>
+#endif
+
+#define RESULTCACHE_SHARDS          16
+#define RESULTCACHE_MAGIC           "UMSKTRCS"
+#define RESULTCACHE_MAGIC_LENGTH    8
+#define RESULTCACHE_VERSION         1
+
+/*
+ * Bounded cache of confirmation IDs and validation results, see --cache.
+ *
+ * Keys go to one of RESULTCACHE_SHARDS shards by hash, each with its own lock, so
+ * concurrent lookups only contend when they land on the same shard. A full shard
+ * evicts with CLOCK: a hit only sets the entry's reference bit, the hand clears bits
+ * as it sweeps and takes the first entry that wasn't used since the last pass.
+ *
+ * Only what can't change is cached, confirmation IDs and signature checks. Snapshots
+ * are a flat file of length prefixed key/value pairs in host byte order.
+ */
+class ResultCache {
+    struct Entry {
+        std::string key;
+        std::string value;
+        bool referenced;
+    };
+
+    struct Shard {
+        std::vector<Entry> entries;
+        std::unordered_map<std::string, size_t> index;
+        size_t hand;
+#if UMSKT_THREADS
+        std::mutex lock;
+#endif
+    };
+
+    size_t shardCapacity;
+    std::unique_ptr<Shard[]> shards;
+
+    std::atomic<QWORD> hits;
+    std::atomic<QWORD> misses;
+    std::atomic<QWORD> evictions;
+
+    Shard &shardFor(const std::string &key);
+
+public:
+    explicit ResultCache(size_t capacity);
+
+    bool lookup(const std::string &key, std::string &value);
+    void insert(const std::string &key, const std::string &value);
+
+    static std::string confidKey(int mode, const std::string &instid, const std::string &productid, bool overrideVersion);
+    static std::string validateKey(const std::string &binkid, const QWORD (&pRaw)[2]);
+
+    size_t size();
+    size_t capacity() const { return shardCapacity * RESULTCACHE_SHARDS; }
+    double hitRate() const;
+    json status();
+
+    bool save(const std::string &filename);
+    bool load(const std::string &filename);
+};
+
+#endif //UMSKT_RESULTCACHE_H
@@ -0,0 +1,164 @@
+/**
+ * This file is a part of the UMSKT Project
+ *
+ * Copyleft (C) 2019-2023 UMSKT Contributors (et.al.)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @FileCreated by Neo on 10/18/2026
+ * @Maintainer Neo
+ */
+
+
+#ifndef UMSKT_RINGBUFFER_H
+#define UMSKT_RINGBUFFER_H
+
+#include "typedefs.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+#define RING_CACHE_LINE         64
+
+/*
+ * Bounded lock-free ring buffer.
+ *
+ * Every slot carries a sequence number telling producers and consumers whose turn it
+ * is, so any number of threads can push and pop concurrently without a lock, and the
+ * single producer/consumer cases cost no more than one CAS per operation.
+ *
+ * A full ring makes tryPush fail, which is how stages push back on the ones before them.
+ */
+template <typename T>
+class RingBuffer {
+    struct Slot {
+        std::atomic<size_t> sequence;
+        T data;
+    };
+
+    std::unique_ptr<Slot[]> slots;
+    size_t mask;
+
+    alignas(RING_CACHE_LINE) std::atomic<size_t> head;
+    alignas(RING_CACHE_LINE) std::atomic<size_t> tail;
+
+public:
+    // capacity is rounded up to the next power of two
+    explicit RingBuffer(size_t capacity) : head(0), tail(0) {
+        size_t size = 2;
+        while (size < capacity) {
+            size <<= 1;
+        }
+
+        slots.reset(new Slot[size]);
+        mask = size - 1;
+
+        for (size_t i = 0; i < size; i++) {
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    RingBuffer(const RingBuffer &) = delete;
+    RingBuffer &operator=(const RingBuffer &) = delete;
+
+    bool tryPush(const T &item) {
+        size_t position = tail.load(std::memory_order_relaxed);
+
+        for (;;) {
+            Slot &slot = slots[position & mask];
+            size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)sequence - (intptr_t)position;
+
+            if (diff == 0) {
+                if (tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    slot.data = item;
+                    slot.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false; // full
+            } else {
+                position = tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool tryPop(T &item) {
+        size_t position = head.load(std::memory_order_relaxed);
+
+        for (;;) {
+            Slot &slot = slots[position & mask];
+            size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)sequence - (intptr_t)(position + 1);
+
+            if (diff == 0) {
+                if (head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    item = slot.data;
+                    slot.sequence.store(position + mask + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false; // empty
+            } else {
+                position = head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+};
+
+/* Spins for a short while, then yields, then sleeps - cheap when the other side is just behind, quiet when it's stalled. */
+class Backoff {
+    int rounds = 0;
+
+public:
+    void pause() {
+        if (rounds < 64) {
+            rounds++;
+        } else if (rounds < 128) {
+            rounds++;
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    }
+};
+
+/* Pushes an item, waiting for room if the consumer has fallen behind. */
+template <typename T>
+void ringPush(RingBuffer<T> &ring, const T &item) {
+    Backoff backoff;
+    while (!ring.tryPush(item)) {
+        backoff.pause();
+    }
+}
+
+/*
+ * Pops an item, waiting for one to arrive while producers are still running.
+ * Returns false once every producer has finished and the ring is drained.
+ */
+template <typename T>
+bool ringPop(RingBuffer<T> &ring, T &item, const std::atomic<int> &producers) {
+    Backoff backoff;
+    while (!ring.tryPop(item)) {
+        if (producers.load(std::memory_order_acquire) == 0) {
+            return ring.tryPop(item);
+        }
+        backoff.pause();
+    }
+    return true;
+}
+
+#endif //UMSKT_RINGBUFFER_H
@@ -0,0 +1,776 @@
+/**
+ * This file is a part of the UMSKT Project
+ *
+ * Copyleft (C) 2019-2023 UMSKT Contributors (et.al.)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @FileCreated by Neo on 10/18/2026
+ * @Maintainer Neo
+ */
+
+
+#include "server.h"
+#include "cli.h"
+#include "request.h"
+
+#if UMSKT_HAVE_SERVER
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+
+namespace {
+    json failure(const std::string &message) {
+        return json { { "ok", false }, { "error", message } };
+    }
+}
+
+KeyServer::KeyServer(const ServerConfig &config) :
+    config(config), pools(config.poolSize, config.poolDir), stopping(false)
+#if UMSKT_HAVE_SERVER
+    , pool(config.workers)
+#endif
+{
+    // read-only, the bulk generator owns writing to it
+    if (!config.ledgerFile.empty()) {
+        ledger.reset(KeyLedger::open(config.ledgerFile, true));
+
+        if (!ledger) {
+            fmt::print(stderr, "WARNING: unable to open ledger {}, keys will not be looked up\n", config.ledgerFile);
+        }
+    }
+
+    if (config.cacheSize > 0) {
+        cache.reset(new ResultCache(config.cacheSize));
+
+        if (!config.cacheFile.empty() && !cache->load(config.cacheFile)) {
+            fmt::print(stderr, "WARNING: {} is not a cache snapshot, starting empty\n", config.cacheFile);
+        }
+    }
+}
+
+/* Answers a single request, never fails - problems are reported in the response. */
+json KeyServer::handle(const json &request) {
+    json response;
+
+    if (!request.is_object()) {
+        return failure("request must be a JSON object");
+    }
+
+    std::string op;
+    if (!RequestFields::readString(request, "op", op) || op.empty()) {
+        response = failure("missing \"op\"");
+    } else if (op == "generate") {
+        response = generate(request);
+    } else if (op == "validate") {
+        response = validate(request);
+    } else if (op == "confid") {
+        response = confirmationID(request);
+    } else if (op == "list") {
+        response = json { { "ok", true }, { "binks", PIDGEN3::CurveRegistry::list() } };
+    } else if (op == "pools") {
+        response = json { { "ok", true }, { "pools", pools.status() } };
+    } else if (op == "cache") {
+        response = json { { "ok", true }, { "cache", cache ? cache->status() : json(nullptr) } };
+    } else if (op == "ping") {
+        response = json { { "ok", true } };
+    } else {
+        response = failure(fmt::format("unknown op \"{}\"", op));
+    }
+
+    auto id = request.find("id");
+    if (id != request.end()) {
+        response["id"] = *id;
+    }
+
+    return response;
+}
+
+json KeyServer::generate(const json &request) {
+    std::string binkid = "2E";
+    int count = 1, channelID = 640;
+    int serMin = 0, serMax = 999999;
+    bool upgrade = false, dashes = true;
+
+    if (!RequestFields::readString(request, "bink", binkid) || !RequestFields::readInt(request, "count", count) ||
+        !RequestFields::readInt(request, "channel", channelID) || !RequestFields::readBool(request, "upgrade", upgrade) ||
+        !RequestFields::readBool(request, "dashes", dashes)) {
+        return failure("invalid field type");
+    }
+
+    if (!RequestFields::readSerial(request, "serial", serMin, serMax)) {
+        return failure("\"serial\" must be a number or a [min, max] pair");
+    }
+
+    if (count < 1 || count > SERVER_MAX_COUNT) {
+        return failure(fmt::format("\"count\" must be between 1 and {}", SERVER_MAX_COUNT));
+    }
+
+    if (channelID < 0 || channelID > 999) {
+        return failure("refusing to create a key with a Channel ID not between 000 and 999");
+    }
+
+    if (serMin < 0 || serMax > 999999 || serMin > serMax) {
+        return failure("refusing to create a key with a Serial not between 000000 and 999999");
+    }
+
+    bool bink2002;
+    std::string error;
+    const PIDGEN3::BINKCurve *curve = RequestFields::findBINK(binkid, bink2002, error);
+    if (curve == nullptr) {
+        return failure(error);
+    }
+
+    // BINK1998 picks one serial per run, just like the command line does
+    DWORD nRaw = channelID * 1'000'000 + KeyShards::pickSerial(serMin, serMax, false, 0);
+
+    json keys = json::array();
+    char key[PK_LENGTH + 4 + NULL_TERMINATOR];
+    char pk[PK_LENGTH + NULL_TERMINATOR];
+
+    KeyPool *pool = pools.get(PoolProfile { binkid, (DWORD)channelID, (DWORD)serMin, (DWORD)serMax, upgrade });
+    if (pool != nullptr) {
+        QWORD pRaw[2];
+
+        while (keys.size() < (size_t)count && pool->take(pRaw)) {
+            PIDGEN3::base24(pk, (BYTE *)pRaw);
+            OutputWriter::formatKey(key, pk, dashes);
+            keys.push_back(key);
+        }
+    }
+
+    // a handful of keys fail verification, give up on a request that keeps failing instead of spinning forever
+    for (int attempts = 4 * count + 16; keys.size() < (size_t)count && attempts > 0; attempts--) {
+        QWORD pRaw[2]{};
+        bool isValid;
+
+        if (bink2002) {
+            DWORD pAuthInfo, pSerial;
+            UMSKT::umskt_rand_bytes((BYTE *)&pAuthInfo, 4);
+            pAuthInfo &= BITMASK(10);
+
+            // a narrow serial range can take minutes per key, shutting down must not wait for that
+            if (!PIDGEN3::BINK2002::Generate(*curve, channelID, pAuthInfo, upgrade, serMin, serMax, &pSerial, pRaw, &stopping)) {
+                return failure("server is shutting down");
+            }
+            isValid = PIDGEN3::BINK2002::Verify(*curve, &pSerial, pRaw);
+        } else {
+            PIDGEN3::BINK1998::Generate(*curve, nRaw, upgrade, pRaw);
+            isValid = PIDGEN3::BINK1998::Verify(*curve, pRaw);
+        }
+
+        if (isValid) {
+            PIDGEN3::base24(pk, (BYTE *)pRaw);
+            OutputWriter::formatKey(key, pk, dashes);
+            keys.push_back(key);
+        }
+    }
+
+    if (keys.size() < (size_t)count) {
+        return failure("unable to generate valid keys");
+    }
+
+    return json { { "ok", true }, { "bink", binkid }, { "keys", keys } };
+}
+
+json KeyServer::validate(const json &request) {
+    std::string binkid = "2E", keyToCheck;
+
+    if (!RequestFields::readString(request, "bink", binkid) || !RequestFields::readString(request, "key", keyToCheck)) {
+        return failure("invalid field type");
+    }
+
+    char product_key[PK_LENGTH]{};
+    if (!CLI::stripKey(keyToCheck.c_str(), product_key)) {
+        return failure("Product key is in an incorrect format");
+    }
+
+    bool bink2002;
+    std::string error;
+    const PIDGEN3::BINKCurve *curve = RequestFields::findBINK(binkid, bink2002, error);
+    if (curve == nullptr) {
+        return failure(error);
+    }
+
+    QWORD pRaw[2]{};
+    PIDGEN3::unbase24((BYTE *)pRaw, product_key);
+
+    json response = json { { "ok", true }, { "bink", binkid } };
+
+    BOOL pUpgrade;
+    DWORD pHash;
+    QWORD pSignature;
+
+    // cached as valid, channel, serial, upgrade
+    std::string cacheKey, cached;
+    DWORD result[4];
+
+    if (cache) {
+        cacheKey = ResultCache::validateKey(binkid, pRaw);
+    }
+
+    if (cache && cache->lookup(cacheKey, cached) && cached.size() == sizeof(result)) {
+        memcpy(result, cached.data(), sizeof(result));
+
+        response["valid"] = (bool)result[0];
+        if (result[0]) {
+            response["channel"] = result[1];
+            response["serial"] = result[2];
+            response["upgrade"] = (bool)result[3];
+        }
+    } else if (bink2002) {
+        DWORD pSerial = 0, pChannelID, pAuthInfo;
+        bool isValid = PIDGEN3::BINK2002::Verify(*curve, &pSerial, pRaw);
+
+        response["valid"] = isValid;
+        if (isValid) {
+            PIDGEN3::BINK2002::Unpack(pRaw, pUpgrade, pChannelID, pHash, pSignature, pAuthInfo);
+            response["channel"] = pChannelID;
+            response["serial"] = pSerial;
+            response["upgrade"] = (bool)pUpgrade;
+        }
+    } else {
+        bool isValid = PIDGEN3::BINK1998::Verify(*curve, pRaw);
+
+        response["valid"] = isValid;
+        if (isValid) {
+            DWORD nRaw;
+            PIDGEN3::BINK1998::Unpack(pRaw, pUpgrade, nRaw, pHash, pSignature);
+            response["channel"] = nRaw / 1'000'000;
+            response["serial"] = nRaw % 1'000'000;
+            response["upgrade"] = (bool)pUpgrade;
+        }
+    }
+
+    if (cache && cached.empty()) {
+        bool isValid = response["valid"];
+        result[0] = isValid;
+        result[1] = isValid ? (DWORD)response["channel"] : 0;
+        result[2] = isValid ? (DWORD)response["serial"] : 0;
+        result[3] = isValid && (bool)response["upgrade"];
+        cache->insert(cacheKey, std::string((const char *)result, sizeof(result)));
+    }
+
+    if (ledger) {
+        BYTE intBinkID = 0;
+        KeyFile::parseBINK(binkid, &intBinkID);
+
+        LedgerRecord entry;
+        if (ledger->lookup(intBinkID, pRaw, &entry)) {
+            response["issued"] = json {
+                    { "timestamp", entry.timestamp },
+                    { "channel", entry.channelID },
+                    { "serial", entry.serial },
+            };
+        } else {
+            response["issued"] = false;
+        }
+    }
+
+    return response;
+}
+
+json KeyServer::confirmationID(const json &request) {
+    std::string instid, modeName = "WINDOWS", productid;
+    bool overrideVersion = false;
+    int mode;
+
+    if (!RequestFields::readString(request, "iid", instid) || !RequestFields::readString(request, "mode", modeName) ||
+        !RequestFields::readString(request, "productid", productid) || !RequestFields::readBool(request, "override", overrideVersion)) {
+        return failure("invalid field type");
+    }
+
+    if (!RequestFields::parseActivationMode(modeName, mode)) {
+        return failure(fmt::format("unknown activation mode \"{}\"", modeName));
+    }
+
+    if ((mode == OFFICE_2K3 || mode == OFFICE_2K7) && !RequestFields::isProductID(productid)) {
+        return failure("a product ID of the form 12345-123-1234567-12345 is required for this mode");
+    }
+
+    std::string cacheKey, cached;
+    if (cache) {
+        cacheKey = ResultCache::confidKey(mode, instid, productid, overrideVersion);
+
+        if (cache->lookup(cacheKey, cached)) {
+            return json { { "ok", true }, { "cid", cached } };
+        }
+    }
+
+    char confirmation_id[49];
+    int err = ConfirmationID::Generate(instid.c_str(), confirmation_id, mode, productid.c_str(), overrideVersion);
+
+    if (err != SUCCESS) {
+        return failure(RequestFields::confidError(err));
+    }
+
+    if (cache) {
+        cache->insert(cacheKey, confirmation_id);
+    }
+
+    return json { { "ok", true }, { "cid", confirmation_id } };
+}
+
+#if UMSKT_HAVE_SERVER
+namespace {
+    volatile std::sig_atomic_t stopRequested = 0;
+
+    void onStopSignal(int) {
+        stopRequested = 1;
+    }
+
+    /* Writes all of data, returns false once the peer is gone. */
+    bool sendAll(int fd, const std::string &data) {
+        size_t sent = 0;
+
+        while (sent < data.size()) {
+            ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return false;
+            }
+            sent += n;
+        }
+
+        return true;
+    }
+
+    /* Appends what is available to buffer without waiting, returns false on EOF or error. */
+    bool receive(int fd, std::string &buffer) {
+        char chunk[16 * 1024];
+
+        // past a full request, the rest waits for the next turn
+        while (buffer.size() <= SERVER_MAX_REQUEST) {
+            ssize_t n = recv(fd, chunk, sizeof(chunk), MSG_DONTWAIT);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                return true;
+            }
+            if (n <= 0) {
+                return false;
+            }
+            buffer.append(chunk, n);
+        }
+
+        return true;
+    }
+}
+
+int KeyServer::listenUnix() {
+    if (config.socketPath.size() >= sizeof(sockaddr_un::sun_path)) {
+        fmt::print(stderr, "ERROR: socket path {} is too long\n", config.socketPath);
+        return -1;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, config.socketPath.c_str());
+
+    // a stale socket from a previous run would make bind fail
+    unlink(config.socketPath.c_str());
+
+    if (bind(fd, (sockaddr *)&address, sizeof(address)) < 0 || listen(fd, SOMAXCONN) < 0) {
+        fmt::print(stderr, "ERROR: unable to listen on {}: {}\n", config.socketPath, strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+int KeyServer::listenTCP() {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+
+    int yes = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+    // loopback only, there is no authentication of any kind
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(config.port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (bind(fd, (sockaddr *)&address, sizeof(address)) < 0 || listen(fd, SOMAXCONN) < 0) {
+        fmt::print(stderr, "ERROR: unable to listen on 127.0.0.1:{}: {}\n", config.port, strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+/* Newline delimited JSON, answers every complete line in the buffer, returns false once the connection has to go. */
+bool KeyServer::serveLines(Connection &connection) {
+    std::string &buffer = connection.buffer;
+
+    while (!stopRequested) {
+        size_t eol = buffer.find('\n', connection.scanned);
+
+        if (eol == std::string::npos) {
+            if (buffer.size() > SERVER_MAX_REQUEST) {
+                sendAll(connection.fd, failure("request too large").dump() + "\n");
+                return false;
+            }
+
+            connection.scanned = buffer.size();
+            return true;
+        }
+
+        std::string line = buffer.substr(0, eol);
+        buffer.erase(0, eol + 1);
+        connection.scanned = 0;
+
+        if (line.find_first_not_of(" \t\r") == std::string::npos) {
+            continue;
+        }
+
+        json request = json::parse(line, nullptr, false, false);
+        json response = request.is_discarded() ? failure("malformed JSON") : handle(request);
+
+        if (!sendAll(connection.fd, response.dump() + "\n")) {
+            return false;
+        }
+    }
+
+    return false;
+}
+
+/*
+ * Just enough HTTP/1.1 for curl and the usual client libraries: Content-Length bodies and keep-alive.
+ * Answers every complete request in the buffer, returns false once the connection has to go.
+ */
+bool KeyServer::serveHTTP(Connection &connection) {
+    std::string &buffer = connection.buffer;
+
+    while (!stopRequested) {
+        size_t headerEnd = buffer.find("\r\n\r\n");
+        if (headerEnd == std::string::npos) {
+            return buffer.size() <= SERVER_MAX_REQUEST;
+        }
+
+        std::string head = buffer.substr(0, headerEnd);
+
+        char method[16] = {}, path[256] = {};
+        if (sscanf(head.c_str(), "%15s %255s", method, path) != 2) {
+            return false;
+        }
+
+        size_t contentLength = 0;
+        bool keepAlive = head.find("HTTP/1.0") == std::string::npos;
+
+        // header names are case insensitive, lowercase a copy to look them up
+        std::string lower = head;
+        for (char &c : lower) {
+            c = tolower((unsigned char)c);
+        }
+
+        size_t pos = lower.find("\r\ncontent-length:");
+        if (pos != std::string::npos) {
+            contentLength = strtoul(lower.c_str() + pos + 17, nullptr, 10);
+        }
+
+        pos = lower.find("\r\nconnection:");
+        if (pos != std::string::npos) {
+            std::string value = lower.substr(pos + 13, lower.find("\r\n", pos + 13) - pos - 13);
+            if (value.find("close") != std::string::npos) {
+                keepAlive = false;
+            } else if (value.find("keep-alive") != std::string::npos) {
+                keepAlive = true;
+            }
+        }
+
+        if (contentLength > SERVER_MAX_REQUEST) {
+            sendAll(connection.fd, "HTTP/1.1 413 Payload Too Large\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+            return false;
+        }
+
+        // the rest of the body comes with a later read
+        if (buffer.size() < headerEnd + 4 + contentLength) {
+            return true;
+        }
+
+        std::string body = buffer.substr(headerEnd + 4, contentLength);
+        buffer.erase(0, headerEnd + 4 + contentLength);
+
+        int status = 200;
+        json response;
+
+        if (strcmp(method, "GET") == 0 && strcmp(path, "/health") == 0) {
+            response = json { { "ok", true } };
+        } else if (strcmp(method, "POST") != 0) {
+            status = 405;
+            response = failure("only POST is supported");
+        } else {
+            json request = json::parse(body, nullptr, false, false);
+
+            if (request.is_discarded()) {
+                response = failure("malformed JSON");
+            } else {
+                // POST /generate is the same as POST / with "op": "generate"
+                if (request.is_object() && strlen(path) > 1 && !request.contains("op")) {
+                    request["op"] = path + 1;
+                }
+                response = handle(request);
+            }
+
+            if (!response["ok"].get<bool>()) {
+                status = 400;
+            }
+        }
+
+        std::string payload = response.dump();
+        std::string reply = fmt::format("HTTP/1.1 {} {}\r\nContent-Type: application/json\r\nContent-Length: {}\r\nConnection: {}\r\n\r\n",
+                                        status, status == 200 ? "OK" : status == 405 ? "Method Not Allowed" : "Bad Request",
+                                        payload.size(), keepAlive ? "keep-alive" : "close");
+        reply += payload;
+
+        if (!sendAll(connection.fd, reply) || !keepAlive) {
+            return false;
+        }
+    }
+
+    return false;
+}
+
+/* Runs on a worker: reads what the connection has, answers it and hands the connection back to the poll loop. */
+void KeyServer::serveConnection(int fd) {
+    Connection *connection;
+    {
+        std::lock_guard<std::mutex> guard(connectionLock);
+        connection = &connections.at(fd);
+    }
+
+    // requests that came in right before the peer hung up still get their answers
+    bool open = receive(fd, connection->buffer);
+    bool keep = !stopRequested && (connection->http ? serveHTTP(*connection) : serveLines(*connection)) && open;
+
+    {
+        std::lock_guard<std::mutex> guard(connectionLock);
+        if (keep) {
+            connection->busy = false;
+            connection->lastActive = std::time(nullptr);
+        } else {
+            close(fd);
+            connections.erase(fd);
+        }
+    }
+
+    char signal = 0;
+    while (write(wakeup[1], &signal, 1) < 0 && errno == EINTR) {
+    }
+}
+
+void KeyServer::accept(int listener, bool http) {
+    int fd = ::accept(listener, nullptr, nullptr);
+    if (fd < 0) {
+        return;
+    }
+
+    // answers are sent blocking, a peer that stops reading can't hold a worker forever
+    timeval timeout { SERVER_IDLE_TIMEOUT, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    std::lock_guard<std::mutex> guard(connectionLock);
+    connections[fd] = Connection { fd, http, false, std::time(nullptr), std::string(), 0 };
+}
+
+/* Hands every connection with something to read to a worker, one request batch at a time. */
+void KeyServer::dispatch(const std::vector<int> &ready) {
+    {
+        std::lock_guard<std::mutex> guard(connectionLock);
+        for (int fd : ready) {
+            connections.at(fd).busy = true;
+        }
+    }
+
+    for (int fd : ready) {
+        pool.submit([this, fd] {
+            serveConnection(fd);
+        });
+    }
+}
+
+void KeyServer::dropIdle() {
+    time_t now = std::time(nullptr);
+
+    std::lock_guard<std::mutex> guard(connectionLock);
+    for (auto it = connections.begin(); it != connections.end();) {
+        if (!it->second.busy && now - it->second.lastActive >= SERVER_IDLE_TIMEOUT) {
+            close(it->first);
+            it = connections.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+int KeyServer::run() {
+    if (config.socketPath.empty() && config.port <= 0) {
+        fmt::print(stderr, "ERROR: serve needs --socket PATH and/or --port N\n");
+        return 1;
+    }
+
+    int listeners[2] = { -1, -1 };
+    bool isHTTP[2] = { false, true };
+
+    if (!config.socketPath.empty() && (listeners[0] = listenUnix()) < 0) {
+        return 1;
+    }
+
+    if (config.port > 0 && (listeners[1] = listenTCP()) < 0) {
+        if (listeners[0] >= 0) {
+            close(listeners[0]);
+            unlink(config.socketPath.c_str());
+        }
+        return 1;
+    }
+
+    int restored = pools.load();
+    if (restored) {
+        fmt::print(stderr, "umskt: restored {} key pools from {}\n", restored, config.poolDir);
+    }
+
+    stopRequested = 0;
+    std::signal(SIGINT, onStopSignal);
+    std::signal(SIGTERM, onStopSignal);
+    std::signal(SIGPIPE, SIG_IGN);
+
+    fmt::print(stderr, "umskt: serving with {} workers", pool.size());
+    if (listeners[0] >= 0) {
+        fmt::print(stderr, " on {}", config.socketPath);
+    }
+    if (listeners[1] >= 0) {
+        fmt::print(stderr, " on http://127.0.0.1:{}", config.port);
+    }
+    fmt::print(stderr, "\n");
+
+    if (pipe(wakeup) < 0) {
+        fmt::print(stderr, "ERROR: unable to create a pipe: {}\n", strerror(errno));
+        return 1;
+    }
+    fcntl(wakeup[0], F_SETFL, O_NONBLOCK);
+
+    std::vector<pollfd> fds;
+    std::vector<int> ready;
+
+    while (!stopRequested) {
+        fds.clear();
+        fds.push_back({ wakeup[0], POLLIN, 0 });
+
+        int which[2];
+        for (int i = 0; i < 2; i++) {
+            if (listeners[i] >= 0) {
+                which[fds.size() - 1] = i;
+                fds.push_back({ listeners[i], POLLIN, 0 });
+            }
+        }
+
+        // connections a worker is on are left out until it hands them back
+        size_t firstConnection = fds.size();
+        {
+            std::lock_guard<std::mutex> guard(connectionLock);
+            for (const auto &entry : connections) {
+                if (!entry.second.busy) {
+                    fds.push_back({ entry.first, POLLIN, 0 });
+                }
+            }
+        }
+
+        // wake up now and then to notice a stop request and drop idle connections
+        if (poll(fds.data(), fds.size(), 500) > 0) {
+            char drained[64];
+            while (read(wakeup[0], drained, sizeof(drained)) > 0) {
+            }
+
+            for (size_t j = 1; j < firstConnection; j++) {
+                if (fds[j].revents & POLLIN) {
+                    accept(fds[j].fd, isHTTP[which[j - 1]]);
+                }
+            }
+
+            ready.clear();
+            for (size_t j = firstConnection; j < fds.size(); j++) {
+                if (fds[j].revents & (POLLIN | POLLHUP | POLLERR)) {
+                    ready.push_back(fds[j].fd);
+                }
+            }
+            dispatch(ready);
+        }
+
+        dropIdle();
+    }
+
+    fmt::print(stderr, "umskt: shutting down\n");
+
+    // the pools and any key generated on the spot give up first, so the workers can be joined
+    stopping = true;
+    pools.stop();
+
+    for (int fd : listeners) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+    // kick workers out of any blocking sends, then wait for them
+    {
+        std::lock_guard<std::mutex> guard(connectionLock);
+        for (const auto &entry : connections) {
+            shutdown(entry.first, SHUT_RDWR);
+        }
+    }
+    pool.shutdown();
+
+    for (const auto &entry : connections) {
+        close(entry.first);
+    }
+    connections.clear();
+    close(wakeup[0]);
+    close(wakeup[1]);
+
+    if (cache && !config.cacheFile.empty() && !cache->save(config.cacheFile)) {
+        fmt::print(stderr, "WARNING: unable to save the cache to {}\n", config.cacheFile);
+    }
+
+    if (listeners[0] >= 0) {
+        unlink(config.socketPath.c_str());
+    }
+
+    return 0;
+}
+#else
+int KeyServer::run() {
+    fmt::print("ERROR: serve is not supported on this platform\n");
+    return 1;
+}
+#endif
@@ -0,0 +1,131 @@
+/**
+ * This file is a part of the UMSKT Project
+ *
+ * Copyleft (C) 2019-2023 UMSKT Contributors (et.al.)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @FileCreated by Neo on 10/18/2026
+ * @Maintainer Neo
+ */
+
+
+#ifndef UMSKT_SERVER_H
+#define UMSKT_SERVER_H
+
+#include "header.h"
+#include "keypool.h"
+#include "ledger.h"
+#include "resultcache.h"
+#include "threadpool.h"
+
+#include "libumskt/libumskt.h"
+
+#include <atomic>
+
+#if (defined(__unix__) || defined(__APPLE__)) && !defined(__DJGPP__) && UMSKT_THREADS
+#define UMSKT_HAVE_SERVER 1
+#else
+#define UMSKT_HAVE_SERVER 0
+#endif
+
+#if UMSKT_HAVE_SERVER
+#include <ctime>
+#include <map>
+#include <mutex>
+#endif
+
+#define SERVER_MAX_COUNT        10000
+#define SERVER_MAX_REQUEST      (1024 * 1024)
+#define SERVER_IDLE_TIMEOUT     30
+
+struct ServerConfig {
+    std::string socketPath;
+    std::string poolDir;
+    std::string ledgerFile;
+    int port;
+    int workers;
+    int poolSize;
+    int cacheSize;
+    std::string cacheFile;
+};
+
+/*
+ * Long running key service, see `umskt serve`.
+ *
+ * Every BINK is initialized once at startup and stays hot for the lifetime of the
+ * process. Requests are JSON objects with an "op" of "generate", "validate", "confid",
+ * "list" or "ping", answered with a JSON object that has "ok" set and echoes any "id".
+ *
+ *   --socket PATH  Unix domain socket, one request per line, one response per line
+ *   --port N       HTTP/1.1 on 127.0.0.1, POST the request (or POST /<op>), GET /health
+ *
+ * The main thread polls every open connection and hands one that has something to read
+ * to a worker of the pool, which answers the complete requests in it and gives the
+ * connection back, so idle keep-alive connections never hold a worker. Connections
+ * idle for SERVER_IDLE_TIMEOUT seconds are dropped.
+ *
+ * With a pool size set, generate requests are answered from a KeyPool per profile
+ * and only fall back to generating on the spot when the pool has run dry.
+ * With a ledger, validate also reports when and how a key was issued.
+ * With a cache, repeated confid and validate requests are answered from a ResultCache,
+ * the "cache" op reports how well that works.
+ */
+class KeyServer {
+#if UMSKT_HAVE_SERVER
+    /* An open client connection, owned by a worker while busy and by the poll loop otherwise. */
+    struct Connection {
+        int fd;
+        bool http;
+        bool busy;
+        time_t lastActive;
+        std::string buffer;     // received, not answered yet
+        size_t scanned;         // bytes of buffer known not to hold a full request line
+    };
+#endif
+
+    ServerConfig config;
+    KeyPoolSet pools;
+    std::unique_ptr<KeyLedger> ledger;
+    std::unique_ptr<ResultCache> cache;
+    std::atomic<bool> stopping;     // cancels keys being generated on the spot
+
+#if UMSKT_HAVE_SERVER
+    ThreadPool pool;
+    std::map<int, Connection> connections;
+    std::mutex connectionLock;
+    int wakeup[2];      // workers write to it to have a connection polled again
+
+    int listenUnix();
+    int listenTCP();
+    void accept(int listener, bool http);
+    void dispatch(const std::vector<int> &ready);
+    void dropIdle();
+    void serveConnection(int fd);
+    bool serveLines(Connection &connection);
+    bool serveHTTP(Connection &connection);
+#endif
+
+public:
+    explicit KeyServer(const ServerConfig &config);
+
+    json handle(const json &request);
+    json generate(const json &request);
+    json validate(const json &request);
+    json confirmationID(const json &request);
+
+    int run();
+};
+
+#endif //UMSKT_SERVER_H
@@ -0,0 +1,381 @@
+/**
+ * This file is a part of the UMSKT Project
+ *
+ * Copyleft (C) 2019-2023 UMSKT Contributors (et.al.)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @FileCreated by Neo on 10/18/2026
+ * @Maintainer Neo
+ */
+
+
+#include "shard.h"
+
+#include <algorithm>
+#include <memory>
+
+#include <openssl/evp.h>
+
+namespace {
+    std::string toHex(const BYTE *data, unsigned int length) {
+        static const char digits[] = "0123456789abcdef";
+
+        std::string hex;
+        for (unsigned int i = 0; i < length; i++) {
+            hex.push_back(digits[data[i] >> 4]);
+            hex.push_back(digits[data[i] & 0xF]);
+        }
+        return hex;
+    }
+
+    struct DigestDeleter {
+        void operator()(EVP_MD_CTX *ctx) const { EVP_MD_CTX_free(ctx); }
+    };
+
+    typedef std::unique_ptr<EVP_MD_CTX, DigestDeleter> Digest;
+
+    Digest newDigest() {
+        Digest digest(EVP_MD_CTX_new());
+        if (digest && !EVP_DigestInit_ex(digest.get(), EVP_sha256(), nullptr)) {
+            digest.reset();
+        }
+        return digest;
+    }
+
+    std::string finishDigest(Digest &digest) {
+        BYTE hash[EVP_MAX_MD_SIZE];
+        unsigned int length = 0;
+
+        EVP_DigestFinal_ex(digest.get(), hash, &length);
+        return toHex(hash, length);
+    }
+}
+
+/* Parses "i/N" as given to --shard. */
+bool KeyShards::parseSpec(const char *text, DWORD *index, DWORD *count) {
+    unsigned int i, n;
+    char end;
+
+    if (sscanf(text, "%u/%u%c", &i, &n, &end) != 2 || n == 0 || i >= n) {
+        return false;
+    }
+
+    *index = i;
+    *count = n;
+    return true;
+}
+
+/*
+ * The one serial a BINK1998 run uses for all of its keys. Seeded runs take it from a stream
+ * no key ever uses, so the command line, batch tasks and every shard of a job agree on it.
+ */
+DWORD KeyShards::pickSerial(DWORD serMin, DWORD serMax, bool seeded, QWORD seed) {
+    if (seeded) {
+        UMSKT::setRandomStream(seed, ~0ULL, 0);
+    }
+
+    BIGNUM *bnrand = BN_new();
+    UMSKT::umskt_bn_rand(bnrand, 19, BN_RAND_TOP_ANY, BN_RAND_BOTTOM_ANY);
+    UMSKT::clearRandomStream();
+
+    int oRaw;
+    char *cRaw = BN_bn2dec(bnrand);
+    sscanf(cRaw, "%d", &oRaw);
+    OPENSSL_free(cRaw);
+    BN_free(bnrand);
+
+    return serMin + (oRaw % (serMax - serMin + 1));
+}
+
+/* Keys shard index of count makes out of a job of total keys, the first total % count shards take one more. */
+QWORD KeyShards::shareOf(QWORD total, DWORD index, DWORD count) {
+    return total / count + (index < total % count);
+}
+
+std::string KeyShards::manifestPath(const std::string &output) {
+    return output + SHARD_MANIFEST_SUFFIX;
+}
+
+bool KeyShards::loadManifest(const std::string &filename, ShardManifest *manifest) {
+    std::ifstream f(filename);
+    if (!f) {
+        return false;
+    }
+
+    json data = json::parse(f, nullptr, false, false);
+    if (data.is_discarded() || !data.is_object() || data.value("version", 0) != SHARD_MANIFEST_VERSION || !manifest->job.fromJSON(data)) {
+        return false;
+    }
+
+    static const char *numbers[] = { "keys", "bytes", "header_bytes" };
+
+    for (const char *name : numbers) {
+        if (!data.contains(name) || !data[name].is_number_unsigned()) {
+            return false;
+        }
+    }
+
+    if (!data.contains("file") || !data["file"].is_string() || !data.contains("sha256") || !data["sha256"].is_string()) {
+        return false;
+    }
+
+    manifest->file = data["file"].get<std::string>();
+    manifest->keys = data["keys"].get<QWORD>();
+    manifest->bytes = data["bytes"].get<QWORD>();
+    manifest->headerBytes = data["header_bytes"].get<QWORD>();
+    manifest->sha256 = data["sha256"].get<std::string>();
+
+    return true;
+}
+
+bool KeyShards::saveManifest(const std::string &filename, const ShardManifest &manifest) {
+    json data = { { "version", SHARD_MANIFEST_VERSION } };
+    manifest.job.toJSON(data);
+
+    data["file"] = manifest.file;
+    data["keys"] = manifest.keys;
+    data["bytes"] = manifest.bytes;
+    data["header_bytes"] = manifest.headerBytes;
+    data["sha256"] = manifest.sha256;
+
+    return Checkpoint::replaceFile(filename, data.dump(2) + "\n");
+}
+
+/* SHA-256 and size of a whole file. */
+bool KeyShards::hashFile(const std::string &filename, QWORD *bytes, std::string *sha256) {
+    std::FILE *file = std::fopen(filename.c_str(), "rb");
+    if (file == nullptr) {
+        return false;
+    }
+
+    Digest digest = newDigest();
+    std::vector<BYTE> block(SHARD_COPY_BLOCK);
+    size_t length;
+
+    *bytes = 0;
+    while (digest && (length = std::fread(block.data(), 1, block.size(), file)) > 0) {
+        EVP_DigestUpdate(digest.get(), block.data(), length);
+        *bytes += length;
+    }
+
+    bool ok = digest && !std::ferror(file);
+    std::fclose(file);
+
+    if (ok) {
+        *sha256 = finishDigest(digest);
+    }
+    return ok;
+}
+
+/* Describes a finished output file in the manifest next to it. */
+bool KeyShards::writeManifest(const std::string &output, const JobParameters &job, QWORD keys, QWORD headerBytes) {
+    ShardManifest manifest{};
+    manifest.job = job;
+    manifest.file = fs::path(output).filename().string();
+    manifest.keys = keys;
+    manifest.headerBytes = headerBytes;
+
+    if (!hashFile(output, &manifest.bytes, &manifest.sha256)) {
+        return false;
+    }
+
+    return saveManifest(manifestPath(output), manifest);
+}
+
+/*
+ * Checks that inputs are all the shards of one job, then concatenates them into output
+ * in shard order. Headers are only kept from the first shard, and shards written with
+ * --nonewlines get a terminator between them. Every byte read is hashed on the way and
+ * compared against the manifests, a mismatch removes the half merged output again.
+ */
+bool KeyShards::merge(const std::vector<std::string> &inputs, const std::string &output) {
+    struct Part {
+        std::string file;
+        ShardManifest manifest;
+    };
+
+    std::vector<Part> parts;
+
+    for (const std::string &input : inputs) {
+        Part part;
+
+        // either the shard output or its manifest will do
+        std::string manifestFile = input;
+        if (input.size() <= strlen(SHARD_MANIFEST_SUFFIX) || input.compare(input.size() - strlen(SHARD_MANIFEST_SUFFIX), std::string::npos, SHARD_MANIFEST_SUFFIX) != 0) {
+            manifestFile = manifestPath(input);
+        }
+
+        if (!loadManifest(manifestFile, &part.manifest)) {
+            fmt::print("ERROR: Unable to read shard manifest {}\n", manifestFile);
+            return false;
+        }
+
+        part.file = (fs::path(manifestFile).parent_path() / part.manifest.file).string();
+
+        if (!parts.empty() && !part.manifest.job.sameJob(parts[0].manifest.job)) {
+            fmt::print("ERROR: {} belongs to a different job than {}\n", part.file, parts[0].file);
+            return false;
+        }
+
+        parts.push_back(part);
+    }
+
+    if (parts.empty()) {
+        fmt::print("ERROR: Nothing to merge\n");
+        return false;
+    }
+
+    std::sort(parts.begin(), parts.end(), [](const Part &a, const Part &b) {
+        return a.manifest.job.shardIndex < b.manifest.job.shardIndex;
+    });
+
+    const JobParameters &job = parts[0].manifest.job;
+    QWORD keys = 0;
+
+    for (size_t i = 0; i < parts.size(); i++) {
+        if (i > 0 && parts[i].manifest.job.shardIndex == parts[i - 1].manifest.job.shardIndex) {
+            fmt::print("ERROR: {} and {} are both shard {}\n", parts[i - 1].file, parts[i].file, parts[i].manifest.job.shardIndex);
+            return false;
+        }
+
+        keys += parts[i].manifest.keys;
+    }
+
+    if (parts.size() != job.shardCount) {
+        std::string missing;
+        size_t next = 0;
+
+        for (DWORD shard = 0; shard < job.shardCount; shard++) {
+            if (next < parts.size() && parts[next].manifest.job.shardIndex == shard) {
+                next++;
+            } else {
+                missing += fmt::format("{}{}", missing.empty() ? "" : ", ", shard);
+            }
+        }
+
+        fmt::print("ERROR: Shards {} of {} are missing\n", missing, job.shardCount);
+        return false;
+    }
+
+    if (keys != job.total) {
+        fmt::print("ERROR: Shards hold {} keys, the job is {} keys\n", keys, job.total);
+        return false;
+    }
+
+    std::FILE *out = std::fopen(output.c_str(), "wb");
+    if (out == nullptr) {
+        fmt::print("ERROR: Unable to open output file {}\n", output);
+        return false;
+    }
+
+    const char terminator = job.format == FORMAT_NUL ? '\0' : '\n';
+    const bool binary = job.format == FORMAT_BINARY;
+
+    Digest outDigest = newDigest();
+    std::vector<BYTE> block(SHARD_COPY_BLOCK);
+    bool ok = (bool)outDigest;
+    bool needTerminator = false;
+
+    for (size_t i = 0; ok && i < parts.size(); i++) {
+        const Part &part = parts[i];
+        std::FILE *in = std::fopen(part.file.c_str(), "rb");
+
+        if (in == nullptr) {
+            fmt::print("ERROR: Unable to open shard {}\n", part.file);
+            ok = false;
+            break;
+        }
+
+        Digest inDigest = newDigest();
+        QWORD position = 0;
+        size_t length;
+
+        while (inDigest && (length = std::fread(block.data(), 1, block.size(), in)) > 0) {
+            EVP_DigestUpdate(inDigest.get(), block.data(), length);
+
+            // later shards repeat the header of the first one
+            size_t skip = 0;
+            if (i > 0 && position < part.manifest.headerBytes) {
+                skip = (size_t)std::min<QWORD>(part.manifest.headerBytes - position, length);
+            }
+            position += length;
+
+            if (skip == length) {
+                continue;
+            }
+
+            if (needTerminator) {
+                EVP_DigestUpdate(outDigest.get(), &terminator, 1);
+                ok = std::fwrite(&terminator, 1, 1, out) == 1;
+                needTerminator = false;
+            }
+
+            EVP_DigestUpdate(outDigest.get(), block.data() + skip, length - skip);
+            ok = ok && std::fwrite(block.data() + skip, 1, length - skip, out) == length - skip;
+
+            if (!ok) {
+                fmt::print("ERROR: Unable to write to {}\n", output);
+                break;
+            }
+        }
+
+        bool readError = !inDigest || std::ferror(in);
+        std::fclose(in);
+
+        if (!ok) {
+            break;
+        }
+
+        if (readError || position != part.manifest.bytes || finishDigest(inDigest) != part.manifest.sha256) {
+            fmt::print("ERROR: {} does not match its manifest\n", part.file);
+            ok = false;
+            break;
+        }
+
+        // --nonewlines leaves the last key of each shard without a terminator
+        if (!binary && part.manifest.keys > 0 && job.nonewlines) {
+            needTerminator = true;
+        }
+    }
+
+    ok = std::fclose(out) == 0 && ok;
+
+    if (!ok) {
+        std::error_code error;
+        fs::remove(output, error);
+        return false;
+    }
+
+    // the merged file is a complete job of its own, shard 0 of 1
+    ShardManifest merged{};
+    merged.job = job;
+    merged.job.shardIndex = 0;
+    merged.job.shardCount = 1;
+    merged.file = fs::path(output).filename().string();
+    merged.keys = keys;
+    merged.bytes = 0;
+    merged.headerBytes = parts[0].manifest.headerBytes;
+    merged.sha256 = finishDigest(outDigest);
+
+    std::error_code error;
+    merged.bytes = fs::file_size(output, error);
+
+    if (error || !saveManifest(manifestPath(output), merged)) {
+        fmt::print("ERROR: Unable to write manifest {}\n", manifestPath(output));
+        return false;
+    }
+
+    return true;
+}
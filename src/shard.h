@@ -0,0 +1,70 @@
+/**
+ * This file is a part of the UMSKT Project
+ *
+ * Copyleft (C) 2019-2023 UMSKT Contributors (et.al.)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @FileCreated by Neo on 10/18/2026
+ * @Maintainer Neo
+ */
+
+
+#ifndef UMSKT_SHARD_H
+#define UMSKT_SHARD_H
+
+#include "header.h"
+#include "checkpoint.h"
+
+#include "libumskt/libumskt.h"
+
+#define SHARD_MANIFEST_VERSION  1
+#define SHARD_MANIFEST_SUFFIX   ".manifest.json"
+#define SHARD_COPY_BLOCK        (1024 * 1024)
+
+/* Written next to the output of every --shard run once it's complete. */
+struct ShardManifest {
+    JobParameters job;
+    std::string file;       // the shard's output, relative to the manifest
+    QWORD keys;
+    QWORD bytes;
+    QWORD headerBytes;      // CSV or key file header at the start of the file
+    std::string sha256;
+};
+
+/*
+ * One bulk job split across machines that never talk to each other.
+ *
+ * All shards of a job share its seed, key number k of shard i draws from random stream
+ * k * N + i, so no two shards can ever use the same stream. Each shard writes a normal
+ * output file plus a manifest saying which part of which job it holds, merge checks the
+ * manifests against each other and against the files before putting the parts together.
+ */
+class KeyShards {
+public:
+    static bool parseSpec(const char *text, DWORD *index, DWORD *count);
+    static QWORD shareOf(QWORD total, DWORD index, DWORD count);
+    static QWORD streamIndex(QWORD index, DWORD shardIndex, DWORD shardCount) { return index * shardCount + shardIndex; }
+    static DWORD pickSerial(DWORD serMin, DWORD serMax, bool seeded, QWORD seed);
+
+    static std::string manifestPath(const std::string &output);
+    static bool loadManifest(const std::string &filename, ShardManifest *manifest);
+    static bool saveManifest(const std::string &filename, const ShardManifest &manifest);
+    static bool hashFile(const std::string &filename, QWORD *bytes, std::string *sha256);
+
+    static bool writeManifest(const std::string &output, const JobParameters &job, QWORD keys, QWORD headerBytes);
+    static bool merge(const std::vector<std::string> &inputs, const std::string &output);
+};
+
+#endif //UMSKT_SHARD_H